@@ -0,0 +1,87 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archivebuilder.h"
+#include <stdexcept>
+#include <QDir>
+#include <QSaveFile>
+#include "tarwriter.h"
+
+namespace
+{
+	class DeviceSink : public ByteSink
+	{
+		QIODevice * const Out_;
+	public:
+		explicit DeviceSink (QIODevice *out)
+		: Out_ (out)
+		{
+		}
+
+		void Write (const char *data, qint64 size)
+		{
+			if (Out_->write (data, size) != size)
+				throw std::runtime_error (ArchiveBuilder::tr ("Could not write the tar archive: %1.")
+						.arg (Out_->errorString ())
+						.toUtf8 ().constData ());
+		}
+	};
+}
+
+QString ArchiveBuilder::Build (const QString& sourceDir, const QString& archDir,
+		const QString& normalizedName, const QString& version,
+		const CompressionParams& params)
+{
+	if (!QDir ().mkpath (archDir))
+		throw std::runtime_error (tr ("Could not create directory %1.")
+				.arg (archDir)
+				.toUtf8 ().constData ());
+
+	const QString& path = QDir (archDir).filePath (QString ("%1-%2.tar.xz")
+				.arg (normalizedName)
+				.arg (version));
+
+	QSaveFile file (path);
+	if (!file.open (QIODevice::WriteOnly))
+		throw std::runtime_error (tr ("Could not open file %1 for writing.")
+				.arg (path)
+				.toUtf8 ().constData ());
+
+	const std::unique_ptr<Compressor> compressor = Compressor::Create ("xz", &file, params);
+
+	TarWriter tar (compressor.get ());
+	tar.AddDirectoryContents (sourceDir);
+	tar.Finish ();
+	compressor->Finish ();
+
+	if (!file.commit ())
+		throw std::runtime_error (tr ("Could not write file %1: %2.")
+				.arg (path)
+				.arg (file.errorString ())
+				.toUtf8 ().constData ());
+
+	return path;
+}
+
+void ArchiveBuilder::BuildTar (const QString& sourceDir, QIODevice *out)
+{
+	DeviceSink sink (out);
+	TarWriter tar (&sink);
+	tar.AddDirectoryContents (sourceDir);
+	tar.Finish ();
+}
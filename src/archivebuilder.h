@@ -0,0 +1,51 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVEBUILDER_H
+#define ARCHIVEBUILDER_H
+#include <QCoreApplication>
+#include <QString>
+#include "compressor.h"
+
+/** Builds the arch/NAME-VERSION.tar.xz archive of a package version
+ * from a source directory.
+ *
+ * The tar stream is produced on the fly and piped straight into the
+ * multithreaded xz encoder, so no temporary uncompressed tarball is
+ * ever created, and the archive replaces the old one atomically.
+ */
+class ArchiveBuilder
+{
+	Q_DECLARE_TR_FUNCTIONS (ArchiveBuilder)
+public:
+	/** Builds the archive and returns its path, throwing
+	 * std::runtime_error on failure. The arch/ directory is created
+	 * if needed.
+	 */
+	static QString Build (const QString& sourceDir, const QString& archDir,
+			const QString& normalizedName, const QString& version,
+			const CompressionParams& = CompressionParams ());
+
+	/** Writes the uncompressed tar of the source directory into the
+	 * given device, throwing std::runtime_error on failure. This is
+	 * what CodecSelector takes as its input.
+	 */
+	static void BuildTar (const QString& sourceDir, QIODevice *out);
+};
+
+#endif
@@ -0,0 +1,112 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archivehasher.h"
+#include <algorithm>
+#include <functional>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QtConcurrentMap>
+#include "sidecarcache.h"
+#include "tracing.h"
+
+namespace
+{
+	const char SidecarName [] = ".lcpackgen-sha256";
+}
+
+QByteArray ArchiveHasher::HashFile (const QString& path)
+{
+	LC_TRACE_SCOPE ("ArchiveHasher::HashFile");
+
+	QFile file (path);
+	if (!file.open (QIODevice::ReadOnly))
+		return QByteArray ();
+
+	QCryptographicHash hash (QCryptographicHash::Sha256);
+
+	// Mapping the file in large windows avoids copying it through
+	// userspace buffers and keeps the address space usage bounded
+	// even for huge archives.
+	const qint64 window = 64 * 1024 * 1024;
+	const qint64 size = file.size ();
+	for (qint64 offset = 0; offset < size; offset += window)
+	{
+		const qint64 length = std::min (window, size - offset);
+		if (uchar *mem = file.map (offset, length))
+		{
+			hash.addData (reinterpret_cast<const char*> (mem), static_cast<int> (length));
+			file.unmap (mem);
+			continue;
+		}
+
+		// Some filesystems don't support mmap(), fall back to reads.
+		if (!file.seek (offset))
+			return QByteArray ();
+		QByteArray buffer;
+		for (qint64 left = length; left > 0; left -= buffer.size ())
+		{
+			buffer = file.read (std::min<qint64> (left, 1024 * 1024));
+			if (buffer.isEmpty ())
+				return QByteArray ();
+			hash.addData (buffer);
+		}
+	}
+
+	return hash.result ().toHex ();
+}
+
+QHash<QString, QByteArray> ArchiveHasher::Hash (const QString& archDir, const QStringList& paths)
+{
+	SidecarCache cache (archDir, SidecarName);
+
+	QHash<QString, QByteArray> result;
+	QStringList toHash;
+	QList<SidecarCache::Key> toHashKeys;
+	Q_FOREACH (const QString& path, paths)
+	{
+		const SidecarCache::Key& key = SidecarCache::GetKey (path);
+		const QByteArray& cached = cache.Find (path, key);
+		if (!cached.isEmpty ())
+			result [path] = cached;
+		else
+		{
+			toHash << path;
+			toHashKeys << key;
+		}
+	}
+
+	if (toHash.isEmpty ())
+		return result;
+
+	std::function<QByteArray (const QString&)> func = &ArchiveHasher::HashFile;
+	const QList<QByteArray>& hashes = QtConcurrent::blockingMapped<QList<QByteArray>> (toHash, func);
+
+	for (int i = 0; i < toHash.size (); ++i)
+	{
+		if (hashes.at (i).isEmpty ())
+			continue;
+
+		result [toHash.at (i)] = hashes.at (i);
+		cache.Insert (toHash.at (i), toHashKeys.at (i), hashes.at (i));
+	}
+
+	cache.Save ();
+
+	return result;
+}
@@ -0,0 +1,47 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVEHASHER_H
+#define ARCHIVEHASHER_H
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+/** Computes SHA-256 checksums of archives.
+ *
+ * Files are read through memory mappings and hashed in parallel, one
+ * file per thread. Results are cached in the archive directory
+ * through SidecarCache, so unchanged archives are never read again.
+ */
+class ArchiveHasher
+{
+public:
+	/** Returns the hex-encoded checksums of the given files, which
+	 * must all lie in archDir, keyed by their paths. Files that
+	 * could not be read are missing from the result.
+	 */
+	static QHash<QString, QByteArray> Hash (const QString& archDir, const QStringList& paths);
+
+	/** Returns the hex-encoded checksum of the given file, or an
+	 * empty array if it could not be read.
+	 */
+	static QByteArray HashFile (const QString& path);
+};
+
+#endif
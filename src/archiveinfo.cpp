@@ -0,0 +1,226 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archiveinfo.h"
+#include <functional>
+#include <QDir>
+#include <QFileInfo>
+#include "archivehasher.h"
+#include "archivemanifest.h"
+#include "archiveverifier.h"
+#include "versionkey.h"
+#include "tracing.h"
+
+VersionArchive::VersionArchive ()
+: Size_ (0)
+, Verified_ (false)
+{
+}
+
+namespace
+{
+	/** Runs compute once over the archives of the given versions that
+	 * don't have the field filled yet, and fills it with the results,
+	 * keyed by the archive paths.
+	 *
+	 * An empty result may be valid, then the done flag tells whether
+	 * the field has been filled, otherwise it is whether it's empty.
+	 */
+	template<typename T>
+	void Fill (QHash<QString, VersionArchive>& stems,
+			const QString& normalizedName, const QStringList& versions,
+			T VersionArchive::*field,
+			const std::function<QHash<QString, T> (const QStringList&)>& compute,
+			bool VersionArchive::*done = 0)
+	{
+		QStringList toFill;
+		QStringList paths;
+		Q_FOREACH (const QString& version, versions)
+		{
+			const QString& stem = normalizedName + '-' + version;
+			const QHash<QString, VersionArchive>::const_iterator pos = stems.find (stem);
+			if (pos == stems.end () ||
+					(done ? (*pos).*done : !((*pos).*field).isEmpty ()))
+				continue;
+
+			toFill << stem;
+			paths << pos->Path_;
+		}
+
+		if (paths.isEmpty ())
+			return;
+
+		const QHash<QString, T>& results = compute (paths);
+		for (int i = 0; i < toFill.size (); ++i)
+		{
+			VersionArchive& archive = stems [toFill.at (i)];
+			archive.*field = results.value (paths.at (i));
+			if (done)
+				archive.*done = true;
+		}
+	}
+}
+
+ArchiveIndex::ArchiveIndex ()
+: Exists_ (false)
+{
+}
+
+ArchiveIndex::ArchiveIndex (const QString& archPath)
+: Path_ (archPath)
+, Exists_ (false)
+{
+	LC_TRACE_SCOPE ("ArchiveIndex::ArchiveIndex");
+	LC_TRACE_COUNT (CFilesystemProbes, 1);
+
+	const QDir dir (archPath);
+	if (!dir.exists ())
+		return;
+
+	LC_TRACE_COUNT (CFilesystemProbes, 1);
+
+	Exists_ = true;
+
+	const QStringList& archivers = GetKnownArchivers ();
+	Q_FOREACH (const QFileInfo& fi, dir.entryInfoList (QDir::Files))
+	{
+		const QString& fileName = fi.fileName ();
+		const int tarPos = fileName.lastIndexOf (".tar.");
+		if (tarPos <= 0)
+			continue;
+
+		const QString& archiver = fileName.mid (tarPos + 5);
+		const int preference = archivers.indexOf (archiver);
+		if (preference == -1)
+			continue;
+
+		const QString& stem = fileName.left (tarPos);
+		QHash<QString, VersionArchive>::iterator pos = Stems_.find (stem);
+		if (pos != Stems_.end () &&
+				archivers.indexOf (pos->Archiver_) < preference)
+			continue;
+
+		VersionArchive archive;
+		archive.Archiver_ = archiver;
+		archive.Path_ = fi.absoluteFilePath ();
+		archive.Size_ = fi.size ();
+		archive.Modified_ = fi.lastModified ();
+		Stems_ [stem] = archive;
+	}
+}
+
+ArchiveIndex ArchiveIndex::ForPackage (const QString& packageFileName)
+{
+	return ArchiveIndex (QFileInfo (packageFileName).dir ().filePath ("arch"));
+}
+
+QStringList ArchiveIndex::GetKnownArchivers ()
+{
+	return QStringList ("xz")
+			<< "lzma"
+			<< "bz2"
+			<< "gz";
+}
+
+bool ArchiveIndex::IsNull () const
+{
+	return Path_.isEmpty ();
+}
+
+bool ArchiveIndex::Exists () const
+{
+	return Exists_;
+}
+
+QString ArchiveIndex::GetPath () const
+{
+	return Path_;
+}
+
+VersionArchive ArchiveIndex::Find (const QString& normalizedName, const QString& version) const
+{
+	return Stems_.value (normalizedName + '-' + version);
+}
+
+QStringList ArchiveIndex::GetVersions (const QString& normalizedName) const
+{
+	const QString& prefix = normalizedName + '-';
+
+	QStringList result;
+	for (QHash<QString, VersionArchive>::const_iterator i = Stems_.begin (),
+			end = Stems_.end (); i != end; ++i)
+		if (i.key ().size () > prefix.size () &&
+				i.key ().startsWith (prefix) &&
+				i.key ().at (prefix.size ()).isDigit ())
+			result << i.key ().mid (prefix.size ());
+	VersionKey::Sort (result);
+	return result;
+}
+
+bool ArchiveIndex::Inherit (const ArchiveIndex& older)
+{
+	bool same = Exists_ == older.Exists_ && Stems_.size () == older.Stems_.size ();
+	for (QHash<QString, VersionArchive>::iterator i = Stems_.begin (),
+			end = Stems_.end (); i != end; ++i)
+	{
+		const QHash<QString, VersionArchive>::const_iterator pos = older.Stems_.find (i.key ());
+		if (pos == older.Stems_.end () ||
+				pos->Path_ != i->Path_ ||
+				pos->Size_ != i->Size_ ||
+				pos->Modified_ != i->Modified_)
+		{
+			same = false;
+			continue;
+		}
+
+		i->Sha256_ = pos->Sha256_;
+		i->Manifest_ = pos->Manifest_;
+		i->Verified_ = pos->Verified_;
+		i->Corruption_ = pos->Corruption_;
+	}
+	return same;
+}
+
+void ArchiveIndex::ComputeChecksums (const QString& normalizedName, const QStringList& versions)
+{
+	LC_TRACE_SCOPE ("ArchiveIndex::ComputeChecksums");
+
+	const QString& archDir = Path_;
+	Fill<QByteArray> (Stems_, normalizedName, versions, &VersionArchive::Sha256_,
+			[&archDir] (const QStringList& paths) { return ArchiveHasher::Hash (archDir, paths); });
+}
+
+void ArchiveIndex::VerifyArchives (const QString& normalizedName, const QStringList& versions)
+{
+	LC_TRACE_SCOPE ("ArchiveIndex::VerifyArchives");
+
+	const QString& archDir = Path_;
+	Fill<QString> (Stems_, normalizedName, versions, &VersionArchive::Corruption_,
+			[&archDir] (const QStringList& paths) { return ArchiveVerifier::Verify (archDir, paths); },
+			&VersionArchive::Verified_);
+}
+
+QHash<QString, QString> ArchiveIndex::ComputeManifests (const QString& normalizedName, const QStringList& versions)
+{
+	LC_TRACE_SCOPE ("ArchiveIndex::ComputeManifests");
+
+	QHash<QString, QString> errors;
+	Fill<QString> (Stems_, normalizedName, versions, &VersionArchive::Manifest_,
+			[&errors] (const QStringList& paths) { return ArchiveManifest::Generate (paths, &errors); });
+	return errors;
+}
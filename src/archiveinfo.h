@@ -0,0 +1,137 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVEINFO_H
+#define ARCHIVEINFO_H
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QHash>
+
+struct VersionArchive
+{
+	QString Archiver_;
+	QString Path_;
+	qint64 Size_;
+	QDateTime Modified_;
+	QByteArray Sha256_;
+
+	/** File name of the content manifest of the archive, lying in
+	 * the same directory, or empty if it hasn't been generated.
+	 */
+	QString Manifest_;
+
+	/** Whether the archive has been verified by VerifyArchives(),
+	 * and the problem found in it, if any.
+	 */
+	bool Verified_;
+	QString Corruption_;
+
+	VersionArchive ();
+};
+
+/** In-memory index of the arch/ directory of a package.
+ *
+ * The index is built from a single directory listing and maps each
+ * NAME-VERSION stem to the most preferred archive present for it, so
+ * looking up a version never touches the filesystem. It doesn't
+ * track changes by itself: whoever owns it should rebuild it when the
+ * directory changes.
+ */
+class ArchiveIndex
+{
+	QString Path_;
+	bool Exists_;
+	QHash<QString, VersionArchive> Stems_;
+public:
+	/** Constructs a null index, not bound to any directory.
+	 */
+	ArchiveIndex ();
+
+	/** Lists the given arch/ directory and builds the index.
+	 */
+	explicit ArchiveIndex (const QString& archPath);
+
+	/** Builds the index of the arch/ subdirectory lying next to
+	 * the given package description file.
+	 */
+	static ArchiveIndex ForPackage (const QString& packageFileName);
+
+	/** Returns the archivers in the order of preference.
+	 */
+	static QStringList GetKnownArchivers ();
+
+	bool IsNull () const;
+	bool Exists () const;
+	QString GetPath () const;
+
+	/** Returns the archive for the given version, or a
+	 * VersionArchive with empty Archiver_ if there is none.
+	 */
+	VersionArchive Find (const QString& normalizedName, const QString& version) const;
+
+	/** Returns the versions of the given package having archives in
+	 * the directory, from the oldest to the newest.
+	 *
+	 * Since both names and versions may contain dashes, only the
+	 * stems continuing with a digit after the NAME- prefix are
+	 * considered, so that the archives of Foo-Bar aren't taken for
+	 * the versions of Foo.
+	 */
+	QStringList GetVersions (const QString& normalizedName) const;
+
+	/** Takes the checksums, manifests and verification results from
+	 * an older index of the same directory for the archives whose
+	 * size and mtime haven't changed since.
+	 *
+	 * Returns whether the directory holds the same archives as it
+	 * did then, so that the rebuild can be skipped altogether when it
+	 * was only triggered by some other file, like our own caches.
+	 */
+	bool Inherit (const ArchiveIndex& older);
+
+	/** Computes the SHA-256 checksums of the archives for the given
+	 * versions and records them in the index.
+	 *
+	 * This is done in parallel and reuses the checksums cached in
+	 * the directory for the archives that haven't changed.
+	 */
+	void ComputeChecksums (const QString& normalizedName, const QStringList& versions);
+
+	/** Decompresses the archives for the given versions, checks that
+	 * they are well-formed tar archives and records the results in
+	 * the index.
+	 *
+	 * Like checksums, this is done in parallel and the results are
+	 * cached in the directory for the archives that haven't changed.
+	 */
+	void VerifyArchives (const QString& normalizedName, const QStringList& versions);
+
+	/** Generates the content manifests of the archives for the given
+	 * versions and records their file names in the index.
+	 *
+	 * This is done in parallel, and manifests that are up to date
+	 * with their archives are reused without reading the archives.
+	 *
+	 * Returns why the manifests of the archives that couldn't be read
+	 * weren't generated, keyed by the archive paths.
+	 */
+	QHash<QString, QString> ComputeManifests (const QString& normalizedName, const QStringList& versions);
+};
+
+#endif
@@ -0,0 +1,194 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archivemanifest.h"
+#include <stdexcept>
+#include <functional>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrentMap>
+#include "decompressor.h"
+#include "tarreader.h"
+#include "tracing.h"
+
+namespace
+{
+	const char Magic [] = "lcpackgen-manifest 1";
+
+	QByteArray MakeHeader (qint64 size, qint64 mtime)
+	{
+		return QByteArray (Magic) + ' ' +
+				QByteArray::number (size) + ' ' +
+				QByteArray::number (mtime) + '\n';
+	}
+
+	QByteArray EscapePath (const QString& path)
+	{
+		QByteArray result = path.toUtf8 ();
+		result.replace ('\\', "\\\\");
+		result.replace ('\n', "\\n");
+		return result;
+	}
+
+	bool IsUpToDate (const QString& manifestPath, const QByteArray& header)
+	{
+		QFile file (manifestPath);
+		return file.open (QIODevice::ReadOnly) &&
+				file.readLine () == header;
+	}
+
+	/** The file name of the manifest, or why it could not be
+	 * generated.
+	 */
+	struct Outcome
+	{
+		QString Manifest_;
+		QString Error_;
+	};
+
+	Outcome GenerateOne (const QString& archivePath)
+	{
+		const QFileInfo fi (archivePath);
+		const qint64 size = fi.size ();
+		const qint64 mtime = fi.lastModified ().toMSecsSinceEpoch ();
+
+		Outcome outcome;
+
+		const QString& manifestPath = ArchiveManifest::GetManifestPath (archivePath);
+		if (IsUpToDate (manifestPath, MakeHeader (size, mtime)))
+		{
+			outcome.Manifest_ = QFileInfo (manifestPath).fileName ();
+			return outcome;
+		}
+
+		QByteArray contents;
+		try
+		{
+			contents = ArchiveManifest::Serialize (ArchiveManifest::Build (archivePath), size, mtime);
+		}
+		catch (const std::exception& e)
+		{
+			outcome.Error_ = QString::fromUtf8 (e.what ());
+			return outcome;
+		}
+
+		QSaveFile file (manifestPath);
+		if (!file.open (QIODevice::WriteOnly) ||
+				file.write (contents) != contents.size () ||
+				!file.commit ())
+		{
+			outcome.Error_ = ArchiveManifest::tr ("Could not write %1: %2.")
+					.arg (manifestPath)
+					.arg (file.errorString ());
+			return outcome;
+		}
+
+		outcome.Manifest_ = QFileInfo (manifestPath).fileName ();
+		return outcome;
+	}
+}
+
+QString ArchiveManifest::GetManifestPath (const QString& archivePath)
+{
+	return archivePath + ".manifest";
+}
+
+QList<ManifestEntry> ArchiveManifest::Build (const QString& archivePath)
+{
+	LC_TRACE_SCOPE ("ArchiveManifest::Build");
+
+	const QString& fileName = QFileInfo (archivePath).fileName ();
+	const int tarPos = fileName.lastIndexOf (".tar.");
+	if (tarPos <= 0)
+		throw std::runtime_error (tr ("Unknown archive type of %1.")
+				.arg (fileName)
+				.toUtf8 ().constData ());
+
+	QFile file (archivePath);
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (tr ("Could not open %1: %2.")
+				.arg (fileName)
+				.arg (file.errorString ())
+				.toUtf8 ().constData ());
+
+	const std::unique_ptr<Decompressor> decompressor =
+			Decompressor::Create (fileName.mid (tarPos + 5), &file);
+	TarReader reader (decompressor.get ());
+
+	QList<ManifestEntry> result;
+
+	QByteArray buffer (64 * 1024, 0);
+	TarEntry tarEntry;
+	while (reader.Next (tarEntry))
+	{
+		ManifestEntry entry;
+		entry.Path_ = tarEntry.Name_;
+		entry.Type_ = tarEntry.Type_;
+		entry.Mode_ = tarEntry.Mode_;
+		entry.Size_ = 0;
+
+		if (tarEntry.Type_ == '0' || tarEntry.Type_ == '7')
+		{
+			QCryptographicHash hash (QCryptographicHash::Sha256);
+			while (const qint64 read = reader.ReadData (buffer.data (), buffer.size ()))
+			{
+				hash.addData (buffer.constData (), static_cast<int> (read));
+				entry.Size_ += read;
+			}
+			entry.Sha256_ = hash.result ().toHex ();
+		}
+
+		result << entry;
+	}
+
+	return result;
+}
+
+QByteArray ArchiveManifest::Serialize (const QList<ManifestEntry>& entries,
+		qint64 archiveSize, qint64 archiveMTime)
+{
+	QByteArray result = MakeHeader (archiveSize, archiveMTime);
+	Q_FOREACH (const ManifestEntry& entry, entries)
+		result += QByteArray (1, entry.Type_) + ' ' +
+				QByteArray::number (entry.Mode_, 8) + ' ' +
+				QByteArray::number (entry.Size_) + ' ' +
+				(entry.Sha256_.isEmpty () ? QByteArray ("-") : entry.Sha256_) + ' ' +
+				EscapePath (entry.Path_) + '\n';
+	return result;
+}
+
+QHash<QString, QString> ArchiveManifest::Generate (const QStringList& paths,
+		QHash<QString, QString> *errors)
+{
+	std::function<Outcome (const QString&)> func = &GenerateOne;
+	const QList<Outcome>& outcomes = QtConcurrent::blockingMapped<QList<Outcome>> (paths, func);
+
+	QHash<QString, QString> result;
+	for (int i = 0; i < paths.size (); ++i)
+	{
+		const Outcome& outcome = outcomes.at (i);
+		if (!outcome.Manifest_.isEmpty ())
+			result [paths.at (i)] = outcome.Manifest_;
+		else if (errors)
+			(*errors) [paths.at (i)] = outcome.Error_;
+	}
+	return result;
+}
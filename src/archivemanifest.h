@@ -0,0 +1,80 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVEMANIFEST_H
+#define ARCHIVEMANIFEST_H
+#include <QCoreApplication>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+struct ManifestEntry
+{
+	QString Path_;
+	char Type_;
+	uint Mode_;
+	qint64 Size_;
+
+	/** Hex-encoded SHA-256 of the contents, empty for anything but
+	 * regular files.
+	 */
+	QByteArray Sha256_;
+};
+
+/** Content manifests of version archives.
+ *
+ * A manifest lists every entry of an archive with its type, mode,
+ * size and, for regular files, the SHA-256 of its contents, so that
+ * clients can do differential upgrades and detect conflicts between
+ * packages without downloading the archives. It is stored next to the
+ * archive as ARCHIVE.manifest, a text file with one entry per line:
+ *
+ *     TYPE MODE SIZE SHA256 PATH
+ *
+ * where TYPE is the tar type flag, MODE is octal, SHA256 is "-" for
+ * non-regular files, and backslashes and newlines in PATH are escaped
+ * as \\ and \n. The first line records the size and mtime of the
+ * archive the manifest was generated from, so up-to-date manifests
+ * are never regenerated.
+ */
+class ArchiveManifest
+{
+	Q_DECLARE_TR_FUNCTIONS (ArchiveManifest)
+public:
+	/** Makes sure the given archives have up-to-date manifests,
+	 * generating the missing and outdated ones in parallel. Returns
+	 * the file names of the manifests keyed by the archive paths;
+	 * archives that could not be read are missing from the result,
+	 * and why is recorded in errors, if given, keyed the same way.
+	 */
+	static QHash<QString, QString> Generate (const QStringList& paths,
+			QHash<QString, QString> *errors = 0);
+
+	/** Reads the given archive, throwing std::runtime_error if it is
+	 * corrupted or could not be read.
+	 */
+	static QList<ManifestEntry> Build (const QString& archivePath);
+
+	static QByteArray Serialize (const QList<ManifestEntry>&, qint64 archiveSize, qint64 archiveMTime);
+
+	static QString GetManifestPath (const QString& archivePath);
+};
+
+#endif
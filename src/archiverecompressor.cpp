@@ -0,0 +1,162 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archiverecompressor.h"
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QtConcurrentMap>
+#include "decompressor.h"
+
+ArchiveRecompressor::Result::Result ()
+: OldSize_ (0)
+, NewSize_ (0)
+{
+}
+
+namespace
+{
+	const qint64 ChunkSize = 256 * 1024;
+
+	/** Decompresses the given archive, returning the SHA-1 of the
+	 * contents and optionally feeding them into the compressor.
+	 */
+	QByteArray Decompress (const QString& path, const QString& archiver, Compressor *compressor)
+	{
+		QFile in (path);
+		if (!in.open (QIODevice::ReadOnly))
+			throw std::runtime_error (ArchiveRecompressor::tr ("Could not open %1: %2.")
+					.arg (path)
+					.arg (in.errorString ())
+					.toUtf8 ().constData ());
+
+		const std::unique_ptr<Decompressor> decompressor = Decompressor::Create (archiver, &in);
+
+		QCryptographicHash hash (QCryptographicHash::Sha1);
+		QByteArray buffer (ChunkSize, 0);
+		while (const qint64 read = decompressor->Read (buffer.data (), buffer.size ()))
+		{
+			hash.addData (buffer.constData (), static_cast<int> (read));
+			if (compressor)
+				compressor->Write (buffer.constData (), read);
+		}
+		return hash.result ();
+	}
+}
+
+bool ArchiveRecompressor::IsLegacy (const QString& archiver)
+{
+	return archiver == "gz" ||
+			archiver == "bz2" ||
+			archiver == "lzma";
+}
+
+ArchiveRecompressor::Result ArchiveRecompressor::Recompress (const QString& path,
+		const CompressionParams& params)
+{
+	Result result;
+	result.OldPath_ = path;
+	result.OldSize_ = QFileInfo (path).size ();
+
+	const int tarPos = path.lastIndexOf (".tar.");
+	const QString& archiver = path.mid (tarPos + 5);
+	if (tarPos <= 0 || !IsLegacy (archiver))
+	{
+		result.Error_ = tr ("Not a legacy archive.");
+		return result;
+	}
+
+	const QString& newPath = path.left (tarPos) + ".tar.xz";
+	if (QFile::exists (newPath))
+	{
+		result.Error_ = tr ("%1 already exists.").arg (newPath);
+		return result;
+	}
+
+	try
+	{
+		// The temporary file doesn't end with a known archiver, so
+		// the archive index never picks it up.
+		QTemporaryFile temp (newPath + ".XXXXXX");
+		if (!temp.open ())
+			throw std::runtime_error (tr ("Could not create a temporary file: %1.")
+					.arg (temp.errorString ())
+					.toUtf8 ().constData ());
+
+		const std::unique_ptr<Compressor> compressor = Compressor::Create ("xz", &temp, params);
+		const QByteArray& originalHash = Decompress (path, archiver, compressor.get ());
+		compressor->Finish ();
+		if (!temp.flush ())
+			throw std::runtime_error (tr ("Could not write a temporary file: %1.")
+					.arg (temp.errorString ())
+					.toUtf8 ().constData ());
+
+		if (Decompress (temp.fileName (), "xz", 0) != originalHash)
+			throw std::runtime_error (tr ("Round-trip check failed: the recompressed archive differs from the original.")
+					.toUtf8 ().constData ());
+
+		// QTemporaryFile creates its files readable by the owner only,
+		// but the archive has to stay readable by the package server.
+		if (!temp.setPermissions (QFile (path).permissions ()))
+			throw std::runtime_error (tr ("Could not set the permissions of %1: %2.")
+					.arg (temp.fileName ())
+					.arg (temp.errorString ())
+					.toUtf8 ().constData ());
+
+		if (!temp.rename (newPath))
+			throw std::runtime_error (tr ("Could not rename %1 to %2: %3.")
+					.arg (temp.fileName ())
+					.arg (newPath)
+					.arg (temp.errorString ())
+					.toUtf8 ().constData ());
+		temp.setAutoRemove (false);
+	}
+	catch (const std::exception& e)
+	{
+		result.Error_ = QString::fromUtf8 (e.what ());
+		return result;
+	}
+
+	result.NewPath_ = newPath;
+	result.NewSize_ = QFileInfo (newPath).size ();
+	return result;
+}
+
+QList<ArchiveRecompressor::Result> ArchiveRecompressor::RecompressAll (const QStringList& paths,
+		int jobs, quint64 memoryLimit)
+{
+	// The pool hands the archives out one by one to whichever thread
+	// is free, so a few huge archives don't hold the others up. The
+	// xz encoder threads of the jobs share the cores and the memory.
+	jobs = std::max (1, std::min (jobs, paths.size ()));
+
+	CompressionParams params;
+	params.Threads_ = std::max (1, QThread::idealThreadCount () / jobs);
+	params.MemoryLimit_ = memoryLimit / jobs;
+
+	std::function<Result (const QString&)> func = [params] (const QString& path)
+		{
+			return Recompress (path, params);
+		};
+	return QtConcurrent::blockingMapped<QList<Result>> (paths, func);
+}
@@ -0,0 +1,70 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVERECOMPRESSOR_H
+#define ARCHIVERECOMPRESSOR_H
+#include <QCoreApplication>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "compressor.h"
+
+/** Re-encodes legacy gz, bz2 and lzma archives to xz.
+ *
+ * Each archive is decompressed and recompressed on the fly into a
+ * temporary file next to it, which is then decompressed once more and
+ * compared to the original contents. Only after that check passes is
+ * it renamed to NAME-VERSION.tar.xz, so a crash at any point leaves
+ * either the old archive alone or both of them, and since xz is the
+ * preferred archiver the new one is picked up as soon as it appears.
+ * The old archives are left in place for the caller to remove once
+ * the package descriptions are updated.
+ */
+class ArchiveRecompressor
+{
+	Q_DECLARE_TR_FUNCTIONS (ArchiveRecompressor)
+public:
+	struct Result
+	{
+		QString OldPath_;
+		QString NewPath_;
+		qint64 OldSize_;
+		qint64 NewSize_;
+		QString Error_;
+
+		Result ();
+	};
+
+	/** Returns whether archives made with the given archiver should
+	 * be recompressed.
+	 */
+	static bool IsLegacy (const QString& archiver);
+
+	/** Recompresses a single archive to xz. Failures are reported in
+	 * the Error_ field of the result.
+	 */
+	static Result Recompress (const QString& path, const CompressionParams& = CompressionParams ());
+
+	/** Recompresses the given archives in parallel on the global
+	 * thread pool, splitting the cores and the memory limit (in bytes,
+	 * 0 for none) between the jobs running at the same time.
+	 */
+	static QList<Result> RecompressAll (const QStringList& paths, int jobs, quint64 memoryLimit);
+};
+
+#endif
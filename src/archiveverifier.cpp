@@ -0,0 +1,168 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "archiveverifier.h"
+#include <stdexcept>
+#include <functional>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrentMap>
+#include "decompressor.h"
+#include "sidecarcache.h"
+#include "tarreader.h"
+#include "tracing.h"
+
+namespace
+{
+	const char SidecarName [] = ".lcpackgen-verified";
+
+	// The error is stored base64-encoded so that it fits into a
+	// single field, with "-" meaning the archive is fine.
+	QByteArray EncodeError (const QString& error)
+	{
+		return error.isEmpty () ? QByteArray ("-") : error.toUtf8 ().toBase64 ();
+	}
+
+	QString DecodeError (const QByteArray& value)
+	{
+		return value == "-" ? QString () : QString::fromUtf8 (QByteArray::fromBase64 (value));
+	}
+
+	/** The outcome of verifying an archive. Only the problems with the
+	 * archive itself are permanent and may be cached, not failing to
+	 * open or read it, or to set up the decoder.
+	 */
+	struct Outcome
+	{
+		QString Error_;
+		bool Permanent_;
+	};
+
+	Outcome Check (const QString& path)
+	{
+		LC_TRACE_SCOPE ("ArchiveVerifier::VerifyFile");
+
+		const QString& fileName = QFileInfo (path).fileName ();
+		const int tarPos = fileName.lastIndexOf (".tar.");
+		if (tarPos <= 0)
+		{
+			const Outcome outcome = { ArchiveVerifier::tr ("Unknown archive type."), true };
+			return outcome;
+		}
+
+		QFile file (path);
+		if (!file.open (QIODevice::ReadOnly))
+		{
+			const Outcome outcome =
+			{
+				ArchiveVerifier::tr ("Could not open the archive: %1.")
+						.arg (file.errorString ()),
+				false
+			};
+			return outcome;
+		}
+
+		std::unique_ptr<Decompressor> decompressor;
+		try
+		{
+			decompressor = Decompressor::Create (fileName.mid (tarPos + 5), &file);
+		}
+		catch (const std::exception& e)
+		{
+			const Outcome outcome = { QString::fromUtf8 (e.what ()), false };
+			return outcome;
+		}
+
+		try
+		{
+			TarReader reader (decompressor.get ());
+			TarEntry entry;
+			int entries = 0;
+			while (reader.Next (entry))
+				++entries;
+
+			if (!entries)
+			{
+				const Outcome outcome = { ArchiveVerifier::tr ("The archive is empty."), true };
+				return outcome;
+			}
+
+			// Whatever follows the end-of-archive marker (usually the
+			// padding to the record size) still has to be decompressed
+			// so that the checksums at the end of the stream are
+			// verified.
+			char buffer [64 * 1024];
+			while (decompressor->Read (buffer, sizeof (buffer)))
+				;
+		}
+		catch (const std::exception& e)
+		{
+			// Read errors surface as exceptions from the decompressor
+			// too, but leave the error on the file.
+			const Outcome outcome = { QString::fromUtf8 (e.what ()), file.error () == QFileDevice::NoError };
+			return outcome;
+		}
+
+		const Outcome outcome = { QString (), true };
+		return outcome;
+	}
+}
+
+QString ArchiveVerifier::VerifyFile (const QString& path)
+{
+	return Check (path).Error_;
+}
+
+QHash<QString, QString> ArchiveVerifier::Verify (const QString& archDir, const QStringList& paths)
+{
+	SidecarCache cache (archDir, SidecarName);
+
+	QHash<QString, QString> result;
+	QStringList toVerify;
+	QList<SidecarCache::Key> toVerifyKeys;
+	Q_FOREACH (const QString& path, paths)
+	{
+		const SidecarCache::Key& key = SidecarCache::GetKey (path);
+		const QByteArray& cached = cache.Find (path, key);
+		if (!cached.isNull ())
+			result [path] = DecodeError (cached);
+		else
+		{
+			toVerify << path;
+			toVerifyKeys << key;
+		}
+	}
+
+	if (toVerify.isEmpty ())
+		return result;
+
+	std::function<Outcome (const QString&)> func = &Check;
+	const QList<Outcome>& outcomes = QtConcurrent::blockingMapped<QList<Outcome>> (toVerify, func);
+
+	for (int i = 0; i < toVerify.size (); ++i)
+	{
+		const Outcome& outcome = outcomes.at (i);
+		result [toVerify.at (i)] = outcome.Error_;
+		if (outcome.Permanent_)
+			cache.Insert (toVerify.at (i), toVerifyKeys.at (i), EncodeError (outcome.Error_));
+	}
+
+	cache.Save ();
+
+	return result;
+}
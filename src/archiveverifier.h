@@ -0,0 +1,53 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef ARCHIVEVERIFIER_H
+#define ARCHIVEVERIFIER_H
+#include <QCoreApplication>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/** Checks the integrity of version archives.
+ *
+ * Each archive is decompressed on the fly with the codec matching its
+ * suffix and its tar headers are walked without extracting anything,
+ * so both corrupted compressed streams and truncated or malformed tar
+ * archives are caught. Archives are verified in parallel, one per
+ * thread with bounded buffers, and the results are cached in the
+ * archive directory through SidecarCache, except for failures to open
+ * or read an archive, which may well be transient.
+ */
+class ArchiveVerifier
+{
+	Q_DECLARE_TR_FUNCTIONS (ArchiveVerifier)
+public:
+	/** Verifies the given files, which must all lie in archDir, and
+	 * returns the results keyed by their paths: an empty string for
+	 * the archives that are fine and the description of the problem
+	 * for the others.
+	 */
+	static QHash<QString, QString> Verify (const QString& archDir, const QStringList& paths);
+
+	/** Verifies a single archive, returning an empty string if it is
+	 * fine and the description of the problem otherwise.
+	 */
+	static QString VerifyFile (const QString& path);
+};
+
+#endif
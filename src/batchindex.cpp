@@ -0,0 +1,72 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchindex.h"
+#include <stdexcept>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTextStream>
+#include "repositoryindexer.h"
+
+int BatchIndex::Run (const QString& root, const BatchProcessor::Options& options)
+{
+	QTextStream err (stderr);
+
+	QElapsedTimer timer;
+	timer.start ();
+
+	RepositoryIndexer indexer (root, options.IndexPath_, options.UseCache_, options.Precompress_);
+	RepositoryIndexer::Stats stats;
+	try
+	{
+		stats = indexer.Rebuild ();
+	}
+	catch (const std::exception& e)
+	{
+		err << QString::fromUtf8 (e.what ()) << endl;
+		return 2;
+	}
+
+	const qint64 elapsed = timer.elapsed ();
+
+	Q_FOREACH (const QString& error, stats.Errors_)
+		err << tr ("error:") << ' ' << error << endl;
+	err << tr ("%1 packages: %2 parsed, %3 cached, %4 failed; index %5.")
+			.arg (stats.Total_)
+			.arg (stats.Parsed_)
+			.arg (stats.Cached_)
+			.arg (stats.Errors_.size ())
+			.arg (stats.Written_ ? tr ("written") : tr ("up to date"))
+		<< endl;
+
+	QJsonObject summary;
+	summary ["index"] = indexer.GetIndexPath ();
+	summary ["total"] = stats.Total_;
+	summary ["parsed"] = stats.Parsed_;
+	summary ["cached"] = stats.Cached_;
+	summary ["written"] = stats.Written_;
+	if (options.Precompress_)
+		summary ["precompressed"] = stats.Precompressed_;
+	summary ["errors"] = QJsonArray::fromStringList (stats.Errors_);
+	summary ["elapsedMs"] = static_cast<double> (elapsed);
+	if (!BatchProcessor::WriteSummary (summary, options))
+		return 2;
+
+	return stats.Errors_.isEmpty () ? 0 : 1;
+}
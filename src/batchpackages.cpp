@@ -0,0 +1,343 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchpackages.h"
+#include <stdexcept>
+#include <functional>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QtConcurrentMap>
+#include "packagedata.h"
+#include "archiveinfo.h"
+#include "archivebuilder.h"
+#include "packageloader.h"
+#include "packagevalidator.h"
+#include "packagewriter.h"
+#include "precompressor.h"
+#include "tracing.h"
+
+BatchPackages::Result::Result ()
+: Status_ (SError)
+, Saved_ (false)
+, Unchanged_ (false)
+, Precompressed_ (false)
+{
+}
+
+namespace
+{
+	QString StatusToString (BatchPackages::Status status)
+	{
+		switch (status)
+		{
+		case BatchPackages::SValid:
+			return "valid";
+		case BatchPackages::SInvalid:
+			return "invalid";
+		case BatchPackages::SError:
+			return "error";
+		}
+
+		return QString ();
+	}
+}
+
+int BatchPackages::Run (const QStringList& paths, const BatchProcessor::Options& options)
+{
+	QTextStream err (stderr);
+
+	const QStringList& files = CollectDescriptors (paths);
+	if (files.isEmpty ())
+	{
+		err << tr ("No package descriptions to process.") << endl;
+		return 2;
+	}
+
+	QElapsedTimer timer;
+	timer.start ();
+
+	std::function<Result (const QString&)> func = [options] (const QString& file)
+		{
+			return Process (file, options);
+		};
+	const QList<Result>& results = QtConcurrent::blockingMapped<QList<Result>> (files, func);
+
+	const qint64 elapsed = timer.elapsed ();
+
+	bool allValid = true;
+	Q_FOREACH (const Result& result, results)
+	{
+		Q_FOREACH (const QString& warning, result.Warnings_)
+			err << result.FileName_ << ": " << tr ("warning:") << ' ' << warning << endl;
+
+		switch (result.Status_)
+		{
+		case SValid:
+			err << result.FileName_ << ": " << tr ("valid");
+			break;
+		case SInvalid:
+			err << result.FileName_ << ": " << tr ("invalid:") << ' ' << result.Reasons_.join (" ");
+			break;
+		case SError:
+			err << result.FileName_ << ": " << tr ("error:") << ' ' << result.Error_;
+			break;
+		}
+		if (result.Saved_)
+			err << ' ' << tr ("(saved)");
+		else if (result.Unchanged_)
+			err << ' ' << tr ("(up to date)");
+		if (result.Precompressed_)
+			err << ' ' << tr ("(precompressed)");
+		err << endl;
+
+		if (result.Status_ != SValid)
+			allValid = false;
+	}
+
+	if (!BatchProcessor::WriteSummary (MakeSummary (results, elapsed, options), options))
+		return 2;
+
+	return allValid ? 0 : 1;
+}
+
+QStringList BatchPackages::CollectDescriptors (const QStringList& paths)
+{
+	QStringList result;
+	Q_FOREACH (const QString& path, paths)
+	{
+		const QFileInfo fi (path);
+		if (!fi.isDir ())
+		{
+			result << fi.absoluteFilePath ();
+			continue;
+		}
+
+		const QDir dir (fi.absoluteFilePath ());
+		Q_FOREACH (const QString& name,
+				dir.entryList (QStringList ("*.xml"), QDir::Files, QDir::Name))
+			result << dir.absoluteFilePath (name);
+	}
+	return result;
+}
+
+BatchPackages::Result BatchPackages::Process (const QString& fileName, const BatchProcessor::Options& options)
+{
+	LC_TRACE_SCOPE ("BatchPackages::Process");
+
+	Result result;
+	result.FileName_ = fileName;
+
+	try
+	{
+		QFile file (fileName);
+		if (!file.open (QIODevice::ReadOnly))
+			throw std::runtime_error (tr ("Unable to open file %1 for reading.")
+					.arg (fileName)
+					.toUtf8 ().constData ());
+		QByteArray contents = file.readAll ();
+		file.close ();
+
+		if (options.Schema_)
+			result.SchemaErrors_ = PackageSchema::Validate (contents, QUrl::fromLocalFile (fileName));
+
+		QBuffer buffer (&contents);
+		buffer.open (QIODevice::ReadOnly);
+		PackageData data = PackageLoader::Load (&buffer, result.Warnings_);
+
+		const QString& archDir = QFileInfo (fileName).dir ().filePath ("arch");
+		if (options.SelectCodec_)
+		{
+			QString tarPath = options.ArchiveTar_;
+
+			// The selector needs an uncompressed tar to start from, so
+			// build one next to the package if we only have the tree.
+			QTemporaryFile tempTar (QFileInfo (fileName).dir ().filePath (".lcpackgen-XXXXXX.tar"));
+			if (tarPath.isEmpty ())
+			{
+				if (!tempTar.open ())
+					throw std::runtime_error (tr ("Could not create a temporary file: %1.")
+							.arg (tempTar.errorString ())
+							.toUtf8 ().constData ());
+				ArchiveBuilder::BuildTar (options.ArchiveSource_, &tempTar);
+				if (!tempTar.flush ())
+					throw std::runtime_error (tr ("Could not write a temporary file: %1.")
+							.arg (tempTar.errorString ())
+							.toUtf8 ().constData ());
+				tarPath = tempTar.fileName ();
+			}
+
+			const CodecSelector::Result& selected = CodecSelector::Select (tarPath,
+					archDir,
+					data.GetNormalizedName (),
+					options.ArchiveVersion_,
+					options.CodecPolicy_);
+			result.Codecs_ = selected.Candidates_;
+			result.Archiver_ = selected.Archiver_;
+		}
+		else if (!options.ArchiveSource_.isEmpty ())
+			ArchiveBuilder::Build (options.ArchiveSource_,
+					archDir,
+					data.GetNormalizedName (),
+					options.ArchiveVersion_);
+
+		if (!options.ArchiveVersion_.isEmpty () &&
+				!data.Versions_.contains (options.ArchiveVersion_))
+			data.Versions_ << options.ArchiveVersion_;
+
+		ArchiveIndex index = ArchiveIndex::ForPackage (fileName);
+
+		if (options.DiscoverVersions_)
+			Q_FOREACH (const QString& version, index.GetVersions (data.GetNormalizedName ()))
+				if (!data.Versions_.contains (version))
+					data.Versions_ << version;
+
+		if (options.Verify_)
+			index.VerifyArchives (data.GetNormalizedName (), data.Versions_);
+
+		Q_FOREACH (const PackageSchema::Error& error, result.SchemaErrors_)
+			result.Reasons_ << tr ("Schema violation at %1.")
+					.arg (PackageSchema::ToString (error));
+		result.Reasons_ += PackageValidator ().Validate (data, index);
+		result.Status_ = result.Reasons_.isEmpty () ? SValid : SInvalid;
+
+		if (!options.CheckOnly_ &&
+				(result.Status_ == SValid || options.SaveInvalid_))
+		{
+			if (options.Checksums_)
+				index.ComputeChecksums (data.GetNormalizedName (), data.Versions_);
+			if (options.Manifests_)
+			{
+				const QHash<QString, QString>& errors = index.ComputeManifests (data.GetNormalizedName (), data.Versions_);
+				for (QHash<QString, QString>::const_iterator i = errors.begin (); i != errors.end (); ++i)
+					result.Warnings_ << tr ("Could not generate the manifest of %1: %2")
+							.arg (i.key ())
+							.arg (*i);
+			}
+
+			result.Saved_ = PackageWriter::Save (data, fileName, index, fileName);
+			result.Unchanged_ = !result.Saved_;
+
+			// Saving has already refreshed the copies if there were any.
+			if (options.Precompress_)
+				result.Precompressed_ = Precompressor::Update (fileName) || result.Saved_;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		result.Status_ = SError;
+		result.Error_ = QString::fromUtf8 (e.what ());
+	}
+
+	return result;
+}
+
+QJsonObject BatchPackages::MakeSummary (const QList<Result>& results, qint64 elapsed,
+		const BatchProcessor::Options& options)
+{
+	QJsonArray packages;
+	int valid = 0;
+	int invalid = 0;
+	int errors = 0;
+	int saved = 0;
+	int unchanged = 0;
+	Q_FOREACH (const Result& result, results)
+	{
+		QJsonObject package;
+		package ["file"] = result.FileName_;
+		package ["status"] = StatusToString (result.Status_);
+		package ["saved"] = result.Saved_;
+		package ["unchanged"] = result.Unchanged_;
+		if (options.Precompress_)
+			package ["precompressed"] = result.Precompressed_;
+		if (!result.Reasons_.isEmpty ())
+			package ["reasons"] = QJsonArray::fromStringList (result.Reasons_);
+		if (!result.SchemaErrors_.isEmpty ())
+		{
+			QJsonArray schemaErrors;
+			Q_FOREACH (const PackageSchema::Error& error, result.SchemaErrors_)
+			{
+				QJsonObject schemaError;
+				schemaError ["line"] = error.Line_;
+				schemaError ["column"] = error.Column_;
+				schemaError ["message"] = error.Message_;
+				schemaErrors.append (schemaError);
+			}
+			package ["schemaErrors"] = schemaErrors;
+		}
+		if (!result.Warnings_.isEmpty ())
+			package ["warnings"] = QJsonArray::fromStringList (result.Warnings_);
+		if (!result.Error_.isEmpty ())
+			package ["error"] = result.Error_;
+		if (!result.Codecs_.isEmpty ())
+		{
+			QJsonArray codecs;
+			Q_FOREACH (const CodecSelector::Candidate& candidate, result.Codecs_)
+			{
+				QJsonObject codec;
+				codec ["archiver"] = candidate.Archiver_;
+				if (candidate.Error_.isEmpty ())
+				{
+					codec ["size"] = static_cast<double> (candidate.Size_);
+					codec ["decompressUsec"] = static_cast<double> (candidate.DecompressUSecs_);
+				}
+				else
+					codec ["error"] = candidate.Error_;
+				codecs.append (codec);
+			}
+			package ["codecs"] = codecs;
+			package ["archiver"] = result.Archiver_;
+		}
+		packages.append (package);
+
+		switch (result.Status_)
+		{
+		case SValid:
+			++valid;
+			break;
+		case SInvalid:
+			++invalid;
+			break;
+		case SError:
+			++errors;
+			break;
+		}
+		if (result.Saved_)
+			++saved;
+		else if (result.Unchanged_)
+			++unchanged;
+	}
+
+	QJsonObject summary;
+	summary ["total"] = results.size ();
+	summary ["valid"] = valid;
+	summary ["invalid"] = invalid;
+	summary ["errors"] = errors;
+	summary ["saved"] = saved;
+	summary ["unchanged"] = unchanged;
+	summary ["jobs"] = options.Jobs_;
+	summary ["elapsedMs"] = static_cast<double> (elapsed);
+	summary ["packages"] = packages;
+	return summary;
+}
@@ -0,0 +1,73 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef BATCHPACKAGES_H
+#define BATCHPACKAGES_H
+#include <QCoreApplication>
+#include <QStringList>
+#include "batchprocessor.h"
+#include "codecselector.h"
+#include "packageschema.h"
+
+class QJsonObject;
+
+/** Batch mode loading, checking and regenerating a bunch of package
+ * descriptions in parallel, optionally building an archive for each
+ * of them first.
+ */
+class BatchPackages
+{
+	Q_DECLARE_TR_FUNCTIONS (BatchPackages)
+public:
+	enum Status
+	{
+		SValid,
+		SInvalid,
+		SError
+	};
+
+	struct Result
+	{
+		QString FileName_;
+		Status Status_;
+		QStringList Reasons_;
+		QList<PackageSchema::Error> SchemaErrors_;
+		QStringList Warnings_;
+		QString Error_;
+		bool Saved_;
+		bool Unchanged_;
+		bool Precompressed_;
+		QList<CodecSelector::Candidate> Codecs_;
+		QString Archiver_;
+
+		Result ();
+	};
+
+	/** Processes the package descriptions at the given paths, which
+	 * may be package directories as well, and returns the exit code.
+	 */
+	static int Run (const QStringList& paths, const BatchProcessor::Options&);
+
+	static QStringList CollectDescriptors (const QStringList& paths);
+	static Result Process (const QString& fileName, const BatchProcessor::Options&);
+private:
+	static QJsonObject MakeSummary (const QList<Result>&, qint64 elapsed,
+			const BatchProcessor::Options&);
+};
+
+#endif
@@ -0,0 +1,269 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchprocessor.h"
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include "batchindex.h"
+#include "batchpackages.h"
+#include "batchrecompress.h"
+#include "batchresolve.h"
+#include "batchwatch.h"
+
+BatchProcessor::Options::Options ()
+: CheckOnly_ (false)
+, SaveInvalid_ (false)
+, Checksums_ (false)
+, Manifests_ (false)
+, DiscoverVersions_ (false)
+, Verify_ (false)
+, Schema_ (true)
+, Precompress_ (false)
+, SelectCodec_ (false)
+, Jobs_ (QThread::idealThreadCount ())
+, MemoryLimit_ (0)
+, UseCache_ (true)
+, DebounceMs_ (500)
+{
+}
+
+int BatchProcessor::Run (const QStringList& args)
+{
+	QCommandLineParser parser;
+	parser.setApplicationDescription (tr ("Checks and regenerates LackMan package descriptions."));
+	parser.addHelpOption ();
+	parser.addOption ({ "batch", tr ("Run in headless batch mode.") });
+	parser.addOption ({ "check-only", tr ("Only check the packages, do not rewrite them.") });
+	parser.addOption ({ "save-invalid", tr ("Rewrite the packages even if they are invalid.") });
+	parser.addOption ({ "checksums", tr ("Record SHA-256 checksums of the version archives.") });
+	parser.addOption ({ "manifests",
+			tr ("Generate content manifests of the version archives.") });
+	parser.addOption ({ "discover-versions",
+			tr ("Add the versions having archives in the arch subdirectory.") });
+	parser.addOption ({ "verify",
+			tr ("Decompress the version archives and check that they are not corrupted.") });
+	parser.addOption ({ "precompress",
+			tr ("Keep gzip, xz and, if available, zstd compressed copies of the written descriptions and index, with their checksums.") });
+	parser.addOption ({ "no-schema",
+			tr ("Don't validate the package descriptions against the package schema.") });
+	parser.addOption ({ "archive-source",
+			tr ("Build the archive for --archive-version from the given directory."),
+			tr ("dir") });
+	parser.addOption ({ "archive-tar",
+			tr ("Compress the given uncompressed tar as the archive for --archive-version."),
+			tr ("file") });
+	parser.addOption ({ "codec-policy",
+			tr ("Compress the new archive with every archiver and keep the smallest one or the fastest one to decompress."),
+			tr ("smallest|fastest") });
+	parser.addOption ({ "size-budget",
+			tr ("How much larger than the smallest one, in percent, the archive kept by the fastest policy may be."),
+			tr ("percent") });
+	parser.addOption ({ "archive-version",
+			tr ("Version to build the archive for, added to the package if missing."),
+			tr ("version") });
+	parser.addOption ({ { "j", "jobs" },
+			tr ("Number of packages processed in parallel."),
+			tr ("count") });
+	parser.addOption ({ "list",
+			tr ("Read the paths to process from the given file, one per line."),
+			tr ("file") });
+	parser.addOption ({ "summary",
+			tr ("Write the JSON summary to the given file instead of the standard output."),
+			tr ("file") });
+	parser.addOption ({ "repository",
+			tr ("Rebuild the index of the repository rooted at the given directory."),
+			tr ("dir") });
+	parser.addOption ({ "index",
+			tr ("Write the repository index to the given file instead of Packages.xml in the repository root."),
+			tr ("file") });
+	parser.addOption ({ "no-cache", tr ("Ignore and don't update the repository index cache.") });
+	parser.addOption ({ "resolve",
+			tr ("Check the dependencies of all the packages in the repository rooted at the given directory."),
+			tr ("dir") });
+	parser.addOption ({ "recompress",
+			tr ("Recompress the gz, bz2 and lzma archives of the repository rooted at the given directory to xz."),
+			tr ("dir") });
+	parser.addOption ({ "memory-limit",
+			tr ("Memory the compressors may use in total, in MiB."),
+			tr ("MiB") });
+	parser.addOption ({ "watch",
+			tr ("Keep the package descriptions of the repository rooted at the given directory in sync with their archives."),
+			tr ("dir") });
+	parser.addOption ({ "debounce",
+			tr ("Milliseconds to wait for the changes to settle in watch mode."),
+			tr ("ms"),
+			"500" });
+	parser.addPositionalArgument ("paths",
+			tr ("Package directories or package description files."),
+			"[paths...]");
+	parser.process (args);
+
+	QTextStream err (stderr);
+
+	Options_.CheckOnly_ = parser.isSet ("check-only");
+	Options_.SaveInvalid_ = parser.isSet ("save-invalid");
+	Options_.Checksums_ = parser.isSet ("checksums");
+	Options_.Manifests_ = parser.isSet ("manifests");
+	Options_.DiscoverVersions_ = parser.isSet ("discover-versions");
+	Options_.Verify_ = parser.isSet ("verify");
+	Options_.Schema_ = !parser.isSet ("no-schema");
+	Options_.Precompress_ = parser.isSet ("precompress");
+	Options_.ArchiveSource_ = parser.value ("archive-source");
+	Options_.ArchiveVersion_ = parser.value ("archive-version");
+	Options_.ArchiveTar_ = parser.value ("archive-tar");
+	if (!Options_.ArchiveSource_.isEmpty () && !Options_.ArchiveTar_.isEmpty ())
+	{
+		err << tr ("--archive-source and --archive-tar are mutually exclusive.") << endl;
+		return 2;
+	}
+	if ((Options_.ArchiveSource_.isEmpty () && Options_.ArchiveTar_.isEmpty ()) !=
+			Options_.ArchiveVersion_.isEmpty ())
+	{
+		err << tr ("--archive-version should be given together with --archive-source or --archive-tar.") << endl;
+		return 2;
+	}
+
+	Options_.SelectCodec_ = !Options_.ArchiveTar_.isEmpty () || parser.isSet ("codec-policy");
+	if (Options_.SelectCodec_ && Options_.ArchiveVersion_.isEmpty ())
+	{
+		err << tr ("--codec-policy only applies to the archive built for --archive-version.") << endl;
+		return 2;
+	}
+	if (parser.isSet ("codec-policy") &&
+			!CodecSelector::ParseGoal (parser.value ("codec-policy"), Options_.CodecPolicy_.Goal_))
+	{
+		err << tr ("Invalid codec policy: %1.").arg (parser.value ("codec-policy")) << endl;
+		return 2;
+	}
+	if (parser.isSet ("size-budget"))
+	{
+		bool ok = false;
+		const int budget = parser.value ("size-budget").toInt (&ok);
+		if (!ok || budget < 0)
+		{
+			err << tr ("Invalid size budget: %1.").arg (parser.value ("size-budget")) << endl;
+			return 2;
+		}
+		Options_.CodecPolicy_.SizeBudget_ = budget;
+	}
+	Options_.SummaryFile_ = parser.value ("summary");
+	if (parser.isSet ("jobs"))
+	{
+		bool ok = false;
+		const int jobs = parser.value ("jobs").toInt (&ok);
+		if (!ok || jobs <= 0)
+		{
+			err << tr ("Invalid jobs count: %1.").arg (parser.value ("jobs")) << endl;
+			return 2;
+		}
+		Options_.Jobs_ = jobs;
+	}
+	if (parser.isSet ("memory-limit"))
+	{
+		bool ok = false;
+		const quint64 limit = parser.value ("memory-limit").toULongLong (&ok);
+		if (!ok || !limit)
+		{
+			err << tr ("Invalid memory limit: %1.").arg (parser.value ("memory-limit")) << endl;
+			return 2;
+		}
+		Options_.MemoryLimit_ = limit * 1024 * 1024;
+	}
+
+	// A check must leave the repository as it is.
+	if (Options_.CheckOnly_ &&
+			(!Options_.ArchiveVersion_.isEmpty () ||
+				parser.isSet ("repository") ||
+				parser.isSet ("recompress") ||
+				parser.isSet ("watch")))
+	{
+		err << tr ("--check-only can't be combined with building archives, --repository, --recompress or --watch.") << endl;
+		return 2;
+	}
+
+	QThreadPool::globalInstance ()->setMaxThreadCount (Options_.Jobs_);
+
+	if (parser.isSet ("resolve"))
+		return BatchResolve::Run (parser.value ("resolve"), Options_);
+
+	if (parser.isSet ("watch"))
+	{
+		bool ok = false;
+		Options_.DebounceMs_ = parser.value ("debounce").toInt (&ok);
+		if (!ok || Options_.DebounceMs_ < 0)
+		{
+			err << tr ("Invalid debounce interval: %1.").arg (parser.value ("debounce")) << endl;
+			return 2;
+		}
+		return BatchWatch::Run (parser.value ("watch"), Options_);
+	}
+
+	if (parser.isSet ("recompress"))
+		return BatchRecompress::Run (parser.value ("recompress"), Options_);
+
+	if (parser.isSet ("repository"))
+	{
+		Options_.IndexPath_ = parser.value ("index");
+		Options_.UseCache_ = !parser.isSet ("no-cache");
+		return BatchIndex::Run (parser.value ("repository"), Options_);
+	}
+
+	QStringList paths = parser.positionalArguments ();
+	if (parser.isSet ("list"))
+	{
+		QFile list (parser.value ("list"));
+		if (!list.open (QIODevice::ReadOnly))
+		{
+			err << tr ("Unable to open file %1 for reading.").arg (list.fileName ()) << endl;
+			return 2;
+		}
+
+		while (!list.atEnd ())
+		{
+			const QString& line = QString::fromUtf8 (list.readLine ()).trimmed ();
+			if (!line.isEmpty ())
+				paths << line;
+		}
+	}
+
+	return BatchPackages::Run (paths, Options_);
+}
+
+bool BatchProcessor::WriteSummary (const QJsonObject& object, const Options& options)
+{
+	const QByteArray& summary = QJsonDocument (object).toJson ();
+	if (options.SummaryFile_.isEmpty ())
+	{
+		QTextStream (stdout) << summary;
+		return true;
+	}
+
+	QFile summaryFile (options.SummaryFile_);
+	if (!summaryFile.open (QIODevice::WriteOnly) ||
+			summaryFile.write (summary) != summary.size ())
+	{
+		QTextStream (stderr) << tr ("Could not write summary to %1.").arg (options.SummaryFile_) << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+#include <QCoreApplication>
+#include <QStringList>
+#include "codecselector.h"
+
+class QJsonObject;
+
+/** Headless mode: loads, checks and regenerates a bunch of package
+ * descriptions in parallel without any GUI, rebuilds the index of a
+ * whole repository, checks the dependencies of its packages,
+ * recompresses its legacy archives or keeps it in sync with them.
+ *
+ * This class only parses the command line, each of the modes lives
+ * in a class of its own.
+ */
+class BatchProcessor
+{
+	Q_DECLARE_TR_FUNCTIONS (BatchProcessor)
+public:
+	struct Options
+	{
+		bool CheckOnly_;
+		bool SaveInvalid_;
+		bool Checksums_;
+		bool Manifests_;
+		bool DiscoverVersions_;
+		bool Verify_;
+		bool Schema_;
+		bool Precompress_;
+		QString ArchiveSource_;
+		QString ArchiveVersion_;
+		QString ArchiveTar_;
+		bool SelectCodec_;
+		CodecSelector::Policy CodecPolicy_;
+		int Jobs_;
+		quint64 MemoryLimit_;
+		QString SummaryFile_;
+		QString IndexPath_;
+		bool UseCache_;
+		int DebounceMs_;
+
+		Options ();
+	};
+private:
+	Options Options_;
+public:
+	/** Parses the command line, runs the mode it asks for and
+	 * returns the exit code.
+	 */
+	int Run (const QStringList& args);
+
+	/** Writes the JSON summary of a run where the options tell,
+	 * returning false on failure.
+	 */
+	static bool WriteSummary (const QJsonObject&, const Options&);
+};
+
+#endif
@@ -0,0 +1,204 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchrecompress.h"
+#include <stdexcept>
+#include <functional>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSet>
+#include <QTextStream>
+#include <QtConcurrentMap>
+#include "packagedata.h"
+#include "packagewriter.h"
+#include "archiveinfo.h"
+#include "archivemanifest.h"
+#include "archiverecompressor.h"
+#include "dependencyresolver.h"
+
+int BatchRecompress::Run (const QString& root, const BatchProcessor::Options& options)
+{
+	QTextStream err (stderr);
+
+	QElapsedTimer timer;
+	timer.start ();
+
+	QStringList errors;
+	const QList<DependencyResolver::Package>& packages =
+			DependencyResolver::LoadRepository (root, errors);
+
+	// Several packages may share an arch/ directory and even an
+	// archive, so list each directory and recompress each archive once.
+	QHash<QString, ArchiveIndex> indexes;
+	QSet<QString> legacy;
+	QSet<QString> shadowed;
+	Q_FOREACH (const DependencyResolver::Package& package, packages)
+	{
+		const QString& archPath = ArchiveIndex::ForPackage (package.FileName_).GetPath ();
+		if (!indexes.contains (archPath))
+			indexes [archPath] = ArchiveIndex (archPath);
+		const ArchiveIndex& index = indexes [archPath];
+
+		const QString& normalizedName = package.Data_.GetNormalizedName ();
+		Q_FOREACH (const QString& version, package.Data_.Versions_)
+		{
+			const VersionArchive& archive = index.Find (normalizedName, version);
+			if (ArchiveRecompressor::IsLegacy (archive.Archiver_))
+				legacy << archive.Path_;
+
+			// These are left behind by an interrupted run.
+			if (archive.Archiver_ == "xz")
+				Q_FOREACH (const QString& archiver, ArchiveIndex::GetKnownArchivers ())
+				{
+					const QString& path = archive.Path_.left (archive.Path_.size () - 2) + archiver;
+					if (ArchiveRecompressor::IsLegacy (archiver) &&
+							!shadowed.contains (path) &&
+							QFile::exists (path))
+						shadowed << path;
+				}
+		}
+	}
+
+	QStringList legacyPaths = legacy.values ();
+	legacyPaths.sort ();
+	const QList<ArchiveRecompressor::Result>& results =
+			ArchiveRecompressor::RecompressAll (legacyPaths, options.Jobs_, options.MemoryLimit_);
+
+	// The descriptions are updated from freshly listed directories,
+	// which also fixes up the packages left behind by an interrupted
+	// run: the new archives are preferred as soon as they exist.
+	indexes.clear ();
+	Q_FOREACH (const DependencyResolver::Package& package, packages)
+	{
+		const QString& archPath = ArchiveIndex::ForPackage (package.FileName_).GetPath ();
+		if (!indexes.contains (archPath))
+			indexes [archPath] = ArchiveIndex (archPath);
+	}
+
+	// The writer doesn't hash anything, so the checksums and manifests
+	// of the new archives are computed here, if asked to, and dropped
+	// as stale otherwise.
+	const QHash<QString, ArchiveIndex>& freshIndexes = indexes;
+	std::function<QString (const DependencyResolver::Package&)> update =
+			[&freshIndexes, &options] (const DependencyResolver::Package& package)
+			{
+				try
+				{
+					const QString& normalizedName = package.Data_.GetNormalizedName ();
+					ArchiveIndex index = freshIndexes.value (ArchiveIndex::ForPackage (package.FileName_).GetPath ());
+					if (options.Checksums_)
+						index.ComputeChecksums (normalizedName, package.Data_.Versions_);
+					if (options.Manifests_)
+					{
+						const QHash<QString, QString>& errors = index.ComputeManifests (normalizedName, package.Data_.Versions_);
+						if (!errors.isEmpty ())
+							return tr ("Could not generate the manifest of %1: %2")
+									.arg (errors.begin ().key ())
+									.arg (errors.begin ().value ());
+					}
+
+					PackageWriter::UpdateArchives (package.FileName_, normalizedName, index);
+					return QString ();
+				}
+				catch (const std::exception& e)
+				{
+					return QString::fromUtf8 (e.what ());
+				}
+			};
+	const QStringList& updateErrors = QtConcurrent::blockingMapped<QStringList> (packages, update);
+
+	// The old archives are removed only when no description that
+	// could still refer to them failed to update.
+	QSet<QString> keep;
+	for (int i = 0; i < packages.size (); ++i)
+	{
+		if (updateErrors.at (i).isEmpty ())
+			continue;
+
+		errors << QString ("%1: %2")
+				.arg (packages.at (i).FileName_)
+				.arg (updateErrors.at (i));
+		keep << ArchiveIndex::ForPackage (packages.at (i).FileName_).GetPath ();
+	}
+
+	QJsonArray archives;
+	qint64 oldTotal = 0;
+	qint64 newTotal = 0;
+	int failed = 0;
+	Q_FOREACH (const ArchiveRecompressor::Result& result, results)
+	{
+		QJsonObject archive;
+		archive ["file"] = result.OldPath_;
+		archive ["oldSize"] = static_cast<double> (result.OldSize_);
+		if (result.Error_.isEmpty ())
+		{
+			archive ["newFile"] = result.NewPath_;
+			archive ["newSize"] = static_cast<double> (result.NewSize_);
+			oldTotal += result.OldSize_;
+			newTotal += result.NewSize_;
+
+			if (!keep.contains (QFileInfo (result.OldPath_).absolutePath ()))
+			{
+				QFile::remove (result.OldPath_);
+				QFile::remove (ArchiveManifest::GetManifestPath (result.OldPath_));
+			}
+		}
+		else
+		{
+			err << result.OldPath_ << ": " << tr ("error:") << ' ' << result.Error_ << endl;
+			archive ["error"] = result.Error_;
+			++failed;
+		}
+		archives.append (archive);
+	}
+
+	Q_FOREACH (const QString& path, shadowed)
+		if (!keep.contains (QFileInfo (path).absolutePath ()))
+		{
+			QFile::remove (path);
+			QFile::remove (ArchiveManifest::GetManifestPath (path));
+		}
+
+	Q_FOREACH (const QString& error, errors)
+		err << tr ("error:") << ' ' << error << endl;
+
+	err << tr ("%1 archives recompressed, %2 failed: %3 bytes saved.")
+			.arg (results.size () - failed)
+			.arg (failed)
+			.arg (oldTotal - newTotal)
+		<< endl;
+
+	QJsonObject summary;
+	summary ["total"] = results.size ();
+	summary ["recompressed"] = results.size () - failed;
+	summary ["failed"] = failed;
+	summary ["oldSize"] = static_cast<double> (oldTotal);
+	summary ["newSize"] = static_cast<double> (newTotal);
+	summary ["errors"] = QJsonArray::fromStringList (errors);
+	summary ["archives"] = archives;
+	summary ["jobs"] = options.Jobs_;
+	summary ["elapsedMs"] = static_cast<double> (timer.elapsed ());
+	if (!BatchProcessor::WriteSummary (summary, options))
+		return 2;
+
+	return failed || !errors.isEmpty () ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef BATCHRECOMPRESS_H
+#define BATCHRECOMPRESS_H
+#include <QCoreApplication>
+#include <QString>
+#include "batchprocessor.h"
+
+/** Batch mode recompressing the legacy archives of a repository to
+ * xz and updating the descriptions referring to them.
+ */
+class BatchRecompress
+{
+	Q_DECLARE_TR_FUNCTIONS (BatchRecompress)
+public:
+	/** Runs the mode for the repository rooted at the given
+	 * directory and returns the exit code.
+	 */
+	static int Run (const QString& root, const BatchProcessor::Options&);
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchresolve.h"
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTextStream>
+#include "dependencyresolver.h"
+
+int BatchResolve::Run (const QString& root, const BatchProcessor::Options& options)
+{
+	QTextStream err (stderr);
+
+	QElapsedTimer timer;
+	timer.start ();
+
+	QStringList errors;
+	const QList<DependencyResolver::Package>& packages =
+			DependencyResolver::LoadRepository (root, errors);
+	const qint64 loadElapsed = timer.restart ();
+
+	const DependencyResolver resolver (packages);
+	const qint64 resolveElapsed = timer.elapsed ();
+
+	Q_FOREACH (const QString& error, errors)
+		err << tr ("error:") << ' ' << error << endl;
+
+	QJsonArray issues;
+	Q_FOREACH (const DependencyResolver::Issue& issue, resolver.GetIssues ())
+	{
+		err << issue.FileName_ << ": " << issue.ThisVersion_ << ": "
+				<< DependencyResolver::IssueTypeToString (issue.Type_) << ": "
+				<< issue.Message_ << endl;
+
+		QJsonObject object;
+		object ["file"] = issue.FileName_;
+		object ["package"] = issue.Package_;
+		object ["version"] = issue.ThisVersion_;
+		object ["type"] = DependencyResolver::IssueTypeToString (issue.Type_);
+		object ["message"] = issue.Message_;
+		issues.append (object);
+	}
+
+	err << tr ("%1 packages, %2 package versions, %3 dependency edges: %4 issues.")
+			.arg (packages.size ())
+			.arg (resolver.GetNodes ().size ())
+			.arg (resolver.GetEdgeCount ())
+			.arg (issues.size ())
+		<< endl;
+
+	QJsonObject summary;
+	summary ["total"] = packages.size () + errors.size ();
+	summary ["nodes"] = resolver.GetNodes ().size ();
+	summary ["edges"] = resolver.GetEdgeCount ();
+	summary ["errors"] = QJsonArray::fromStringList (errors);
+	summary ["issues"] = issues;
+	summary ["loadElapsedMs"] = static_cast<double> (loadElapsed);
+	summary ["resolveElapsedMs"] = static_cast<double> (resolveElapsed);
+	if (!BatchProcessor::WriteSummary (summary, options))
+		return 2;
+
+	if (packages.isEmpty () && errors.isEmpty ())
+	{
+		err << tr ("No package descriptions to process.") << endl;
+		return 2;
+	}
+
+	return issues.isEmpty () && errors.isEmpty () ? 0 : 1;
+}
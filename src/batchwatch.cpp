@@ -0,0 +1,53 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "batchwatch.h"
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+#include "packagewatcher.h"
+
+int BatchWatch::Run (const QString& root, const BatchProcessor::Options& options)
+{
+	if (!QFileInfo (root).isDir ())
+	{
+		QTextStream (stderr) << tr ("%1 is not a directory.").arg (root) << endl;
+		return 2;
+	}
+
+	PackageWatcher watcher (root, options.DebounceMs_, options.Checksums_);
+	QObject::connect (&watcher,
+			&PackageWatcher::descriptionUpdated,
+			[] (const QString& fileName, const QStringList& newVersions)
+			{
+				QTextStream err (stderr);
+				err << fileName << ": " << tr ("updated");
+				if (!newVersions.isEmpty ())
+					err << ", " << tr ("new versions: %1").arg (newVersions.join (", "));
+				err << endl;
+			});
+	QObject::connect (&watcher,
+			&PackageWatcher::error,
+			[] (const QString& fileName, const QString& message)
+			{
+				QTextStream (stderr) << fileName << ": " << tr ("error:") << ' ' << message << endl;
+			});
+
+	watcher.Start ();
+	return QCoreApplication::exec ();
+}
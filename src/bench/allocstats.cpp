@@ -0,0 +1,212 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "allocstats.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace
+{
+	// Signed, so that freeing the few blocks allocated before the
+	// counting started can't wrap the amount around.
+	std::atomic<long long> Current (0);
+	std::atomic<long long> Peak (0);
+	std::atomic<long long> Base (0);
+	std::atomic<size_t> Count (0);
+
+	void Account (size_t size)
+	{
+		++Count;
+		const long long current = Current += size;
+		long long peak = Peak.load ();
+		while (current > peak && !Peak.compare_exchange_weak (peak, current))
+			;
+	}
+}
+
+#ifdef __GLIBC__
+
+// Qt allocates the storage of its containers and strings with malloc()
+// and realloc() rather than operator new, so the C allocator itself is
+// interposed, and operator new, which calls malloc(), is counted along.
+// The block sizes are taken from the allocator.
+
+namespace
+{
+	void* Track (void *ptr)
+	{
+		if (ptr)
+			Account (malloc_usable_size (ptr));
+		return ptr;
+	}
+}
+
+extern "C"
+{
+	void* __libc_malloc (size_t);
+	void* __libc_calloc (size_t, size_t);
+	void* __libc_realloc (void*, size_t);
+	void* __libc_memalign (size_t, size_t);
+	void* __libc_valloc (size_t);
+	void* __libc_pvalloc (size_t);
+	void __libc_free (void*);
+
+	void* malloc (size_t size) noexcept
+	{
+		return Track (__libc_malloc (size));
+	}
+
+	void* calloc (size_t count, size_t size) noexcept
+	{
+		return Track (__libc_calloc (count, size));
+	}
+
+	void* realloc (void *ptr, size_t size) noexcept
+	{
+		const long long oldSize = ptr ? malloc_usable_size (ptr) : 0;
+		void *result = __libc_realloc (ptr, size);
+		if (!result)
+			return size ? result : 0;
+
+		// A reallocation is an allocation as far as the count goes.
+		Current -= oldSize;
+		return Track (result);
+	}
+
+	void* memalign (size_t alignment, size_t size) noexcept
+	{
+		return Track (__libc_memalign (alignment, size));
+	}
+
+	void* aligned_alloc (size_t alignment, size_t size) noexcept
+	{
+		return Track (__libc_memalign (alignment, size));
+	}
+
+	int posix_memalign (void **ptr, size_t alignment, size_t size) noexcept
+	{
+		void *result = __libc_memalign (alignment, size);
+		if (!result)
+			return ENOMEM;
+		*ptr = Track (result);
+		return 0;
+	}
+
+	void* valloc (size_t size) noexcept
+	{
+		return Track (__libc_valloc (size));
+	}
+
+	void* pvalloc (size_t size) noexcept
+	{
+		return Track (__libc_pvalloc (size));
+	}
+
+	void free (void *ptr) noexcept
+	{
+		if (!ptr)
+			return;
+
+		Current -= static_cast<long long> (malloc_usable_size (ptr));
+		__libc_free (ptr);
+	}
+}
+
+#else
+
+namespace
+{
+	// Without a way to interpose the C allocator, only operator new
+	// is counted. The block size is kept in front of the block,
+	// padded so that the returned pointer stays suitably aligned.
+	const size_t HeaderSize = 16;
+
+	void* Allocate (size_t size)
+	{
+		char *block = static_cast<char*> (std::malloc (size + HeaderSize));
+		if (!block)
+			throw std::bad_alloc ();
+
+		*reinterpret_cast<size_t*> (block) = size;
+		Account (size);
+		return block + HeaderSize;
+	}
+
+	void Deallocate (void *ptr)
+	{
+		if (!ptr)
+			return;
+
+		char *block = static_cast<char*> (ptr) - HeaderSize;
+		Current -= static_cast<long long> (*reinterpret_cast<size_t*> (block));
+		std::free (block);
+	}
+}
+
+void* operator new (size_t size)
+{
+	return Allocate (size);
+}
+
+void* operator new[] (size_t size)
+{
+	return Allocate (size);
+}
+
+void operator delete (void *ptr) noexcept
+{
+	Deallocate (ptr);
+}
+
+void operator delete[] (void *ptr) noexcept
+{
+	Deallocate (ptr);
+}
+
+#endif
+
+namespace AllocStats
+{
+	bool CountsMalloc ()
+	{
+#ifdef __GLIBC__
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void Reset ()
+	{
+		Count = 0;
+		Base = Current.load ();
+		Peak = Base.load ();
+	}
+
+	Snapshot Get ()
+	{
+		const Snapshot snapshot = { Count.load (), static_cast<size_t> (Peak.load () - Base.load ()) };
+		return snapshot;
+	}
+}
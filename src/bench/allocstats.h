@@ -0,0 +1,53 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef BENCH_ALLOCSTATS_H
+#define BENCH_ALLOCSTATS_H
+#include <cstddef>
+
+/** Global allocation counters of the benchmark binary.
+ *
+ * With glibc, malloc() and friends are interposed, so everything is
+ * counted, Qt containers and strings included. Elsewhere only the
+ * replacement operator new and operator delete are.
+ */
+namespace AllocStats
+{
+	struct Snapshot
+	{
+		size_t Allocations_;
+		size_t PeakBytes_;
+	};
+
+	/** Returns whether the C allocator is counted, and not just
+	 * operator new.
+	 */
+	bool CountsMalloc ();
+
+	/** Resets the allocation count and makes the peak equal to the
+	 * currently allocated amount.
+	 */
+	void Reset ();
+
+	/** Returns the number of allocations since the last Reset() and
+	 * the peak of allocated bytes above the amount at that Reset().
+	 */
+	Snapshot Get ();
+}
+
+#endif
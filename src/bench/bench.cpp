@@ -0,0 +1,267 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QXmlStreamWriter>
+#include "../packagedata.h"
+#include "../packageloader.h"
+#include "../packagesnapshot.h"
+#include "../packagevalidator.h"
+#include "../packagewriter.h"
+#include "../archiveinfo.h"
+#include "allocstats.h"
+
+/* Load, validation and save benchmarks on synthetic packages.
+ *
+ * For each size a package description with N versions, M
+ * dependencies and K images is generated in a temporary directory,
+ * together with an arch/ subdirectory holding a small archive per
+ * version. Every operation is then timed, and its peak heap usage and
+ * allocation count are reported as tab-separated values.
+ *
+ * The GUI isn't involved: "load" is the parse MainWindow::Open falls
+ * back to when the description has no up to date snapshot, "snapshot"
+ * is what it does when there is one, "index" is the archive scan it does next,
+ * "validate" and "revalidate" are what checkValid() does after
+ * opening and after editing a single field, and "save" is what the
+ * Save action does.
+ */
+
+namespace
+{
+	struct Size
+	{
+		int Versions_;
+		int Deps_;
+		int Images_;
+	};
+
+	const QString Name = "Synthetic";
+
+	QString MakeVersion (int i)
+	{
+		return QString ("1.%1.%2").arg (i / 100).arg (i % 100);
+	}
+
+	void WriteSynthetic (const QString& dir, const Size& size)
+	{
+		QDir (dir).mkpath ("arch");
+		for (int i = 0; i < size.Versions_; ++i)
+		{
+			QFile archive (QString ("%1/arch/%2-%3.tar.xz")
+					.arg (dir)
+					.arg (Name)
+					.arg (MakeVersion (i)));
+			if (!archive.open (QIODevice::WriteOnly))
+				throw std::runtime_error ("unable to create synthetic archive");
+			archive.write (QByteArray (64 + i % 512, 'x'));
+		}
+
+		QFile file (dir + "/" + Name + ".xml");
+		if (!file.open (QIODevice::WriteOnly))
+			throw std::runtime_error ("unable to create synthetic package");
+
+		QXmlStreamWriter w (&file);
+		w.setAutoFormatting (true);
+		w.writeStartDocument ();
+		w.writeStartElement ("package");
+		w.writeAttribute ("type", "plugin");
+		w.writeAttribute ("language", "python");
+		w.writeTextElement ("name", Name);
+		w.writeTextElement ("description", "Benchmark package");
+		w.writeStartElement ("tags");
+		w.writeTextElement ("tag", "bench");
+		w.writeEndElement ();
+
+		w.writeStartElement ("versions");
+		for (int i = 0; i < size.Versions_; ++i)
+		{
+			w.writeStartElement ("version");
+			w.writeAttribute ("size", "1024");
+			w.writeAttribute ("archiver", "xz");
+			w.writeCharacters (MakeVersion (i));
+			w.writeEndElement ();
+		}
+		w.writeEndElement ();
+
+		w.writeStartElement ("images");
+		w.writeEmptyElement ("icon");
+		w.writeAttribute ("url", "http://example.org/icon.png");
+		for (int i = 0; i < size.Images_; ++i)
+		{
+			w.writeEmptyElement (i % 2 ? "screenshot" : "thumbnail");
+			w.writeAttribute ("url", QString ("http://example.org/shot%1.png").arg (i));
+		}
+		w.writeEndElement ();
+
+		w.writeTextElement ("long", QString (4096, 'x'));
+		w.writeStartElement ("maintainer");
+		w.writeTextElement ("name", "Bench");
+		w.writeTextElement ("email", "bench@example.org");
+		w.writeEndElement ();
+
+		w.writeStartElement ("depends");
+		for (int i = 0; i < size.Deps_; ++i)
+		{
+			w.writeEmptyElement ("depend");
+			w.writeAttribute ("type", i % 2 ? "require" : "provide");
+			w.writeAttribute ("thisVersion", MakeVersion (i % std::max (size.Versions_, 1)));
+			w.writeAttribute ("name", QString ("interface://iface%1").arg (i));
+			w.writeAttribute ("version", "1.0");
+		}
+		w.writeEndElement ();
+
+		w.writeEndElement ();
+		w.writeEndDocument ();
+	}
+
+	class Reporter
+	{
+		QTextStream Out_;
+	public:
+		Reporter ()
+		: Out_ (stdout)
+		{
+			// Without the C allocator, Qt's own allocations are missed.
+			const char *suffix = AllocStats::CountsMalloc () ? "" : " (operator new only)";
+			Out_ << "versions\tdeps\timages\top\titerations\tusec/op\t"
+					<< "peakKiB" << suffix << "\tallocs/op" << suffix << endl;
+		}
+
+		void Run (const Size& size, const char *op, int iterations, const std::function<void ()>& func)
+		{
+			// The first run pages in the generated files and fills
+			// whatever caches there are, so it isn't accounted.
+			func ();
+
+			AllocStats::Reset ();
+
+			QElapsedTimer timer;
+			timer.start ();
+			for (int i = 0; i < iterations; ++i)
+				func ();
+			const qint64 elapsed = timer.nsecsElapsed ();
+
+			const AllocStats::Snapshot& stats = AllocStats::Get ();
+
+			Out_ << size.Versions_ << '\t'
+					<< size.Deps_ << '\t'
+					<< size.Images_ << '\t'
+					<< op << '\t'
+					<< iterations << '\t'
+					<< elapsed / 1000 / iterations << '\t'
+					<< stats.PeakBytes_ / 1024 << '\t'
+					<< stats.Allocations_ / iterations << endl;
+		}
+	};
+}
+
+int main (int argc, char **argv)
+{
+	QCoreApplication app (argc, argv);
+
+	// Keep the snapshots of the synthetic packages out of the real
+	// cache directory.
+	QStandardPaths::setTestModeEnabled (true);
+
+	int maxScale = 10000;
+	if (app.arguments ().size () > 1)
+		maxScale = app.arguments ().at (1).toInt ();
+
+	QTemporaryDir tempDir;
+	if (!tempDir.isValid ())
+		return 1;
+
+	QList<Size> sizes;
+	for (int n = 10; n <= maxScale; n *= 10)
+	{
+		const Size versions = { n, 10, 10 };
+		const Size deps = { 10, n, 10 };
+		const Size all = { n, n, n / 10 };
+		sizes << versions << deps << all;
+	}
+
+	Reporter reporter;
+
+	Q_FOREACH (const Size& size, sizes)
+	{
+		const QString& dir = tempDir.path () + QString ("/%1-%2-%3")
+				.arg (size.Versions_)
+				.arg (size.Deps_)
+				.arg (size.Images_);
+		WriteSynthetic (dir, size);
+
+		const QString& fileName = dir + "/" + Name + ".xml";
+		const QString& outName = dir + "/" + Name + "-out.xml";
+		const int iterations = std::max (1, 20000 / (size.Versions_ + size.Deps_));
+
+		QStringList warnings;
+		const PackageData& data = PackageLoader::Load (fileName, warnings);
+		const ArchiveIndex& index = ArchiveIndex::ForPackage (fileName);
+
+		reporter.Run (size, "load", iterations,
+				[&fileName]
+				{
+					QStringList warnings;
+					PackageLoader::Load (fileName, warnings);
+				});
+		PackageSnapshot::Load (fileName, warnings);
+		reporter.Run (size, "snapshot", iterations,
+				[&fileName]
+				{
+					QStringList warnings;
+					PackageSnapshot::Load (fileName, warnings);
+				});
+		reporter.Run (size, "index", iterations,
+				[&fileName] { ArchiveIndex::ForPackage (fileName); });
+		reporter.Run (size, "validate", iterations,
+				[&data, &index] { PackageValidator ().Validate (data, index); });
+
+		PackageValidator validator;
+		validator.Validate (data, index);
+		reporter.Run (size, "revalidate", iterations,
+				[&data, &index, &validator]
+				{
+					validator.Invalidate (PackageValidator::FLongDescription);
+					validator.Validate (data, index);
+				});
+
+		reporter.Run (size, "serialize", iterations,
+				[&data, &index] { PackageWriter::Serialize (data, index); });
+		reporter.Run (size, "save", iterations,
+				[&data, &index, &outName]
+				{
+					QFile::remove (outName);
+					PackageWriter::Save (data, outName, index, QString ());
+				});
+		reporter.Run (size, "save-unchanged", iterations,
+				[&data, &index, &outName] { PackageWriter::Save (data, outName, index, outName); });
+	}
+
+	return 0;
+}
@@ -0,0 +1,41 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include <QCoreApplication>
+#include "batchprocessor.h"
+#include "tracing.h"
+
+/* Console-only entry point for the headless modes.
+ *
+ * The GUI executable is a WIN32 one on Windows, which has no console,
+ * so anything the batch modes print there is lost and the shell
+ * doesn't wait for them to finish. This executable doesn't link to
+ * QtWidgets and always runs the batch processor, so it is the one to
+ * use from scripts.
+ */
+
+int main (int argc, char **argv)
+{
+	Tracing::InitFromEnvironment ();
+
+	QCoreApplication app (argc, argv);
+	app.setApplicationName ("lcpackgen");
+	const int result = BatchProcessor ().Run (app.arguments ());
+	Tracing::Finish ();
+	return result;
+}
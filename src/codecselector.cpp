@@ -0,0 +1,324 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "codecselector.h"
+#include <stdexcept>
+#include <cstdio>
+#include <functional>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QtConcurrentMap>
+#include "decompressor.h"
+#include "archiveinfo.h"
+#include "archivemanifest.h"
+
+CodecSelector::Policy::Policy ()
+: Goal_ (GSmallest)
+, SizeBudget_ (10)
+{
+}
+
+CodecSelector::Candidate::Candidate ()
+: Size_ (-1)
+, DecompressUSecs_ (-1)
+{
+}
+
+namespace
+{
+	struct Job
+	{
+		QString Archiver_;
+		QString TarPath_;
+		QString TempTemplate_;
+		CompressionParams Params_;
+	};
+
+	struct Output
+	{
+		CodecSelector::Candidate Candidate_;
+		QString TempPath_;
+	};
+
+	void Compress (const Job& job, QFile& out)
+	{
+		QFile in (job.TarPath_);
+		if (!in.open (QIODevice::ReadOnly))
+			throw std::runtime_error (CodecSelector::tr ("Could not open %1: %2.")
+					.arg (job.TarPath_)
+					.arg (in.errorString ())
+					.toUtf8 ().constData ());
+
+		const std::unique_ptr<Compressor> compressor =
+				Compressor::Create (job.Archiver_, &out, job.Params_);
+
+		QByteArray buffer (256 * 1024, 0);
+		qint64 read = 0;
+		while ((read = in.read (buffer.data (), buffer.size ())) > 0)
+			compressor->Write (buffer.constData (), read);
+		if (read < 0)
+			throw std::runtime_error (CodecSelector::tr ("Could not read %1: %2.")
+					.arg (job.TarPath_)
+					.arg (in.errorString ())
+					.toUtf8 ().constData ());
+
+		compressor->Finish ();
+		if (!out.flush ())
+			throw std::runtime_error (CodecSelector::tr ("Could not write compressed data: %1.")
+					.arg (out.errorString ())
+					.toUtf8 ().constData ());
+	}
+
+	/** Decompresses the archive, feeding the contents into the hash,
+	 * and returns the time it took in microseconds, not counting the
+	 * hashing.
+	 */
+	qint64 Decompress (const QString& archiver, const QString& path, QCryptographicHash& hash)
+	{
+		QElapsedTimer timer;
+		timer.start ();
+
+		QFile in (path);
+		if (!in.open (QIODevice::ReadOnly))
+			throw std::runtime_error (CodecSelector::tr ("Could not open %1: %2.")
+					.arg (path)
+					.arg (in.errorString ())
+					.toUtf8 ().constData ());
+
+		const std::unique_ptr<Decompressor> decompressor = Decompressor::Create (archiver, &in);
+
+		QByteArray buffer (256 * 1024, 0);
+		qint64 hashing = 0;
+		while (const qint64 read = decompressor->Read (buffer.data (), buffer.size ()))
+		{
+			QElapsedTimer hashTimer;
+			hashTimer.start ();
+			hash.addData (buffer.constData (), static_cast<int> (read));
+			hashing += hashTimer.nsecsElapsed ();
+		}
+		return (timer.nsecsElapsed () - hashing) / 1000;
+	}
+
+	QByteArray HashFile (const QString& path)
+	{
+		QFile in (path);
+		QCryptographicHash hash (QCryptographicHash::Sha1);
+		if (!in.open (QIODevice::ReadOnly) ||
+				!hash.addData (&in))
+			throw std::runtime_error (CodecSelector::tr ("Could not read %1: %2.")
+					.arg (path)
+					.arg (in.errorString ())
+					.toUtf8 ().constData ());
+		return hash.result ();
+	}
+
+	Output Run (const Job& job)
+	{
+		Output output;
+		output.Candidate_.Archiver_ = job.Archiver_;
+
+		QTemporaryFile temp (job.TempTemplate_);
+		temp.setAutoRemove (false);
+		if (!temp.open ())
+		{
+			output.Candidate_.Error_ = temp.errorString ();
+			return output;
+		}
+		output.TempPath_ = temp.fileName ();
+
+		try
+		{
+			Compress (job, temp);
+			temp.close ();
+			output.Candidate_.Size_ = QFileInfo (output.TempPath_).size ();
+		}
+		catch (const std::exception& e)
+		{
+			output.Candidate_.Error_ = QString::fromUtf8 (e.what ());
+		}
+
+		return output;
+	}
+
+	/** Times the decompression of the compressed archive and checks
+	 * that it gives back the tar having the given SHA-1.
+	 *
+	 * This is done for one candidate at a time, once all of them have
+	 * been compressed, so that neither the other decompressions nor
+	 * the multithreaded compressors skew the timings.
+	 */
+	void Measure (Output& output, const QByteArray& tarHash)
+	{
+		if (!output.Candidate_.Error_.isEmpty ())
+			return;
+
+		try
+		{
+			// The archive has just been written, so it is in the page
+			// cache and this measures the codec rather than the disk.
+			QCryptographicHash hash (QCryptographicHash::Sha1);
+			output.Candidate_.DecompressUSecs_ = Decompress (output.Candidate_.Archiver_, output.TempPath_, hash);
+
+			if (hash.result () != tarHash)
+				throw std::runtime_error (CodecSelector::tr ("Round-trip check failed: the decompressed data differs from the tar.")
+						.toUtf8 ().constData ());
+		}
+		catch (const std::exception& e)
+		{
+			output.Candidate_.Error_ = QString::fromUtf8 (e.what ());
+		}
+	}
+
+	int Choose (const QList<Output>& outputs, const CodecSelector::Policy& policy)
+	{
+		int smallest = -1;
+		for (int i = 0; i < outputs.size (); ++i)
+		{
+			const CodecSelector::Candidate& c = outputs.at (i).Candidate_;
+			if (c.Error_.isEmpty () &&
+					(smallest == -1 || c.Size_ < outputs.at (smallest).Candidate_.Size_))
+				smallest = i;
+		}
+
+		if (smallest == -1 || policy.Goal_ == CodecSelector::GSmallest)
+			return smallest;
+
+		const qint64 budget = outputs.at (smallest).Candidate_.Size_ * (100 + policy.SizeBudget_) / 100;
+		int fastest = smallest;
+		for (int i = 0; i < outputs.size (); ++i)
+		{
+			const CodecSelector::Candidate& c = outputs.at (i).Candidate_;
+			if (c.Error_.isEmpty () &&
+					c.Size_ <= budget &&
+					c.DecompressUSecs_ < outputs.at (fastest).Candidate_.DecompressUSecs_)
+				fastest = i;
+		}
+		return fastest;
+	}
+
+	bool ReplaceFile (const QString& from, const QString& to)
+	{
+		// rename() atomically replaces the target on POSIX systems,
+		// elsewhere it has to be removed first.
+		if (!std::rename (QFile::encodeName (from).constData (), QFile::encodeName (to).constData ()))
+			return true;
+
+		QFile::remove (to);
+		return QFile::rename (from, to);
+	}
+}
+
+CodecSelector::Result CodecSelector::Select (const QString& tarPath, const QString& archDir,
+		const QString& normalizedName, const QString& version,
+		const Policy& policy, const CompressionParams& params)
+{
+	if (!QDir ().mkpath (archDir))
+		throw std::runtime_error (tr ("Could not create directory %1.")
+				.arg (archDir)
+				.toUtf8 ().constData ());
+
+	const QString& stem = QDir (archDir).filePath (normalizedName + '-' + version + ".tar.");
+
+	QList<Job> jobs;
+	Q_FOREACH (const QString& archiver, Compressor::GetSupportedArchivers ())
+	{
+		// The temporary files don't end with a known archiver, so the
+		// archive index never picks them up.
+		const Job job = { archiver, tarPath, stem + archiver + ".XXXXXX", params };
+		jobs << job;
+	}
+
+	std::function<Output (const Job&)> func = &Run;
+	QList<Output> outputs = QtConcurrent::blockingMapped<QList<Output>> (jobs, func);
+
+	QByteArray tarHash;
+	try
+	{
+		tarHash = HashFile (tarPath);
+	}
+	catch (...)
+	{
+		Q_FOREACH (const Output& output, outputs)
+			if (!output.TempPath_.isEmpty ())
+				QFile::remove (output.TempPath_);
+		throw;
+	}
+
+	for (int i = 0; i < outputs.size (); ++i)
+		Measure (outputs [i], tarHash);
+
+	const int chosen = Choose (outputs, policy);
+
+	Result result;
+	for (int i = 0; i < outputs.size (); ++i)
+	{
+		result.Candidates_ << outputs.at (i).Candidate_;
+		if (i != chosen && !outputs.at (i).TempPath_.isEmpty ())
+			QFile::remove (outputs.at (i).TempPath_);
+	}
+
+	if (chosen == -1)
+		throw std::runtime_error (tr ("Could not compress %1 with any archiver.")
+				.arg (tarPath)
+				.toUtf8 ().constData ());
+
+	result.Archiver_ = outputs.at (chosen).Candidate_.Archiver_;
+	result.Path_ = stem + result.Archiver_;
+
+	// QTemporaryFile creates its files readable by the owner only,
+	// but the archive has to be readable by the package server.
+	const QFile::Permissions permissions = QFile::ReadOwner | QFile::WriteOwner |
+			QFile::ReadUser | QFile::WriteUser |
+			QFile::ReadGroup |
+			QFile::ReadOther;
+	if (!QFile::setPermissions (outputs.at (chosen).TempPath_, permissions) ||
+			!ReplaceFile (outputs.at (chosen).TempPath_, result.Path_))
+	{
+		QFile::remove (outputs.at (chosen).TempPath_);
+		throw std::runtime_error (tr ("Could not write file %1.")
+				.arg (result.Path_)
+				.toUtf8 ().constData ());
+	}
+
+	// The archive index prefers some archivers over others, so stale
+	// archives for this version would shadow the chosen one.
+	Q_FOREACH (const QString& archiver, ArchiveIndex::GetKnownArchivers ())
+		if (archiver != result.Archiver_)
+		{
+			QFile::remove (stem + archiver);
+			QFile::remove (ArchiveManifest::GetManifestPath (stem + archiver));
+		}
+
+	return result;
+}
+
+bool CodecSelector::ParseGoal (const QString& str, Goal& goal)
+{
+	if (str == "smallest")
+		goal = GSmallest;
+	else if (str == "fastest")
+		goal = GFastestDecompression;
+	else
+		return false;
+	return true;
+}
@@ -0,0 +1,99 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef CODECSELECTOR_H
+#define CODECSELECTOR_H
+#include <QCoreApplication>
+#include <QList>
+#include <QString>
+#include "compressor.h"
+
+/** Picks the archiver for a version archive from measurements.
+ *
+ * An uncompressed tar is compressed with every supported archiver in
+ * parallel. Then each result is decompressed again, one at a time, to
+ * check it and to measure how long clients will spend unpacking it,
+ * and the archive best fitting the policy is kept as
+ * arch/NAME-VERSION.tar.ARCHIVER. Archives of the same version made
+ * with other archivers are removed, so that the chosen one is what
+ * ends up in the archiver attribute.
+ */
+class CodecSelector
+{
+	Q_DECLARE_TR_FUNCTIONS (CodecSelector)
+public:
+	enum Goal
+	{
+		/** Keep the smallest archive.
+		 */
+		GSmallest,
+
+		/** Keep the archive that is the fastest to decompress among
+		 * those fitting into the size budget.
+		 */
+		GFastestDecompression
+	};
+
+	struct Policy
+	{
+		Goal Goal_;
+
+		/** How much larger than the smallest one an archive may be,
+		 * in percent, to be considered by GFastestDecompression.
+		 */
+		int SizeBudget_;
+
+		Policy ();
+	};
+
+	struct Candidate
+	{
+		QString Archiver_;
+		qint64 Size_;
+		qint64 DecompressUSecs_;
+
+		/** Set if the archiver failed, in which case the candidate
+		 * is never chosen.
+		 */
+		QString Error_;
+
+		Candidate ();
+	};
+
+	struct Result
+	{
+		QString Path_;
+		QString Archiver_;
+		QList<Candidate> Candidates_;
+	};
+
+	/** Compresses the given tar, keeps the best archive according to
+	 * the policy and returns its path along with all the measurements,
+	 * throwing std::runtime_error if no archiver succeeded.
+	 */
+	static Result Select (const QString& tarPath, const QString& archDir,
+			const QString& normalizedName, const QString& version,
+			const Policy&, const CompressionParams& = CompressionParams ());
+
+	/** Parses "smallest" or "fastest", returning false for anything
+	 * else.
+	 */
+	static bool ParseGoal (const QString&, Goal&);
+};
+
+#endif
@@ -0,0 +1,413 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "compressor.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <QIODevice>
+#include <QStringList>
+#include <QThread>
+#include <lzma.h>
+#include <bzlib.h>
+#include <zlib.h>
+#ifdef LCPACKGEN_ZSTD
+#include <zstd.h>
+#endif
+
+ByteSink::~ByteSink ()
+{
+}
+
+CompressionParams::CompressionParams ()
+: Level_ (6)
+, Threads_ (0)
+, MemoryLimit_ (0)
+{
+}
+
+Compressor::Compressor (QIODevice *out)
+: Out_ (out)
+{
+}
+
+void Compressor::WriteOut (const char *data, qint64 size)
+{
+	if (Out_->write (data, size) != size)
+		throw std::runtime_error (tr ("Could not write compressed data: %1.")
+				.arg (Out_->errorString ())
+				.toUtf8 ().constData ());
+}
+
+namespace
+{
+	const size_t BufferSize = 256 * 1024;
+
+	class LzmaCompressor : public Compressor
+	{
+		lzma_stream Stream_;
+		const QString Codec_;
+		QByteArray Buffer_;
+	public:
+		LzmaCompressor (QIODevice *out, const CompressionParams& params, bool alone)
+		: Compressor (out)
+		, Codec_ (alone ? "lzma" : "xz")
+		, Buffer_ (BufferSize, 0)
+		{
+			const lzma_stream init = LZMA_STREAM_INIT;
+			Stream_ = init;
+
+			const lzma_ret ret = alone ?
+					InitAlone (params) :
+					InitXz (params);
+			if (ret != LZMA_OK)
+				throw std::runtime_error (tr ("Could not initialize the %1 encoder (error %2).")
+						.arg (Codec_)
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			ResetOutput ();
+		}
+
+		~LzmaCompressor ()
+		{
+			lzma_end (&Stream_);
+		}
+
+		void Write (const char *data, qint64 size)
+		{
+			Stream_.next_in = reinterpret_cast<const uint8_t*> (data);
+			Stream_.avail_in = size;
+			while (Stream_.avail_in)
+				Code (LZMA_RUN);
+		}
+
+		void Finish ()
+		{
+			while (Code (LZMA_FINISH) != LZMA_STREAM_END)
+				;
+			FlushOutput ();
+		}
+	private:
+		lzma_ret InitXz (const CompressionParams& params)
+		{
+			lzma_mt mt;
+			std::memset (&mt, 0, sizeof (mt));
+			mt.preset = params.Level_;
+			mt.check = LZMA_CHECK_CRC64;
+			mt.threads = params.Threads_ > 0 ?
+					params.Threads_ :
+					std::max (QThread::idealThreadCount (), 1);
+
+			// Each encoder thread keeps its own block buffers, so
+			// trade parallelism for memory until we fit the limit.
+			if (params.MemoryLimit_)
+				while (mt.threads > 1 &&
+						lzma_stream_encoder_mt_memusage (&mt) > params.MemoryLimit_)
+					--mt.threads;
+
+			return lzma_stream_encoder_mt (&Stream_, &mt);
+		}
+
+		lzma_ret InitAlone (const CompressionParams& params)
+		{
+			// The legacy .lzma format has no multithreaded encoder.
+			lzma_options_lzma options;
+			if (lzma_lzma_preset (&options, params.Level_))
+				return LZMA_OPTIONS_ERROR;
+			return lzma_alone_encoder (&Stream_, &options);
+		}
+
+		lzma_ret Code (lzma_action action)
+		{
+			const lzma_ret ret = lzma_code (&Stream_, action);
+			if (ret != LZMA_OK && ret != LZMA_STREAM_END)
+				throw std::runtime_error (tr ("%1 compression failed (error %2).")
+						.arg (Codec_)
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			if (!Stream_.avail_out)
+				FlushOutput ();
+			return ret;
+		}
+
+		void FlushOutput ()
+		{
+			WriteOut (Buffer_.constData (), Buffer_.size () - Stream_.avail_out);
+			ResetOutput ();
+		}
+
+		void ResetOutput ()
+		{
+			Stream_.next_out = reinterpret_cast<uint8_t*> (Buffer_.data ());
+			Stream_.avail_out = Buffer_.size ();
+		}
+	};
+
+	class Bz2Compressor : public Compressor
+	{
+		bz_stream Stream_;
+		QByteArray Buffer_;
+	public:
+		Bz2Compressor (QIODevice *out, const CompressionParams& params)
+		: Compressor (out)
+		, Buffer_ (BufferSize, 0)
+		{
+			std::memset (&Stream_, 0, sizeof (Stream_));
+
+			// The block size is the closest thing bzip2 has to a
+			// compression level, and it can't be 0.
+			const int ret = BZ2_bzCompressInit (&Stream_, std::max (params.Level_, 1), 0, 0);
+			if (ret != BZ_OK)
+				throw std::runtime_error (tr ("Could not initialize the bzip2 encoder (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			ResetOutput ();
+		}
+
+		~Bz2Compressor ()
+		{
+			BZ2_bzCompressEnd (&Stream_);
+		}
+
+		void Write (const char *data, qint64 size)
+		{
+			// avail_in is 32-bit, so feed huge writes in pieces.
+			while (size)
+			{
+				const qint64 chunk = std::min<qint64> (size, 1 << 30);
+				Stream_.next_in = const_cast<char*> (data);
+				Stream_.avail_in = chunk;
+				while (Stream_.avail_in)
+					Code (BZ_RUN);
+				data += chunk;
+				size -= chunk;
+			}
+		}
+
+		void Finish ()
+		{
+			while (Code (BZ_FINISH) != BZ_STREAM_END)
+				;
+			FlushOutput ();
+		}
+	private:
+		int Code (int action)
+		{
+			const int ret = BZ2_bzCompress (&Stream_, action);
+			if (ret != BZ_RUN_OK && ret != BZ_FINISH_OK && ret != BZ_STREAM_END)
+				throw std::runtime_error (tr ("bzip2 compression failed (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			if (!Stream_.avail_out)
+				FlushOutput ();
+			return ret;
+		}
+
+		void FlushOutput ()
+		{
+			WriteOut (Buffer_.constData (), Buffer_.size () - Stream_.avail_out);
+			ResetOutput ();
+		}
+
+		void ResetOutput ()
+		{
+			Stream_.next_out = Buffer_.data ();
+			Stream_.avail_out = Buffer_.size ();
+		}
+	};
+
+	class GzCompressor : public Compressor
+	{
+		z_stream Stream_;
+		QByteArray Buffer_;
+	public:
+		GzCompressor (QIODevice *out, const CompressionParams& params)
+		: Compressor (out)
+		, Buffer_ (BufferSize, 0)
+		{
+			std::memset (&Stream_, 0, sizeof (Stream_));
+
+			const int ret = deflateInit2 (&Stream_, params.Level_, Z_DEFLATED,
+					16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+			if (ret != Z_OK)
+				throw std::runtime_error (tr ("Could not initialize the gzip encoder (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			ResetOutput ();
+		}
+
+		~GzCompressor ()
+		{
+			deflateEnd (&Stream_);
+		}
+
+		void Write (const char *data, qint64 size)
+		{
+			while (size)
+			{
+				const qint64 chunk = std::min<qint64> (size, 1 << 30);
+				Stream_.next_in = reinterpret_cast<Bytef*> (const_cast<char*> (data));
+				Stream_.avail_in = chunk;
+				while (Stream_.avail_in)
+					Code (Z_NO_FLUSH);
+				data += chunk;
+				size -= chunk;
+			}
+		}
+
+		void Finish ()
+		{
+			while (Code (Z_FINISH) != Z_STREAM_END)
+				;
+			FlushOutput ();
+		}
+	private:
+		int Code (int flush)
+		{
+			const int ret = deflate (&Stream_, flush);
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+				throw std::runtime_error (tr ("gzip compression failed (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+
+			if (!Stream_.avail_out)
+				FlushOutput ();
+			return ret;
+		}
+
+		void FlushOutput ()
+		{
+			WriteOut (Buffer_.constData (), Buffer_.size () - Stream_.avail_out);
+			ResetOutput ();
+		}
+
+		void ResetOutput ()
+		{
+			Stream_.next_out = reinterpret_cast<Bytef*> (Buffer_.data ());
+			Stream_.avail_out = Buffer_.size ();
+		}
+	};
+
+#ifdef LCPACKGEN_ZSTD
+	class ZstdCompressor : public Compressor
+	{
+		ZSTD_CCtx * const Context_;
+		QByteArray Buffer_;
+		ZSTD_outBuffer Output_;
+	public:
+		ZstdCompressor (QIODevice *out, const CompressionParams& params)
+		: Compressor (out)
+		, Context_ (ZSTD_createCCtx ())
+		, Buffer_ (ZSTD_CStreamOutSize (), 0)
+		{
+			if (!Context_)
+				throw std::runtime_error (tr ("Could not initialize the zstd encoder.")
+						.toUtf8 ().constData ());
+
+			Check (ZSTD_CCtx_setParameter (Context_, ZSTD_c_compressionLevel, params.Level_));
+			Check (ZSTD_CCtx_setParameter (Context_, ZSTD_c_checksumFlag, 1));
+
+			ResetOutput ();
+		}
+
+		~ZstdCompressor ()
+		{
+			ZSTD_freeCCtx (Context_);
+		}
+
+		void Write (const char *data, qint64 size)
+		{
+			ZSTD_inBuffer input = { data, static_cast<size_t> (size), 0 };
+			while (input.pos < input.size)
+				Code (input, ZSTD_e_continue);
+		}
+
+		void Finish ()
+		{
+			ZSTD_inBuffer input = { 0, 0, 0 };
+			while (Code (input, ZSTD_e_end))
+				;
+			FlushOutput ();
+		}
+	private:
+		size_t Check (size_t ret)
+		{
+			if (ZSTD_isError (ret))
+				throw std::runtime_error (tr ("zstd compression failed: %1.")
+						.arg (ZSTD_getErrorName (ret))
+						.toUtf8 ().constData ());
+			return ret;
+		}
+
+		size_t Code (ZSTD_inBuffer& input, ZSTD_EndDirective directive)
+		{
+			const size_t ret = Check (ZSTD_compressStream2 (Context_, &Output_, &input, directive));
+			if (Output_.pos == Output_.size)
+				FlushOutput ();
+			return ret;
+		}
+
+		void FlushOutput ()
+		{
+			WriteOut (Buffer_.constData (), Output_.pos);
+			ResetOutput ();
+		}
+
+		void ResetOutput ()
+		{
+			Output_.dst = Buffer_.data ();
+			Output_.size = Buffer_.size ();
+			Output_.pos = 0;
+		}
+	};
+#endif
+}
+
+std::unique_ptr<Compressor> Compressor::Create (const QString& archiver,
+		QIODevice *out, const CompressionParams& params)
+{
+	if (archiver == "xz")
+		return std::unique_ptr<Compressor> (new LzmaCompressor (out, params, false));
+	else if (archiver == "lzma")
+		return std::unique_ptr<Compressor> (new LzmaCompressor (out, params, true));
+	else if (archiver == "bz2")
+		return std::unique_ptr<Compressor> (new Bz2Compressor (out, params));
+	else if (archiver == "gz")
+		return std::unique_ptr<Compressor> (new GzCompressor (out, params));
+#ifdef LCPACKGEN_ZSTD
+	else if (archiver == "zst")
+		return std::unique_ptr<Compressor> (new ZstdCompressor (out, params));
+#endif
+
+	throw std::runtime_error (tr ("Unsupported archiver %1.")
+			.arg (archiver)
+			.toUtf8 ().constData ());
+}
+
+QStringList Compressor::GetSupportedArchivers ()
+{
+	return QStringList ("xz")
+			<< "lzma"
+			<< "bz2"
+			<< "gz";
+}
@@ -0,0 +1,91 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+#include <memory>
+#include <QCoreApplication>
+#include <QString>
+
+class QIODevice;
+
+class ByteSink
+{
+public:
+	virtual ~ByteSink ();
+
+	/** Consumes the given data, throwing std::runtime_error on
+	 * failure.
+	 */
+	virtual void Write (const char *data, qint64 size) = 0;
+};
+
+struct CompressionParams
+{
+	/** Compression level, from 0 to 9, or up to 22 for zstd.
+	 */
+	int Level_;
+
+	/** Number of threads the compressor may use, or 0 to use as
+	 * many as there are cores. Ignored by single-threaded codecs.
+	 */
+	int Threads_;
+
+	/** Upper bound for the memory used by the compressor in bytes,
+	 * or 0 for no bound. Multithreaded codecs reduce the number of
+	 * threads to fit into it.
+	 */
+	quint64 MemoryLimit_;
+
+	CompressionParams ();
+};
+
+/** Streaming compressor writing the compressed data into a device.
+ *
+ * Everything written into it is compressed on the fly with bounded
+ * buffers, so the uncompressed data never has to be stored anywhere.
+ */
+class Compressor : public ByteSink
+{
+	Q_DECLARE_TR_FUNCTIONS (Compressor)
+protected:
+	QIODevice * const Out_;
+public:
+	explicit Compressor (QIODevice *out);
+
+	/** Flushes all the pending data and finishes the compressed
+	 * stream. Nothing may be written after this.
+	 */
+	virtual void Finish () = 0;
+
+	/** Creates a compressor for the given archiver (like "xz"),
+	 * throwing std::runtime_error if it is unsupported.
+	 *
+	 * Besides the archivers of version archives, "zst" is supported
+	 * when built with zstd. It is only used for metadata, so it isn't
+	 * returned by GetSupportedArchivers().
+	 */
+	static std::unique_ptr<Compressor> Create (const QString& archiver,
+			QIODevice *out, const CompressionParams& = CompressionParams ());
+
+	static QStringList GetSupportedArchivers ();
+protected:
+	void WriteOut (const char *data, qint64 size);
+};
+
+#endif
@@ -0,0 +1,328 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "decompressor.h"
+#include <stdexcept>
+#include <cstring>
+#include <QIODevice>
+#include <QStringList>
+#include <lzma.h>
+#include <bzlib.h>
+#include <zlib.h>
+
+namespace
+{
+	const qint64 BufferSize = 256 * 1024;
+}
+
+ByteSource::~ByteSource ()
+{
+}
+
+Decompressor::Decompressor (QIODevice *in)
+: In_ (in)
+, InBuffer_ (BufferSize, 0)
+, InEnd_ (false)
+{
+}
+
+qint64 Decompressor::ReadIn ()
+{
+	InBuffer_.resize (BufferSize);
+	const qint64 read = In_->read (InBuffer_.data (), BufferSize);
+	if (read < 0)
+		throw std::runtime_error (tr ("Could not read compressed data: %1.")
+				.arg (In_->errorString ())
+				.toUtf8 ().constData ());
+
+	InBuffer_.resize (read);
+	if (!read)
+		InEnd_ = true;
+	return read;
+}
+
+void Decompressor::ThrowError (const QString& codec, const QString& error) const
+{
+	throw std::runtime_error (tr ("%1 data is corrupted: %2.")
+			.arg (codec)
+			.arg (error)
+			.toUtf8 ().constData ());
+}
+
+void Decompressor::ThrowTruncated () const
+{
+	throw std::runtime_error (tr ("Compressed data is truncated.")
+			.toUtf8 ().constData ());
+}
+
+namespace
+{
+	class LzmaDecompressor : public Decompressor
+	{
+		lzma_stream Stream_;
+		const QString Codec_;
+		bool Finished_;
+	public:
+		LzmaDecompressor (QIODevice *in, bool alone)
+		: Decompressor (in)
+		, Codec_ (alone ? "lzma" : "xz")
+		, Finished_ (false)
+		{
+			const lzma_stream init = LZMA_STREAM_INIT;
+			Stream_ = init;
+
+			const lzma_ret ret = alone ?
+					lzma_alone_decoder (&Stream_, UINT64_MAX) :
+					lzma_stream_decoder (&Stream_, UINT64_MAX, LZMA_CONCATENATED);
+			if (ret != LZMA_OK)
+				throw std::runtime_error (tr ("Could not initialize the %1 decoder (error %2).")
+						.arg (Codec_)
+						.arg (ret)
+						.toUtf8 ().constData ());
+		}
+
+		~LzmaDecompressor ()
+		{
+			lzma_end (&Stream_);
+		}
+
+		qint64 Read (char *data, qint64 maxSize)
+		{
+			if (Finished_)
+				return 0;
+
+			Stream_.next_out = reinterpret_cast<uint8_t*> (data);
+			Stream_.avail_out = maxSize;
+			while (Stream_.avail_out)
+			{
+				if (!Stream_.avail_in && !InEnd_)
+				{
+					Stream_.avail_in = ReadIn ();
+					Stream_.next_in = reinterpret_cast<const uint8_t*> (InBuffer_.constData ());
+				}
+
+				const lzma_ret ret = lzma_code (&Stream_,
+						InEnd_ && !Stream_.avail_in ? LZMA_FINISH : LZMA_RUN);
+				if (ret == LZMA_STREAM_END)
+				{
+					Finished_ = true;
+					break;
+				}
+
+				switch (ret)
+				{
+				case LZMA_OK:
+					break;
+				case LZMA_BUF_ERROR:
+					ThrowTruncated ();
+				case LZMA_FORMAT_ERROR:
+					ThrowError (Codec_, tr ("unknown format"));
+				case LZMA_DATA_ERROR:
+					ThrowError (Codec_, tr ("invalid compressed data"));
+				default:
+					ThrowError (Codec_, tr ("error %1").arg (ret));
+				}
+			}
+
+			return maxSize - Stream_.avail_out;
+		}
+	};
+
+	class Bz2Decompressor : public Decompressor
+	{
+		bz_stream Stream_;
+		bool Finished_;
+	public:
+		Bz2Decompressor (QIODevice *in)
+		: Decompressor (in)
+		, Finished_ (false)
+		{
+			Init ();
+		}
+
+		~Bz2Decompressor ()
+		{
+			BZ2_bzDecompressEnd (&Stream_);
+		}
+
+		qint64 Read (char *data, qint64 maxSize)
+		{
+			if (Finished_)
+				return 0;
+
+			Stream_.next_out = data;
+			Stream_.avail_out = maxSize;
+			while (Stream_.avail_out)
+			{
+				if (!Stream_.avail_in && !InEnd_)
+				{
+					Stream_.avail_in = ReadIn ();
+					Stream_.next_in = InBuffer_.data ();
+				}
+
+				const unsigned int inBefore = Stream_.avail_in;
+				const unsigned int outBefore = Stream_.avail_out;
+				const int ret = BZ2_bzDecompress (&Stream_);
+				if (ret == BZ_STREAM_END)
+				{
+					// Parallel bzip2 implementations produce several
+					// concatenated streams.
+					if (!Stream_.avail_in && (InEnd_ || !ReadMore ()))
+					{
+						Finished_ = true;
+						break;
+					}
+
+					const bz_stream state = Stream_;
+					BZ2_bzDecompressEnd (&Stream_);
+					Init ();
+					Stream_.next_in = state.next_in;
+					Stream_.avail_in = state.avail_in;
+					Stream_.next_out = state.next_out;
+					Stream_.avail_out = state.avail_out;
+					continue;
+				}
+
+				if (ret != BZ_OK)
+					ThrowError ("bzip2", tr ("error %1").arg (ret));
+
+				if (InEnd_ &&
+						Stream_.avail_in == inBefore &&
+						Stream_.avail_out == outBefore)
+					ThrowTruncated ();
+			}
+
+			return maxSize - Stream_.avail_out;
+		}
+	private:
+		void Init ()
+		{
+			std::memset (&Stream_, 0, sizeof (Stream_));
+			const int ret = BZ2_bzDecompressInit (&Stream_, 0, 0);
+			if (ret != BZ_OK)
+				throw std::runtime_error (tr ("Could not initialize the bzip2 decoder (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+		}
+
+		bool ReadMore ()
+		{
+			Stream_.avail_in = ReadIn ();
+			Stream_.next_in = InBuffer_.data ();
+			return Stream_.avail_in;
+		}
+	};
+
+	class GzDecompressor : public Decompressor
+	{
+		z_stream Stream_;
+		bool Finished_;
+	public:
+		GzDecompressor (QIODevice *in)
+		: Decompressor (in)
+		, Finished_ (false)
+		{
+			std::memset (&Stream_, 0, sizeof (Stream_));
+			const int ret = inflateInit2 (&Stream_, 16 + MAX_WBITS);
+			if (ret != Z_OK)
+				throw std::runtime_error (tr ("Could not initialize the gzip decoder (error %1).")
+						.arg (ret)
+						.toUtf8 ().constData ());
+		}
+
+		~GzDecompressor ()
+		{
+			inflateEnd (&Stream_);
+		}
+
+		qint64 Read (char *data, qint64 maxSize)
+		{
+			if (Finished_)
+				return 0;
+
+			Stream_.next_out = reinterpret_cast<Bytef*> (data);
+			Stream_.avail_out = maxSize;
+			while (Stream_.avail_out)
+			{
+				if (!Stream_.avail_in && !InEnd_)
+					ReadMore ();
+
+				const uInt inBefore = Stream_.avail_in;
+				const uInt outBefore = Stream_.avail_out;
+				const int ret = inflate (&Stream_, Z_NO_FLUSH);
+				if (ret == Z_STREAM_END)
+				{
+					// A gzip file may consist of several members.
+					if (!Stream_.avail_in && (InEnd_ || !ReadMore ()))
+					{
+						Finished_ = true;
+						break;
+					}
+
+					inflateReset (&Stream_);
+					continue;
+				}
+
+				if (ret == Z_BUF_ERROR && InEnd_)
+					ThrowTruncated ();
+				if (ret != Z_OK && ret != Z_BUF_ERROR)
+					ThrowError ("gzip", Stream_.msg ?
+							QString::fromLatin1 (Stream_.msg) :
+							tr ("error %1").arg (ret));
+
+				if (InEnd_ &&
+						Stream_.avail_in == inBefore &&
+						Stream_.avail_out == outBefore)
+					ThrowTruncated ();
+			}
+
+			return maxSize - Stream_.avail_out;
+		}
+	private:
+		bool ReadMore ()
+		{
+			Stream_.avail_in = ReadIn ();
+			Stream_.next_in = reinterpret_cast<Bytef*> (InBuffer_.data ());
+			return Stream_.avail_in;
+		}
+	};
+}
+
+std::unique_ptr<Decompressor> Decompressor::Create (const QString& archiver, QIODevice *in)
+{
+	if (archiver == "xz")
+		return std::unique_ptr<Decompressor> (new LzmaDecompressor (in, false));
+	else if (archiver == "lzma")
+		return std::unique_ptr<Decompressor> (new LzmaDecompressor (in, true));
+	else if (archiver == "bz2")
+		return std::unique_ptr<Decompressor> (new Bz2Decompressor (in));
+	else if (archiver == "gz")
+		return std::unique_ptr<Decompressor> (new GzDecompressor (in));
+
+	throw std::runtime_error (tr ("Unsupported archiver %1.")
+			.arg (archiver)
+			.toUtf8 ().constData ());
+}
+
+QStringList Decompressor::GetSupportedArchivers ()
+{
+	return QStringList ("xz")
+			<< "lzma"
+			<< "bz2"
+			<< "gz";
+}
@@ -0,0 +1,74 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+#include <memory>
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+class ByteSource
+{
+public:
+	virtual ~ByteSource ();
+
+	/** Reads up to maxSize bytes, returning the number of bytes read
+	 * or 0 at the end of the data, and throwing std::runtime_error on
+	 * failure.
+	 */
+	virtual qint64 Read (char *data, qint64 maxSize) = 0;
+};
+
+/** Streaming decompressor reading the compressed data from a device.
+ *
+ * The data is decompressed on the fly with bounded buffers, so the
+ * decompressed data never has to be stored anywhere. Corrupted and
+ * truncated streams are reported by throwing std::runtime_error from
+ * Read(), the integrity checks of the formats included.
+ */
+class Decompressor : public ByteSource
+{
+	Q_DECLARE_TR_FUNCTIONS (Decompressor)
+
+	QIODevice * const In_;
+protected:
+	QByteArray InBuffer_;
+	bool InEnd_;
+public:
+	explicit Decompressor (QIODevice *in);
+
+	/** Creates a decompressor for the given archiver (like "xz"),
+	 * throwing std::runtime_error if it is unsupported.
+	 */
+	static std::unique_ptr<Decompressor> Create (const QString& archiver, QIODevice *in);
+
+	static QStringList GetSupportedArchivers ();
+protected:
+	/** Reads the next chunk of the compressed data into InBuffer_,
+	 * returning its size, or 0 and setting InEnd_ at the end.
+	 */
+	qint64 ReadIn ();
+
+	[[noreturn]] void ThrowError (const QString& codec, const QString& error) const;
+	[[noreturn]] void ThrowTruncated () const;
+};
+
+#endif
@@ -0,0 +1,238 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "dependenciesmodel.h"
+#include <algorithm>
+
+DependenciesModel::DependenciesModel (QObject *parent)
+: QAbstractTableModel (parent)
+{
+}
+
+int DependenciesModel::rowCount (const QModelIndex& parent) const
+{
+	return parent.isValid () ? 0 : Rows_.size ();
+}
+
+int DependenciesModel::columnCount (const QModelIndex& parent) const
+{
+	return parent.isValid () ? 0 : CCount;
+}
+
+QVariant DependenciesModel::data (const QModelIndex& index, int role) const
+{
+	if (!index.isValid () ||
+			index.row () >= Rows_.size () ||
+			(role != Qt::DisplayRole && role != Qt::EditRole))
+		return QVariant ();
+
+	return Field (Rows_.at (index.row ()), index.column ());
+}
+
+QVariant DependenciesModel::headerData (int section, Qt::Orientation orient, int role) const
+{
+	if (orient != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant ();
+
+	switch (section)
+	{
+	case CThisVersion:
+		return tr ("This version");
+	case CType:
+		return tr ("Type");
+	case CName:
+		return tr ("Name");
+	case CVersion:
+		return tr ("Version");
+	default:
+		return QVariant ();
+	}
+}
+
+Qt::ItemFlags DependenciesModel::flags (const QModelIndex& index) const
+{
+	if (!index.isValid ())
+		return Qt::NoItemFlags;
+
+	return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+bool DependenciesModel::setData (const QModelIndex& index, const QVariant& value, int role)
+{
+	if (!index.isValid () ||
+			index.row () >= Rows_.size () ||
+			role != Qt::EditRole)
+		return false;
+
+	const int row = index.row ();
+	QString& field = Field (Rows_ [row], index.column ());
+	const QString& newValue = value.toString ();
+	if (field == newValue)
+		return true;
+
+	if (index.column () == CThisVersion)
+	{
+		QVector<int>& oldRows = ByVersion_ [field];
+		oldRows.remove (oldRows.indexOf (row));
+		if (oldRows.isEmpty ())
+			ByVersion_.remove (field);
+
+		QVector<int>& newRows = ByVersion_ [newValue];
+		newRows.insert (std::lower_bound (newRows.begin (), newRows.end (), row), row);
+	}
+
+	field = Intern (newValue);
+
+	emit dataChanged (index, index);
+	return true;
+}
+
+void DependenciesModel::Clear ()
+{
+	SetDependencies (QList<Dependency> ());
+}
+
+void DependenciesModel::SetDependencies (const QList<Dependency>& deps)
+{
+	beginResetModel ();
+	Rows_.clear ();
+	Strings_.clear ();
+	Rows_.reserve (deps.size ());
+	Q_FOREACH (const Dependency& dep, deps)
+		Rows_ << Intern (dep);
+	RebuildIndex ();
+	endResetModel ();
+}
+
+QList<Dependency> DependenciesModel::GetDependencies () const
+{
+	return Rows_.toList ();
+}
+
+void DependenciesModel::AddDependency (const Dependency& dep)
+{
+	const int row = Rows_.size ();
+
+	beginInsertRows (QModelIndex (), row, row);
+	Rows_ << Intern (dep);
+	ByVersion_ [dep.ThisVersion_] << row;
+	endInsertRows ();
+}
+
+void DependenciesModel::RemoveDependency (int row)
+{
+	if (row < 0 || row >= Rows_.size ())
+		return;
+
+	beginRemoveRows (QModelIndex (), row, row);
+	const QString& version = Rows_.at (row).ThisVersion_;
+	QVector<int>& rows = ByVersion_ [version];
+	rows.remove (rows.indexOf (row));
+	if (rows.isEmpty ())
+		ByVersion_.remove (version);
+	Rows_.remove (row);
+
+	// The index lists are sorted, so only their tails refer to the
+	// rows that have just shifted up, and nothing needs to be rehashed.
+	for (QHash<QString, QVector<int>>::iterator i = ByVersion_.begin (),
+			end = ByVersion_.end (); i != end; ++i)
+		for (QVector<int>::iterator pos = std::upper_bound (i->begin (), i->end (), row);
+				pos != i->end (); ++pos)
+			--*pos;
+	endRemoveRows ();
+}
+
+int DependenciesModel::CountReferences (const QString& version) const
+{
+	const QHash<QString, QVector<int>>::const_iterator pos = ByVersion_.find (version);
+	return pos == ByVersion_.end () ? 0 : pos->size ();
+}
+
+void DependenciesModel::RenameVersion (const QString& oldVersion, const QString& newVersion)
+{
+	const QVector<int>& rows = ByVersion_.take (oldVersion);
+	if (rows.isEmpty ())
+		return;
+
+	const QString& interned = Intern (newVersion);
+	Q_FOREACH (int row, rows)
+	{
+		Rows_ [row].ThisVersion_ = interned;
+		const QModelIndex& idx = index (row, CThisVersion);
+		emit dataChanged (idx, idx);
+	}
+
+	QVector<int>& newRows = ByVersion_ [newVersion];
+	newRows += rows;
+	std::sort (newRows.begin (), newRows.end ());
+}
+
+QString DependenciesModel::Intern (const QString& str)
+{
+	QSet<QString>::const_iterator pos = Strings_.constFind (str);
+	if (pos == Strings_.constEnd ())
+		pos = Strings_.insert (str);
+	return *pos;
+}
+
+Dependency DependenciesModel::Intern (const Dependency& dep)
+{
+	Dependency result;
+	result.ThisVersion_ = Intern (dep.ThisVersion_);
+	result.Type_ = Intern (dep.Type_);
+	result.Name_ = Intern (dep.Name_);
+	result.Version_ = Intern (dep.Version_);
+	return result;
+}
+
+QString& DependenciesModel::Field (Dependency& dep, int column)
+{
+	switch (column)
+	{
+	case CThisVersion:
+		return dep.ThisVersion_;
+	case CType:
+		return dep.Type_;
+	case CName:
+		return dep.Name_;
+	default:
+		return dep.Version_;
+	}
+}
+
+const QString& DependenciesModel::Field (const Dependency& dep, int column)
+{
+	switch (column)
+	{
+	case CThisVersion:
+		return dep.ThisVersion_;
+	case CType:
+		return dep.Type_;
+	case CName:
+		return dep.Name_;
+	default:
+		return dep.Version_;
+	}
+}
+
+void DependenciesModel::RebuildIndex ()
+{
+	ByVersion_.clear ();
+	for (int i = 0; i < Rows_.size (); ++i)
+		ByVersion_ [Rows_.at (i).ThisVersion_] << i;
+}
@@ -0,0 +1,86 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef DEPENDENCIESMODEL_H
+#define DEPENDENCIESMODEL_H
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include "packagedata.h"
+
+/** The table of package dependencies.
+ *
+ * Rows are stored contiguously, and their strings are interned, so
+ * that the many rows sharing the same version, type or interface
+ * name also share the string data. An index from this package's
+ * versions to the rows referring to them is kept up to date, so that
+ * renaming a version or checking whether it is referenced only
+ * touches the relevant rows.
+ */
+class DependenciesModel : public QAbstractTableModel
+{
+	Q_OBJECT
+
+	QVector<Dependency> Rows_;
+	QSet<QString> Strings_;
+	QHash<QString, QVector<int>> ByVersion_;
+public:
+	enum Column
+	{
+		CThisVersion,
+		CType,
+		CName,
+		CVersion,
+		CCount
+	};
+
+	DependenciesModel (QObject* = 0);
+
+	int rowCount (const QModelIndex& = QModelIndex ()) const;
+	int columnCount (const QModelIndex& = QModelIndex ()) const;
+	QVariant data (const QModelIndex&, int = Qt::DisplayRole) const;
+	QVariant headerData (int, Qt::Orientation, int = Qt::DisplayRole) const;
+	Qt::ItemFlags flags (const QModelIndex&) const;
+	bool setData (const QModelIndex&, const QVariant&, int = Qt::EditRole);
+
+	void Clear ();
+	void SetDependencies (const QList<Dependency>&);
+	QList<Dependency> GetDependencies () const;
+
+	void AddDependency (const Dependency&);
+	void RemoveDependency (int row);
+
+	/** Returns the number of dependencies whose ThisVersion_ is the
+	 * given version.
+	 */
+	int CountReferences (const QString& version) const;
+public slots:
+	/** Makes all the dependencies referring to oldVersion refer to
+	 * newVersion instead.
+	 */
+	void RenameVersion (const QString& oldVersion, const QString& newVersion);
+private:
+	QString Intern (const QString&);
+	Dependency Intern (const Dependency&);
+	static QString& Field (Dependency&, int column);
+	static const QString& Field (const Dependency&, int column);
+	void RebuildIndex ();
+};
+
+#endif
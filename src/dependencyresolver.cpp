@@ -0,0 +1,421 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "dependencyresolver.h"
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <QHash>
+#include <QPair>
+#include <QtConcurrentMap>
+#include "packagesnapshot.h"
+#include "repositoryindexer.h"
+#include "versionkey.h"
+
+namespace
+{
+	struct LoadResult
+	{
+		DependencyResolver::Package Package_;
+		QString Error_;
+	};
+
+	// Provisions are keyed on the name and the version joined by a
+	// character that can't appear in either of them.
+	QString MakeKey (const QString& name, const QString& version)
+	{
+		return name + QChar (0) + version;
+	}
+
+	struct Provisions
+	{
+		QHash<QString, QVector<int>> ByKey_;
+		QHash<QString, QStringList> Versions_;
+
+		void Add (const QString& name, const QString& version, int node)
+		{
+			QVector<int>& nodes = ByKey_ [MakeKey (name, version)];
+			if (nodes.isEmpty ())
+				Versions_ [name] << version;
+			if (!nodes.contains (node))
+				nodes << node;
+		}
+	};
+
+	struct NodeResult
+	{
+		QVector<int> Edges_;
+		QList<DependencyResolver::Issue> Issues_;
+	};
+}
+
+DependencyResolver::DependencyResolver (const QList<Package>& packages)
+: Packages_ (packages)
+, EdgeCount_ (0)
+{
+	QVector<QList<const Dependency*>> requirements;
+	Provisions provisions;
+
+	for (int i = 0; i < Packages_.size (); ++i)
+	{
+		const PackageData& data = Packages_.at (i).Data_;
+
+		QHash<QString, int> versionNodes;
+		auto getNode = [this, i, &versionNodes, &requirements] (const QString& version) -> int
+			{
+				QHash<QString, int>::const_iterator pos = versionNodes.constFind (version);
+				if (pos != versionNodes.constEnd ())
+					return *pos;
+
+				const Node node = { i, version };
+				Nodes_ << node;
+				requirements.resize (Nodes_.size ());
+				return *versionNodes.insert (version, Nodes_.size () - 1);
+			};
+
+		Q_FOREACH (const QString& version, data.Versions_)
+			provisions.Add ("plugin://" + data.Name_, version, getNode (version));
+
+		// The requirements are referenced by pointers into Packages_,
+		// which isn't modified after this point.
+		for (int j = 0; j < data.Depends_.size (); ++j)
+		{
+			const Dependency& dep = data.Depends_.at (j);
+			const int node = getNode (dep.ThisVersion_);
+			if (dep.Type_ == "provide")
+				provisions.Add (dep.Name_, dep.Version_, node);
+			else if (dep.Type_ == "require")
+				requirements [node] << &dep;
+		}
+	}
+
+	const Provisions& provs = provisions;
+	std::function<NodeResult (int)> check =
+		[this, &provs, &requirements] (int node)
+		{
+			const Package& package = Packages_.at (Nodes_.at (node).Package_);
+
+			NodeResult result;
+			auto addIssue = [&result, &package, this, node] (IssueType type, const QString& message)
+				{
+					const Issue issue =
+					{
+						type,
+						package.FileName_,
+						package.Data_.Name_,
+						Nodes_.at (node).Version_,
+						message
+					};
+					result.Issues_ << issue;
+				};
+
+			QHash<QString, QString> requiredVersions;
+			Q_FOREACH (const Dependency *dep, requirements.at (node))
+			{
+				const QString& prevVersion = requiredVersions.value (dep->Name_, dep->Version_);
+				if (prevVersion != dep->Version_)
+					addIssue (IConflict,
+							tr ("%1 is required both in version %2 and %3.")
+								.arg (dep->Name_)
+								.arg (prevVersion)
+								.arg (dep->Version_));
+				requiredVersions [dep->Name_] = dep->Version_;
+
+				const QHash<QString, QVector<int>>::const_iterator pos =
+						provs.ByKey_.constFind (MakeKey (dep->Name_, dep->Version_));
+				if (pos != provs.ByKey_.constEnd ())
+				{
+					Q_FOREACH (int provider, *pos)
+						if (provider != node)
+							result.Edges_ << provider;
+					continue;
+				}
+
+				QStringList versions = provs.Versions_.value (dep->Name_);
+				VersionKey::Sort (versions);
+				if (versions.isEmpty ())
+					addIssue (IUnsatisfied,
+							tr ("%1 %2 is required, but no package provides it.")
+								.arg (dep->Name_)
+								.arg (dep->Version_));
+				else
+					addIssue (IConflict,
+							tr ("%1 %2 is required, but only versions %3 are provided.")
+								.arg (dep->Name_)
+								.arg (dep->Version_)
+								.arg (versions.join (", ")));
+			}
+
+			std::sort (result.Edges_.begin (), result.Edges_.end ());
+			result.Edges_.erase (std::unique (result.Edges_.begin (), result.Edges_.end ()),
+					result.Edges_.end ());
+			return result;
+		};
+
+	QVector<int> nodes (Nodes_.size ());
+	for (int i = 0; i < nodes.size (); ++i)
+		nodes [i] = i;
+	const QList<NodeResult>& results =
+			QtConcurrent::blockingMapped<QList<NodeResult>> (nodes, check);
+
+	Edges_.reserve (results.size ());
+	Q_FOREACH (const NodeResult& result, results)
+	{
+		Edges_.append (result.Edges_);
+		EdgeCount_ += result.Edges_.size ();
+		Issues_ += result.Issues_;
+	}
+
+	Q_FOREACH (const QVector<int>& component, FindComponents (Edges_))
+	{
+		if (component.size () < 2)
+			continue;
+
+		QStringList chain;
+		Q_FOREACH (int node, component)
+			chain << QString ("%1 %2")
+					.arg (Packages_.at (Nodes_.at (node).Package_).Data_.Name_)
+					.arg (Nodes_.at (node).Version_);
+
+		const QString& message = tr ("Dependency cycle between %1.")
+				.arg (chain.join (", "));
+		Q_FOREACH (int node, component)
+		{
+			const Package& package = Packages_.at (Nodes_.at (node).Package_);
+			const Issue issue =
+			{
+				ICycle,
+				package.FileName_,
+				package.Data_.Name_,
+				Nodes_.at (node).Version_,
+				message
+			};
+			Issues_ << issue;
+		}
+	}
+}
+
+QList<DependencyResolver::Package> DependencyResolver::LoadRepository (const QString& root,
+		QStringList& errors)
+{
+	std::function<LoadResult (const QString&)> load = [] (const QString& path)
+		{
+			LoadResult result;
+			result.Package_.FileName_ = path;
+			try
+			{
+				QStringList warnings;
+				result.Package_.Data_ = PackageSnapshot::Load (path, warnings);
+			}
+			catch (const std::exception& e)
+			{
+				result.Error_ = QString ("%1: %2")
+						.arg (path)
+						.arg (QString::fromUtf8 (e.what ()));
+			}
+			return result;
+		};
+	const QList<LoadResult>& results = QtConcurrent::blockingMapped<QList<LoadResult>> (
+			RepositoryIndexer::FindDescriptors (root), load);
+
+	QList<Package> packages;
+	Q_FOREACH (const LoadResult& result, results)
+		if (result.Error_.isEmpty ())
+			packages << result.Package_;
+		else
+			errors << result.Error_;
+	return packages;
+}
+
+const QList<DependencyResolver::Package>& DependencyResolver::GetPackages () const
+{
+	return Packages_;
+}
+
+const QVector<DependencyResolver::Node>& DependencyResolver::GetNodes () const
+{
+	return Nodes_;
+}
+
+const QVector<QVector<int>>& DependencyResolver::GetEdges () const
+{
+	return Edges_;
+}
+
+int DependencyResolver::GetEdgeCount () const
+{
+	return EdgeCount_;
+}
+
+const QList<DependencyResolver::Issue>& DependencyResolver::GetIssues () const
+{
+	return Issues_;
+}
+
+QVector<QVector<int>> DependencyResolver::ComputeClosures () const
+{
+	const QList<QVector<int>>& components = FindComponents (Edges_);
+
+	QVector<int> componentOf (Nodes_.size ());
+	for (int c = 0; c < components.size (); ++c)
+		Q_FOREACH (int node, components.at (c))
+			componentOf [node] = c;
+
+	// Components come in reverse topological order, so the heights of
+	// the successors of a component are always known by the time it
+	// is reached.
+	QVector<QVector<int>> successors (components.size ());
+	QVector<int> heights (components.size (), 0);
+	QVector<QVector<int>> byHeight;
+	for (int c = 0; c < components.size (); ++c)
+	{
+		QVector<int>& succs = successors [c];
+		Q_FOREACH (int node, components.at (c))
+			Q_FOREACH (int next, Edges_.at (node))
+				if (componentOf.at (next) != c)
+					succs << componentOf.at (next);
+		std::sort (succs.begin (), succs.end ());
+		succs.erase (std::unique (succs.begin (), succs.end ()), succs.end ());
+
+		int& height = heights [c];
+		Q_FOREACH (int succ, succs)
+			height = std::max (height, heights.at (succ) + 1);
+
+		if (height >= byHeight.size ())
+			byHeight.resize (height + 1);
+		byHeight [height] << c;
+	}
+
+	QVector<QVector<int>> componentClosures (components.size ());
+	QVector<int> *closures = componentClosures.data ();
+	std::function<void (int&)> compute = [closures, &components, &successors] (int& c)
+		{
+			QVector<int> closure;
+			if (components.at (c).size () > 1)
+				closure = components.at (c);
+			Q_FOREACH (int succ, successors.at (c))
+			{
+				closure += components.at (succ);
+				closure += closures [succ];
+			}
+			std::sort (closure.begin (), closure.end ());
+			closure.erase (std::unique (closure.begin (), closure.end ()), closure.end ());
+			closures [c] = closure;
+		};
+	for (int h = 0; h < byHeight.size (); ++h)
+		QtConcurrent::blockingMap (byHeight [h], compute);
+
+	QVector<QVector<int>> result (Nodes_.size ());
+	for (int node = 0; node < Nodes_.size (); ++node)
+	{
+		QVector<int>& closure = result [node];
+		closure = componentClosures.at (componentOf.at (node));
+		const QVector<int>::iterator pos = std::lower_bound (closure.begin (), closure.end (), node);
+		if (pos != closure.end () && *pos == node)
+			closure.erase (pos);
+	}
+	return result;
+}
+
+QList<QVector<int>> DependencyResolver::FindComponents (const QVector<QVector<int>>& edges)
+{
+	// Tarjan's algorithm with an explicit stack of (node, next edge)
+	// frames, so that long dependency chains don't overflow the
+	// call stack.
+	const int count = edges.size ();
+	QVector<int> indices (count, -1);
+	QVector<int> lowlinks (count, 0);
+	QVector<bool> onStack (count, false);
+	QVector<int> stack;
+	QVector<QPair<int, int>> frames;
+	int nextIndex = 0;
+
+	QList<QVector<int>> result;
+
+	auto visit = [&] (int node)
+		{
+			indices [node] = lowlinks [node] = nextIndex++;
+			stack << node;
+			onStack [node] = true;
+			frames << qMakePair (node, 0);
+		};
+
+	for (int root = 0; root < count; ++root)
+	{
+		if (indices [root] != -1)
+			continue;
+
+		visit (root);
+		while (!frames.isEmpty ())
+		{
+			const int node = frames.last ().first;
+			const int edge = frames.last ().second;
+			if (edge < edges.at (node).size ())
+			{
+				++frames.last ().second;
+
+				const int next = edges.at (node).at (edge);
+				if (indices [next] == -1)
+					visit (next);
+				else if (onStack [next])
+					lowlinks [node] = std::min (lowlinks [node], indices [next]);
+				continue;
+			}
+
+			frames.removeLast ();
+			if (!frames.isEmpty ())
+			{
+				const int parent = frames.last ().first;
+				lowlinks [parent] = std::min (lowlinks [parent], lowlinks [node]);
+			}
+
+			if (lowlinks [node] != indices [node])
+				continue;
+
+			QVector<int> component;
+			int member;
+			do
+			{
+				member = stack.takeLast ();
+				onStack [member] = false;
+				component << member;
+			}
+			while (member != node);
+
+			std::reverse (component.begin (), component.end ());
+			result << component;
+		}
+	}
+
+	return result;
+}
+
+QString DependencyResolver::IssueTypeToString (IssueType type)
+{
+	switch (type)
+	{
+	case IUnsatisfied:
+		return "unsatisfied";
+	case IConflict:
+		return "conflict";
+	case ICycle:
+		return "cycle";
+	}
+
+	return QString ();
+}
@@ -0,0 +1,129 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef DEPENDENCYRESOLVER_H
+#define DEPENDENCYRESOLVER_H
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include "packagedata.h"
+
+/** Checks the dependencies of all the packages of a repository
+ * against each other.
+ *
+ * Every version of every package is a node of the dependency graph.
+ * A node provides whatever its "provide" dependencies list, and also
+ * plugin://NAME of its own version. Each "require" dependency is
+ * looked up in a hash of all the provisions by name and version and
+ * becomes an edge to every node providing it, or an issue if there is
+ * none. The requirements are checked in parallel, and the cycles are
+ * then found as strongly connected components of the graph.
+ */
+class DependencyResolver
+{
+	Q_DECLARE_TR_FUNCTIONS (DependencyResolver)
+public:
+	struct Package
+	{
+		QString FileName_;
+		PackageData Data_;
+	};
+
+	enum IssueType
+	{
+		/** Nothing provides the required name at all.
+		 */
+		IUnsatisfied,
+
+		/** The required name is provided, but not in the required
+		 * version, or the same name is required in several versions.
+		 */
+		IConflict,
+
+		/** The node is part of a dependency cycle.
+		 */
+		ICycle
+	};
+
+	struct Issue
+	{
+		IssueType Type_;
+		QString FileName_;
+		QString Package_;
+		QString ThisVersion_;
+		QString Message_;
+	};
+
+	struct Node
+	{
+		int Package_;
+		QString Version_;
+	};
+private:
+	QList<Package> Packages_;
+	QVector<Node> Nodes_;
+	QVector<QVector<int>> Edges_;
+	QList<Issue> Issues_;
+	int EdgeCount_;
+public:
+	/** Builds the dependency graph of the given packages and checks
+	 * it.
+	 */
+	explicit DependencyResolver (const QList<Package>&);
+
+	/** Loads all the package descriptions of the repository rooted
+	 * at the given directory in parallel. The descriptions that fail
+	 * to load are skipped and reported in errors.
+	 */
+	static QList<Package> LoadRepository (const QString& root, QStringList& errors);
+
+	const QList<Package>& GetPackages () const;
+	const QVector<Node>& GetNodes () const;
+
+	/** Returns the outgoing edges of each node, sorted and without
+	 * repetitions.
+	 */
+	const QVector<QVector<int>>& GetEdges () const;
+	int GetEdgeCount () const;
+
+	const QList<Issue>& GetIssues () const;
+
+	/** Computes the transitive closure of the requirements of every
+	 * node: the sorted list of all the other nodes it requires
+	 * directly or indirectly.
+	 *
+	 * The closures are computed on the condensation of the graph,
+	 * one closure per strongly connected component. The components
+	 * are grouped by their height in the condensation, and all the
+	 * components of the same height are processed in parallel.
+	 */
+	QVector<QVector<int>> ComputeClosures () const;
+
+	/** Returns the strongly connected components of the graph given
+	 * by its adjacency lists, each component listing its nodes in the
+	 * order they were discovered. The components are returned in
+	 * reverse topological order: no component has edges to the
+	 * components following it.
+	 */
+	static QList<QVector<int>> FindComponents (const QVector<QVector<int>>& edges);
+
+	static QString IssueTypeToString (IssueType);
+};
+
+#endif
@@ -16,13 +16,52 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  **********************************************************************/
 
+#include <cstring>
 #include <QApplication>
 #include <QFileInfo>
 #include <QDir>
 #include "mainwindow.h"
+#include "batchprocessor.h"
+#include "tracing.h"
+
+namespace
+{
+	bool IsBatchMode (int argc, char **argv)
+	{
+		const char *headlessSwitches [] =
+		{
+			"--batch",
+			"--repository",
+			"--resolve",
+			"--recompress",
+			"--watch"
+		};
+
+		for (int i = 1; i < argc; ++i)
+			for (const char *sw : headlessSwitches)
+			{
+				const size_t len = std::strlen (sw);
+				if (!std::strncmp (argv [i], sw, len) &&
+						(argv [i] [len] == '\0' || argv [i] [len] == '='))
+					return true;
+			}
+		return false;
+	}
+}
 
 int main (int argc, char **argv)
 {
+	Tracing::InitFromEnvironment ();
+
+	if (IsBatchMode (argc, argv))
+	{
+		QCoreApplication app (argc, argv);
+		app.setApplicationName ("lcpackgen");
+		const int result = BatchProcessor ().Run (app.arguments ());
+		Tracing::Finish ();
+		return result;
+	}
+
 	QApplication app (argc, argv);
 
 	MainWindow mw;
@@ -41,5 +80,7 @@ int main (int argc, char **argv)
 		}
 	}
 
-	return app.exec ();
+	const int result = app.exec ();
+	Tracing::Finish ();
+	return result;
 }
@@ -18,302 +18,240 @@
 
 #include "mainwindow.h"
 #include <stdexcept>
-#include <QStandardItemModel>
+#include <algorithm>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QMessageBox>
-#include <QXmlQuery>
-#include <QXmlResultItems>
 #include <QDir>
-#include <QLocale>
 #include <QInputDialog>
-#include <QDomDocument>
+#include <QSignalMapper>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QFutureWatcher>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QtConcurrentRun>
 #include <QtDebug>
+#include "packagesnapshot.h"
+#include "packagevalidator.h"
+#include "packagewriter.h"
+#include "archivebuilder.h"
+#include "versionsmodel.h"
+#include "dependenciesmodel.h"
+#include "tracing.h"
 
 MainWindow::MainWindow ()
 : ValidLabel_ (new QLabel (this))
-, VersModel_ (new QStandardItemModel (this))
-, DepsModel_ (new QStandardItemModel (this))
+, VersModel_ (new VersionsModel (this))
+, DepsModel_ (new DependenciesModel (this))
 , Settings_ ("Deviant", "LCPackGen")
 , EnableCheckValid_ (false)
+, StaleFields_ (PackageValidator::FAll)
+, ArchWatcher_ (new QFileSystemWatcher (this))
+, ArchRescanTimer_ (new QTimer (this))
+, ArchiveBuildWatcher_ (new QFutureWatcher<QString> (this))
+, ArchiveVerifyWatcher_ (new QFutureWatcher<ArchiveIndex> (this))
+, SaveWatcher_ (new QFutureWatcher<SaveArchives> (this))
+, OpenWatcher_ (new QFutureWatcher<OpenResult> (this))
+, OpenProgress_ (new QProgressBar (this))
+, OpenCancel_ (new QToolButton (this))
+, OpenGeneration_ (0)
 {
 	Ui_.setupUi (this);
 	UpdateWindowTitle ();
 	Ui_.VersTree_->setModel (VersModel_);
 	Ui_.DepsTree_->setModel (DepsModel_);
 
+	connect (VersModel_,
+			SIGNAL (versionRenamed (const QString&, const QString&)),
+			DepsModel_,
+			SLOT (RenameVersion (const QString&, const QString&)));
+
 	Ui_.ActionNew_->setIcon (QIcon::fromTheme ("document-new"));
 	Ui_.ActionLoad_->setIcon (QIcon::fromTheme ("document-open"));
 	Ui_.ActionSave_->setIcon (QIcon::fromTheme ("document-save"));
 	Ui_.ActionSaveAs_->setIcon (QIcon::fromTheme ("document-save-as"));
 
-	statusBar ()->addPermanentWidget (ValidLabel_);
+	Ui_.ActionChecksums_->setChecked (Settings_.value ("RecordChecksums", false).toBool ());
+	Ui_.ActionManifests_->setChecked (Settings_.value ("GenerateManifests", false).toBool ());
 
-	on_Type__currentIndexChanged (Ui_.Type_->currentText ());
+	statusBar ()->addPermanentWidget (ValidLabel_);
 
-	connect (Ui_.Name_,
-			SIGNAL (textChanged (const QString&)),
+	OpenProgress_->setMaximumWidth (200);
+	OpenProgress_->hide ();
+	OpenCancel_->setIcon (QIcon::fromTheme ("process-stop"));
+	OpenCancel_->setToolTip (tr ("Cancel opening"));
+	OpenCancel_->hide ();
+	statusBar ()->addPermanentWidget (OpenProgress_);
+	statusBar ()->addPermanentWidget (OpenCancel_);
+	connect (OpenCancel_,
+			SIGNAL (released ()),
 			this,
-			SLOT (checkValid ()));
-	connect (Ui_.Description_,
-			SIGNAL (textChanged (const QString&)),
+			SLOT (cancelOpen ()));
+	connect (OpenWatcher_,
+			SIGNAL (finished ()),
 			this,
-			SLOT (checkValid ()));
-	connect (Ui_.Tags_,
-			SIGNAL (textChanged (const QString&)),
-			this,
-			SLOT (checkValid ()));
-	connect (Ui_.LongDescription_,
-			SIGNAL (textChanged ()),
-			this,
-			SLOT (checkValid ()));
-	connect (Ui_.MaintName_,
-			SIGNAL (textChanged (const QString&)),
+			SLOT (handleOpenFinished ()));
+
+	on_Type__currentIndexChanged (Ui_.Type_->currentText ());
+
+	QSignalMapper *mapper = new QSignalMapper (this);
+	connect (mapper,
+			SIGNAL (mapped (int)),
 			this,
-			SLOT (checkValid ()));
-	connect (Ui_.MaintEmail_,
-			SIGNAL (textChanged (const QString&)),
+			SLOT (handleFieldChanged (int)));
+
+	struct
+	{
+		QObject *Object_;
+		const char *Signal_;
+		PackageValidator::Field Field_;
+	} fields [] =
+	{
+		{ Ui_.Name_, SIGNAL (textChanged (const QString&)), PackageValidator::FName },
+		{ Ui_.Description_, SIGNAL (textChanged (const QString&)), PackageValidator::FDescription },
+		{ Ui_.Tags_, SIGNAL (textChanged (const QString&)), PackageValidator::FTags },
+		{ Ui_.LongDescription_, SIGNAL (textChanged ()), PackageValidator::FLongDescription },
+		{ Ui_.MaintName_, SIGNAL (textChanged (const QString&)), PackageValidator::FMaintName },
+		{ Ui_.MaintEmail_, SIGNAL (textChanged (const QString&)), PackageValidator::FMaintEmail },
+		{ Ui_.Thumbnails_, SIGNAL (textChanged ()), PackageValidator::FImages },
+		{ Ui_.Screenshots_, SIGNAL (textChanged ()), PackageValidator::FImages },
+		{ Ui_.Icon_, SIGNAL (textChanged (const QString&)), PackageValidator::FImages },
+		{ Ui_.Type_, SIGNAL (currentIndexChanged (int)), PackageValidator::FType },
+		{ Ui_.Language_, SIGNAL (editTextChanged (const QString&)), PackageValidator::FLanguage },
+		{ Ui_.Language_, SIGNAL (currentIndexChanged (int)), PackageValidator::FLanguage },
+		{ VersModel_, SIGNAL (dataChanged (const QModelIndex&, const QModelIndex&)), PackageValidator::FVersions },
+		{ VersModel_, SIGNAL (rowsInserted (const QModelIndex&, int, int)), PackageValidator::FVersions },
+		{ VersModel_, SIGNAL (rowsRemoved (const QModelIndex&, int, int)), PackageValidator::FVersions },
+		{ VersModel_, SIGNAL (modelReset ()), PackageValidator::FVersions },
+		{ VersModel_, SIGNAL (layoutChanged ()), PackageValidator::FVersions },
+		{ DepsModel_, SIGNAL (dataChanged (const QModelIndex&, const QModelIndex&)), PackageValidator::FDepends },
+		{ DepsModel_, SIGNAL (rowsInserted (const QModelIndex&, int, int)), PackageValidator::FDepends },
+		{ DepsModel_, SIGNAL (rowsRemoved (const QModelIndex&, int, int)), PackageValidator::FDepends },
+		{ DepsModel_, SIGNAL (modelReset ()), PackageValidator::FDepends },
+		{ DepsModel_, SIGNAL (layoutChanged ()), PackageValidator::FDepends }
+	};
+	for (const auto& field : fields)
+	{
+		connect (field.Object_,
+				field.Signal_,
+				mapper,
+				SLOT (map ()));
+		mapper->setMapping (field.Object_, field.Field_);
+	}
+
+	ArchRescanTimer_->setSingleShot (true);
+	ArchRescanTimer_->setInterval (300);
+	connect (ArchRescanTimer_,
+			SIGNAL (timeout ()),
 			this,
-			SLOT (checkValid ()));
-	connect (Ui_.Thumbnails_,
-			SIGNAL (textChanged ()),
+			SLOT (rescanArchives ()));
+	connect (ArchWatcher_,
+			SIGNAL (directoryChanged (const QString&)),
+			ArchRescanTimer_,
+			SLOT (start ()));
+
+	connect (ArchiveBuildWatcher_,
+			SIGNAL (finished ()),
 			this,
-			SLOT (checkValid ()));
-	connect (Ui_.Screenshots_,
-			SIGNAL (textChanged ()),
+			SLOT (handleArchiveBuilt ()));
+	connect (ArchiveVerifyWatcher_,
+			SIGNAL (finished ()),
 			this,
-			SLOT (checkValid ()));
-	connect (VersModel_,
-			SIGNAL (itemChanged (QStandardItem*)),
+			SLOT (handleArchivesVerified ()));
+	connect (SaveWatcher_,
+			SIGNAL (finished ()),
 			this,
-			SLOT (checkValid ()));
+			SLOT (handleSaveArchivesReady ()));
 
 	EnableCheckValid_ = true;
 	checkValid ();
 }
 
-enum Type
+MainWindow::~MainWindow ()
 {
-	SetTextable,
-	StringListJoinable,
-	StringListModel,
-	StringListList
-};
-
-template<Type ET>
-struct EvaluateQuery;
-
-template<>
-struct EvaluateQuery<SetTextable>
-{
-	template<typename T>
-	bool operator() (QXmlQuery& query,
-			const QString& queryString, T *setTextable) const
-	{
-		query.setQuery (queryString);
-		QString out;
-		if (!query.evaluateTo (&out))
-		{
-			qWarning () << Q_FUNC_INFO
-					<< "query evaluation error";
-			return false;
-		}
-
-		setTextable->setText (out.trimmed ());
-		return true;
-	}
-};
-
-template<>
-struct EvaluateQuery<StringListJoinable>
-{
-	template<typename T>
-	bool operator() (QXmlQuery& query,
-			const QString& queryString, T *joinable) const
-	{
-		query.setQuery (queryString);
-		QStringList out;
-		if (!query.evaluateTo (&out))
-		{
-			qWarning () << Q_FUNC_INFO
-					<< "query evaluation error";
-			return false;
-		}
-
-		for (int i = 0; i < out.size (); ++i)
-			out [i] = out.at (i).trimmed ();
-
-		joinable->setPlainText (out.join ("\n"));
-		return true;
-	}
-};
-
-template<>
-struct EvaluateQuery<StringListModel>
-{
-	bool operator() (QXmlQuery& query,
-			const QString& queryString, QStandardItemModel *model) const
+	// The workers report progress to this object, so they must all be
+	// done before the object goes away, not just the latest one.
+	cancelOpen ();
+	Q_FOREACH (QFuture<OpenResult> future, OpenFutures_)
+		future.waitForFinished ();
+
+	// Don't lose a save that is still hashing the archives.
+	if (SaveWatcher_->isRunning ())
 	{
-		query.setQuery (queryString);
-		QStringList out;
-		if (!query.evaluateTo (&out))
-		{
-			qWarning () << Q_FUNC_INFO
-					<< "query evaluation error";
-			return false;
-		}
-
-		Q_FOREACH (const QString& str, out)
-			model->appendRow (new QStandardItem (str.trimmed ()));
-		return true;
+		SaveWatcher_->waitForFinished ();
+		handleSaveArchivesReady ();
 	}
-};
-
-template<>
-struct EvaluateQuery<StringListList>
-{
-	bool operator() (QXmlQuery& query,
-			const QString& queryString,
-			QList<QStringList>& list) const
-	{
-		query.setQuery (queryString);
-		QStringList out;
-		if (!query.evaluateTo (&out))
-		{
-			qWarning () << Q_FUNC_INFO
-					<< "outer query evaluation error";
-			return false;
-		}
-
-		if (list.isEmpty ())
-			Q_FOREACH (const QString& str, out)
-				list.append (QStringList (str.trimmed ()));
-		else
-		{
-			if (out.size () != list.size ())
-			{
-				qWarning () << Q_FUNC_INFO
-						<< "size mismatch, out vs list:"
-						<< out
-						<< list;
-				return false;
-			}
-			for (int i = 0, size = out.size ();
-					i < size; ++i)
-				list [i] << out.at (i).trimmed ();
-		}
-
-		return true;
-	}
-};
+}
 
 void MainWindow::Open (const QString& fileName)
 {
-	Clear ();
+	LC_TRACE_SCOPE ("MainWindow::Open");
 
-	CurrentFileName_ = fileName;
+	cancelOpen ();
 
 	Settings_.setValue ("LastLoadDir",
 			QFileInfo (fileName).absolutePath ());
 
-	QFile file (fileName);
-	if (!file.open (QIODevice::ReadOnly))
-	{
-		QMessageBox::warning (this,
-				tr ("Warning"),
-				tr ("Unable to open file %1 for reading.").arg (fileName));
-		return;
-	}
-
-	EnableCheckValid_ = false;
+	const int generation = ++OpenGeneration_;
+	const std::shared_ptr<QAtomicInt> cancelled (new QAtomicInt (0));
+	OpenCancelled_ = cancelled;
 
-	QXmlQuery query;
-	query.setFocus (&file);
+	OpenProgress_->setValue (0);
+	OpenProgress_->show ();
+	OpenCancel_->show ();
+	statusBar ()->showMessage (tr ("Opening %1...").arg (fileName));
 
-	try
-	{
-		QString out;
-		query.setQuery ("/package/normalize-space(string(@type))");
-		if (!query.evaluateTo (&out))
-			throw std::runtime_error (tr ("Could not get package type.")
-					.toUtf8 ().constData ());
-
-		out = out.trimmed ().simplified ();
-
-		int pos = -1;
-		if ((pos = Ui_.Type_->findText (out)) == -1)
-		{
-			QMessageBox::warning (this,
-					tr ("Warning"),
-					tr ("Unknown package type `%1`, defaulting to `plugin`.")
-						.arg (out));
-			pos = 0;
-		}
-
-		Ui_.Type_->setCurrentIndex (pos);
-
-		query.setQuery ("/package/normalize-space(string(@language))");
-		if (!query.evaluateTo (&out))
-			throw std::runtime_error (tr ("Could not get package language.")
-					.toUtf8 ().constData ());
-
-		out = out.trimmed ().simplified ();
-
-		if (Ui_.Type_->currentText () == "plugin")
-		{
-			int pos = 0;
-			if ((pos = Ui_.Language_->findText (out)) == -1)
-				throw std::runtime_error (tr ("Unknown plugin language <code>%1</code>.")
-						.arg (out)
-						.toUtf8 ().constData ());
-			Ui_.Language_->setCurrentIndex (pos);
-		}
-		else if (Ui_.Type_->currentText () == "translation")
-			Ui_.Language_->addItem (out);
-
-		QStringList tags;
-
-		query.setQuery ("/package/tags/tag/string(text())");
-		if (!query.evaluateTo (&tags))
-			throw std::runtime_error (tr ("Could not get tags.")
-					.toUtf8 ().constData ());
-
-		Ui_.Tags_->setText (tags.join ("; "));
-
-		EvaluateQuery<SetTextable> () (query, "/package/name/text()", Ui_.Name_);
-		EvaluateQuery<SetTextable> () (query, "/package/description/text()", Ui_.Description_);
-		EvaluateQuery<SetTextable> () (query, "/package/long/text()", Ui_.LongDescription_);
-		EvaluateQuery<SetTextable> () (query, "/package/maintainer/name/text()", Ui_.MaintName_);
-		EvaluateQuery<SetTextable> () (query, "/package/maintainer/email/text()", Ui_.MaintEmail_);
-
-		EvaluateQuery<StringListModel> () (query, "/package/versions/version/normalize-space(string(text()))", VersModel_);
-
-		EvaluateQuery<StringListJoinable> () (query, "/package/images/thumbnail/normalize-space(string(@url))", Ui_.Thumbnails_);
-		EvaluateQuery<StringListJoinable> () (query, "/package/images/screenshot/normalize-space(string(@url))", Ui_.Screenshots_);
-
-		QList<QStringList> rows;
-		EvaluateQuery<StringListList> () (query, "/package/depends/depend/string(@thisVersion)", rows);
-		EvaluateQuery<StringListList> () (query, "/package/depends/depend/string(@type)", rows);
-		EvaluateQuery<StringListList> () (query, "/package/depends/depend/string(@name)", rows);
-		EvaluateQuery<StringListList> () (query, "/package/depends/depend/string(@version)", rows);
-		Q_FOREACH (const QStringList& row, rows)
-		{
-			QList<QStandardItem*> items;
-			Q_FOREACH (const QString& item, row)
-				items << new QStandardItem (item);
-			DepsModel_->appendRow (items);
-		}
-	}
-	catch (const std::exception& e)
-	{
-		QMessageBox::critical (this,
-				tr ("Critical error"),
-				QString::fromUtf8 (e.what ()));
-	}
-
-	EnableCheckValid_ = true;
+	// The file is parsed and the arch/ directory is listed on a
+	// worker, so a slow disk doesn't freeze the window. The result is
+	// only used if no other file has been opened and opening hasn't
+	// been cancelled meanwhile.
+	const QFuture<OpenResult>& future = QtConcurrent::run ([this, fileName, generation, cancelled] () -> OpenResult
+			{
+				OpenResult result;
+				result.Generation_ = generation;
+				result.FileName_ = fileName;
+
+				int lastPercent = -1;
+				auto progress = [this, generation, cancelled, &lastPercent] (qint64 done, qint64 total)
+					{
+						if (cancelled->load ())
+							return false;
+
+						const int percent = total > 0 ? done * 100 / total : 0;
+						if (percent != lastPercent)
+						{
+							lastPercent = percent;
+							QMetaObject::invokeMethod (this,
+									"handleOpenProgress",
+									Qt::QueuedConnection,
+									Q_ARG (int, generation),
+									Q_ARG (int, percent));
+						}
+						return true;
+					};
+
+				try
+				{
+					result.Data_ = PackageSnapshot::Load (fileName, result.Warnings_, progress);
+					if (!cancelled->load ())
+						result.ArchIndex_ = ArchiveIndex::ForPackage (fileName);
+				}
+				catch (const std::exception& e)
+				{
+					result.Error_ = QString::fromUtf8 (e.what ());
+				}
+				return result;
+			});
+
+	for (QList<QFuture<OpenResult>>::iterator i = OpenFutures_.begin (); i != OpenFutures_.end (); )
+		if (i->isFinished ())
+			i = OpenFutures_.erase (i);
+		else
+			++i;
+	OpenFutures_ << future;
 
-	checkValid ();
+	OpenWatcher_->setFuture (future);
 }
 
 void MainWindow::Clear ()
@@ -327,11 +265,12 @@ void MainWindow::Clear ()
 	Ui_.MaintEmail_->clear ();
 	Ui_.Thumbnails_->clear ();
 	Ui_.Screenshots_->clear ();
-	VersModel_->clear ();
-	DepsModel_->clear ();
+	VersModel_->Clear ();
+	DepsModel_->Clear ();
 
 	EnableCheckValid_ = true;
 
+	InvalidateFields (PackageValidator::FAll);
 	checkValid ();
 }
 
@@ -344,91 +283,145 @@ void MainWindow::UpdateWindowTitle ()
 	setWindowTitle (QString ("%1[*] - LCPackGen").arg (filename));
 }
 
-QString MainWindow::GetNormalizedName () const
+void MainWindow::SetCurrentFileName (const QString& fileName)
 {
-	QString normalizedName = Ui_.Name_->text ().simplified ();
-	normalizedName.remove (' ');
-	normalizedName.remove ('\t');
-	return normalizedName;
+	CurrentFileName_ = fileName;
+	RebuildArchiveIndex ();
 }
 
-namespace
+bool MainWindow::RebuildArchiveIndex ()
 {
-	struct VersionArchive
+	LC_TRACE_SCOPE ("MainWindow::RebuildArchiveIndex");
+
+	ArchiveIndex index = CurrentFileName_.isEmpty () ?
+			ArchiveIndex () :
+			ArchiveIndex::ForPackage (CurrentFileName_);
+
+	// Checksums, manifests and verification results of the archives
+	// that haven't changed stay valid. If none has changed, the
+	// directory has only been touched by something else, like our own
+	// caches, and there is nothing to redo.
+	if (index.GetPath () == ArchIndex_.GetPath () &&
+			index.Inherit (ArchIndex_))
 	{
-		QString Archiver_;
-		QString Path_;
-	};
+		ArchRescanTimer_->stop ();
+		return false;
+	}
+
+	SetArchiveIndex (index);
+	return true;
+}
 
-	VersionArchive GetArchiveInfo (const QDir& dir, const QString& normalizedName, const QString& version)
+void MainWindow::SetArchiveIndex (const ArchiveIndex& index)
+{
+	ArchRescanTimer_->stop ();
+
+	const QStringList& watched = ArchWatcher_->directories ();
+	if (!watched.isEmpty ())
+		ArchWatcher_->removePaths (watched);
+
+	ArchIndex_ = index;
+	if (!CurrentFileName_.isEmpty ())
 	{
-		QStringList knownArchivers;
-		knownArchivers << "xz"
-				<< "lzma"
-				<< "bz2"
-				<< "gz";
-		Q_FOREACH (const QString& str, knownArchivers)
-		{
-			const QString& archName = QString ("%1-%2.tar.%3")
-					.arg (normalizedName)
-					.arg (version)
-					.arg (str);
-			if (dir.exists (archName))
-				return { str, dir.filePath (archName) };
-		}
-
-		return VersionArchive ();
+		// The package directory is watched too, so that we notice
+		// the arch/ subdirectory being created or removed.
+		ArchWatcher_->addPath (QFileInfo (CurrentFileName_).absolutePath ());
+		if (ArchIndex_.Exists ())
+			ArchWatcher_->addPath (ArchIndex_.GetPath ());
 	}
+
+	Validator_.Invalidate (PackageValidator::FArchives);
 }
 
-bool MainWindow::checkValid ()
+void MainWindow::InvalidateFields (PackageValidator::Fields fields)
 {
-	setWindowModified (true);
-	if (!EnableCheckValid_)
-		return true;
+	StaleFields_ |= fields;
+	Validator_.Invalidate (fields);
+}
 
-	QStringList reasons;
+const PackageData& MainWindow::GetPackageData ()
+{
+	// Only the fields edited since the last call are read back from
+	// the widgets, the rest is still up to date.
+	if (StaleFields_ & PackageValidator::FType)
+		Data_.Type_ = Ui_.Type_->currentText ();
+	if (StaleFields_ & PackageValidator::FLanguage)
+		Data_.Language_ = Ui_.Language_->currentText ();
+	if (StaleFields_ & PackageValidator::FName)
+		Data_.Name_ = Ui_.Name_->text ();
+	if (StaleFields_ & PackageValidator::FDescription)
+		Data_.Description_ = Ui_.Description_->text ();
+	if (StaleFields_ & PackageValidator::FTags)
+		Data_.Tags_ = Ui_.Tags_->text ().split ("; ", QString::SkipEmptyParts);
+	if (StaleFields_ & PackageValidator::FLongDescription)
+		Data_.LongDescription_ = Ui_.LongDescription_->toPlainText ();
+	if (StaleFields_ & PackageValidator::FMaintName)
+		Data_.MaintName_ = Ui_.MaintName_->text ();
+	if (StaleFields_ & PackageValidator::FMaintEmail)
+		Data_.MaintEmail_ = Ui_.MaintEmail_->text ();
+	if (StaleFields_ & PackageValidator::FImages)
+	{
+		Data_.Icon_ = Ui_.Icon_->text ();
+		Data_.Thumbnails_ = Ui_.Thumbnails_->toPlainText ().split ('\n', QString::SkipEmptyParts);
+		Data_.Screenshots_ = Ui_.Screenshots_->toPlainText ().split ('\n', QString::SkipEmptyParts);
+	}
+	if (StaleFields_ & PackageValidator::FVersions)
+		Data_.Versions_ = VersModel_->GetVersions ();
+	if (StaleFields_ & PackageValidator::FDepends)
+		Data_.Depends_ = DepsModel_->GetDependencies ();
 
-	if (Ui_.Name_->text ().isEmpty ())
-		reasons << tr ("<em>Name</em> is empty.");
+	StaleFields_ = PackageValidator::Fields ();
+	return Data_;
+}
 
-	if (Ui_.Description_->text ().isEmpty ())
-		reasons << tr ("<em>Description</em> is empty.");
+void MainWindow::SetPackageData (const PackageData& data)
+{
+	EnableCheckValid_ = false;
 
-	if (Ui_.Tags_->text ().isEmpty ())
-		reasons << tr ("<em>Tags</em> are empty.");
+	Ui_.Type_->setCurrentIndex (std::max (Ui_.Type_->findText (data.Type_), 0));
+	if (data.Type_ == "plugin")
+		Ui_.Language_->setCurrentIndex (Ui_.Language_->findText (data.Language_));
+	else if (data.Type_ == "translation")
+		Ui_.Language_->addItem (data.Language_);
 
-	if (Ui_.MaintName_->text ().isEmpty ())
-		reasons << tr ("<em>Maintainer name</em> is empty.");
+	Ui_.Tags_->setText (data.Tags_.join ("; "));
 
-	if (Ui_.MaintEmail_->text ().isEmpty ())
-		reasons << tr ("<em>Maintainer email</em> is empty.");
+	Ui_.Name_->setText (data.Name_);
+	Ui_.Description_->setText (data.Description_);
+	Ui_.LongDescription_->setText (data.LongDescription_);
+	Ui_.MaintName_->setText (data.MaintName_);
+	Ui_.MaintEmail_->setText (data.MaintEmail_);
 
-	if (Ui_.Type_->currentText () == "translation" &&
-			QLocale (Ui_.Language_->currentText ()).language () == QLocale::C)
-		reasons << tr ("<em>Language</em> has unkown language code %1.")
-				.arg (Ui_.Language_->currentText ());
+	VersModel_->SetVersions (data.Versions_);
 
-	if (!VersModel_->rowCount ())
-		reasons << tr ("No versions are defined.");
+	Ui_.Icon_->setText (data.Icon_);
+	Ui_.Thumbnails_->setPlainText (data.Thumbnails_.join ("\n"));
+	Ui_.Screenshots_->setPlainText (data.Screenshots_.join ("\n"));
 
-	if (!CurrentFileName_.isEmpty ())
-	{
-		QDir archDir = QFileInfo (CurrentFileName_).dir ();
-		if (!archDir.cd ("arch"))
-			reasons << tr ("No <em>arch</em> subdirectory in package description directory.");
-		else
-		{
-			const QString& normalized = GetNormalizedName ();
+	DepsModel_->SetDependencies (data.Depends_);
 
-			for (int i = 0; i < VersModel_->rowCount (); ++i)
-			{
-				const QString& version = VersModel_->item (i)->text ();
-				if (GetArchiveInfo (archDir, normalized, version).Archiver_.isEmpty ())
-					reasons << tr ("No archiver for version <em>%1</em>").arg (version);
-			}
-		}
-	}
+	EnableCheckValid_ = true;
+
+	InvalidateFields (PackageValidator::FAll);
+	checkValid ();
+}
+
+void MainWindow::handleFieldChanged (int field)
+{
+	InvalidateFields (static_cast<PackageValidator::Field> (field));
+	checkValid ();
+}
+
+bool MainWindow::checkValid ()
+{
+	LC_TRACE_SCOPE ("MainWindow::checkValid");
+
+	setWindowModified (true);
+	if (!EnableCheckValid_)
+		return true;
+
+	const QStringList& reasons = Validator_.Validate (GetPackageData (),
+			ArchIndex_);
 
 	if (reasons.size ())
 	{
@@ -448,12 +441,85 @@ bool MainWindow::checkValid ()
 	}
 }
 
+void MainWindow::rescanArchives ()
+{
+	if (!RebuildArchiveIndex ())
+		return;
+
+	const bool modified = isWindowModified ();
+	checkValid ();
+	setWindowModified (modified);
+}
+
+void MainWindow::handleOpenProgress (int generation, int percent)
+{
+	if (generation == OpenGeneration_)
+		OpenProgress_->setValue (percent);
+}
+
+void MainWindow::handleOpenFinished ()
+{
+	LC_TRACE_SCOPE ("MainWindow::handleOpenFinished");
+
+	const OpenResult& result = OpenWatcher_->result ();
+	if (result.Generation_ != OpenGeneration_ ||
+			!OpenCancelled_ ||
+			OpenCancelled_->load ())
+		return;
+
+	OpenCancelled_.reset ();
+	OpenProgress_->hide ();
+	OpenCancel_->hide ();
+	statusBar ()->clearMessage ();
+
+	if (!result.Error_.isEmpty ())
+	{
+		QMessageBox::critical (this,
+				tr ("Critical error"),
+				result.Error_);
+		return;
+	}
+
+	Clear ();
+
+	CurrentFileName_ = result.FileName_;
+	SourceFileName_ = result.FileName_;
+	SetArchiveIndex (result.ArchIndex_);
+
+	SetPackageData (result.Data_);
+
+	setWindowModified (false);
+	UpdateWindowTitle ();
+
+	Q_FOREACH (const QString& warning, result.Warnings_)
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				warning);
+}
+
+void MainWindow::cancelOpen ()
+{
+	if (!OpenCancelled_)
+		return;
+
+	OpenCancelled_->store (1);
+	OpenCancelled_.reset ();
+	++OpenGeneration_;
+
+	OpenProgress_->hide ();
+	OpenCancel_->hide ();
+	statusBar ()->clearMessage ();
+}
+
 void MainWindow::on_ActionNew__triggered ()
 {
+	cancelOpen ();
+
+	SetCurrentFileName (QString ());
+	SourceFileName_.clear ();
 	Clear ();
 
 	setWindowModified (false);
-	CurrentFileName_ = QString ();
 
 	UpdateWindowTitle ();
 }
@@ -470,12 +536,12 @@ void MainWindow::on_ActionLoad__triggered ()
 		return;
 
 	Open (fileName);
-	setWindowModified (false);
-	UpdateWindowTitle ();
 }
 
 void MainWindow::on_ActionSave__triggered ()
 {
+	LC_TRACE_SCOPE ("MainWindow::Save");
+
 	if (!checkValid () &&
 			QMessageBox::question (this,
 					tr ("Question"),
@@ -483,161 +549,127 @@ void MainWindow::on_ActionSave__triggered ()
 					QMessageBox::Yes | QMessageBox::No) == QMessageBox::No)
 		return;
 
-	const QString& normalizedName = GetNormalizedName ();
+	const PackageData& data = GetPackageData ();
 
 	if (CurrentFileName_.isEmpty ())
 	{
 		QString prevDir = Settings_.value ("LastLoadDir",
 				QDir::homePath ()).toString ();
 
-		CurrentFileName_ = QFileDialog::getSaveFileName (this,
+		const QString& fileName = QFileDialog::getSaveFileName (this,
 				tr ("Select file name"),
-				prevDir + '/' + normalizedName + ".xml",
+				prevDir + '/' + data.GetNormalizedName () + ".xml",
 				tr ("XML files (*.xml);;All files (*.*)"));
 
-		if (CurrentFileName_.isEmpty ())
+		if (fileName.isEmpty ())
 			return;
-	}
 
-	QFile outFile (CurrentFileName_);
-	if (!outFile.open (QIODevice::WriteOnly))
-	{
-		QMessageBox::warning (this,
-				tr ("Critical error"),
-				tr ("Could not open file %1 for writing. File is not saved.")
-					.arg (CurrentFileName_));
-		return;
+		SetCurrentFileName (fileName);
 	}
+	else if (ArchRescanTimer_->isActive ())
+		RebuildArchiveIndex ();
 
-	QDomDocument doc;
-
-	QDomElement package = doc.createElement ("package");
-	package.setAttribute ("type", Ui_.Type_->currentText ());
-	if (!Ui_.Language_->currentText ().isEmpty ())
-		package.setAttribute ("language", Ui_.Language_->currentText ());
-	doc.appendChild (package);
-
-	QDomElement name = doc.createElement ("name");
-	name.appendChild (doc.createTextNode (Ui_.Name_->text ()));
-	package.appendChild (name);
-
-	QDomElement descr = doc.createElement ("description");
-	descr.appendChild (doc.createTextNode (Ui_.Description_->text ()));
-	package.appendChild (descr);
-
-	QDomElement tags = doc.createElement ("tags");
-	package.appendChild (tags);
-	Q_FOREACH (const QString& tag, Ui_.Tags_->text ().split ("; "))
+	const bool checksums = Ui_.ActionChecksums_->isChecked ();
+	const bool manifests = Ui_.ActionManifests_->isChecked ();
+	if (!checksums && !manifests)
 	{
-		QDomElement tagNode = doc.createElement ("tag");
-		tagNode.appendChild (doc.createTextNode (tag));
-		tags.appendChild (tagNode);
+		if (WritePackage (data, CurrentFileName_, ArchIndex_, SourceFileName_))
+			setWindowModified (false);
+		UpdateWindowTitle ();
+		return;
 	}
 
-	QDir dir = QFileInfo (CurrentFileName_).dir ();
-	dir.cd ("arch");
+	// Hashing the archives may take a while, so it's done on a worker
+	// thread, and the description is written once it's done.
+	SaveData_ = data;
+	SaveFileName_ = CurrentFileName_;
+	SaveSourceFileName_ = SourceFileName_;
+	const QString& normalizedName = data.GetNormalizedName ();
+	const QStringList& versions = data.Versions_;
+	ArchiveIndex index = ArchIndex_;
 
-	QDomElement versions = doc.createElement ("versions");
-	package.appendChild (versions);
-	for (int i = 0, size = VersModel_->rowCount ();
-			i < size; ++i)
-	{
-		const QString& version = VersModel_->item (i)->text ();
-
-		QDomElement verNode = doc.createElement ("version");
-		verNode.appendChild (doc.createTextNode (version));
+	// Edits made in the meantime mark the window modified again.
+	setWindowModified (false);
+	Ui_.ActionSave_->setEnabled (false);
+	Ui_.ActionSaveAs_->setEnabled (false);
+	statusBar ()->showMessage (tr ("Reading archives..."));
 
-		const VersionArchive& archive = GetArchiveInfo (dir, normalizedName, version);
-		verNode.setAttribute ("size", QFileInfo (archive.Path_).size ());
-		verNode.setAttribute ("archiver", archive.Archiver_);
+	SaveWatcher_->setFuture (QtConcurrent::run ([index, normalizedName, versions, checksums, manifests] () -> SaveArchives
+			{
+				SaveArchives result;
+				result.Index_ = index;
+				if (checksums)
+					result.Index_.ComputeChecksums (normalizedName, versions);
+				if (manifests)
+				{
+					const QHash<QString, QString>& errors = result.Index_.ComputeManifests (normalizedName, versions);
+					for (QHash<QString, QString>::const_iterator i = errors.begin (); i != errors.end (); ++i)
+						result.Warnings_ << tr ("Could not generate the manifest of %1: %2")
+								.arg (QFileInfo (i.key ()).fileName ())
+								.arg (*i);
+				}
+				return result;
+			}));
+}
 
-		versions.appendChild (verNode);
-	}
+void MainWindow::handleSaveArchivesReady ()
+{
+	Ui_.ActionSave_->setEnabled (true);
+	Ui_.ActionSaveAs_->setEnabled (true);
+	statusBar ()->clearMessage ();
+
+	const SaveArchives& result = SaveWatcher_->result ();
+	const bool saved = WritePackage (SaveData_, SaveFileName_,
+			result.Index_, SaveSourceFileName_);
+	if (!saved && SaveFileName_ == CurrentFileName_)
+		setWindowModified (true);
+	UpdateWindowTitle ();
 
-	QString iconUrl = Ui_.Icon_->text ();
-	QString rawThumbs = Ui_.Thumbnails_->toPlainText ();
-	QString rawScreens = Ui_.Screenshots_->toPlainText ();
-	if (!iconUrl.isEmpty () ||
-			!rawThumbs.isEmpty () ||
-			!rawScreens.isEmpty ())
-	{
-		QDomElement images = doc.createElement ("images");
-
-		QDomElement icon = doc.createElement ("icon");
-		icon.setAttribute ("url", iconUrl);
-		images.appendChild (icon);
-
-		QStringList splitted = rawThumbs.split ("\n", QString::SkipEmptyParts);
-		Q_FOREACH (const QString& thumbUrl, splitted)
-		{
-			QDomElement thumb = doc.createElement ("thumbnail");
-			thumb.setAttribute ("url", thumbUrl);
-			images.appendChild (thumb);
-		}
-
-		splitted = rawScreens.split ('\n', QString::SkipEmptyParts);
-		Q_FOREACH (const QString& screenUrl, splitted)
-		{
-			QDomElement screen = doc.createElement ("screenshot");
-			screen.setAttribute ("url", screenUrl);
-			images.appendChild (screen);
-		}
-
-		package.appendChild (images);
-	}
+	// The versions just lack the manifest attributes then.
+	if (!result.Warnings_.isEmpty ())
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				result.Warnings_.join ("\n"));
+}
 
-	QString longDescr = Ui_.LongDescription_->toPlainText ();
-	if (!longDescr.isEmpty ())
+bool MainWindow::WritePackage (const PackageData& data, const QString& fileName,
+		const ArchiveIndex& index, const QString& sourceFileName)
+{
+	try
 	{
-		QDomElement longNode = doc.createElement ("long");
-		longNode.appendChild (doc.createTextNode (longDescr));
-		package.appendChild (longNode);
+		PackageWriter::Save (data, fileName, index, sourceFileName);
 	}
-
-	QDomElement maintainer = doc.createElement ("maintainer");
-	QDomElement mname = doc.createElement ("name");
-	mname.appendChild (doc.createTextNode (Ui_.MaintName_->text ()));
-	maintainer.appendChild (mname);
-	QDomElement memail = doc.createElement ("email");
-	memail.appendChild (doc.createTextNode (Ui_.MaintEmail_->text ()));
-	maintainer.appendChild (memail);
-	package.appendChild (maintainer);
-
-	QDomElement depends = doc.createElement ("depends");
-	for (int i = 0, size = DepsModel_->rowCount ();
-			i < size; ++i)
+	catch (const std::exception& e)
 	{
-		QDomElement depend = doc.createElement ("depend");
-		depend.setAttribute ("type",
-				DepsModel_->item (i, DCType)->text ());
-		depend.setAttribute ("thisVersion",
-				DepsModel_->item (i, DCThisVersion)->text ());
-		depend.setAttribute ("name",
-				DepsModel_->item (i, DCName)->text ());
-		depend.setAttribute ("version",
-				DepsModel_->item (i, DCVersion)->text ());
-		depends.appendChild (depend);
+		QMessageBox::warning (this,
+				tr ("Critical error"),
+				QString::fromUtf8 (e.what ()));
+		return false;
 	}
-	package.appendChild (depends);
 
-	// Ugly hack, on my system QDomDocument doesn't write header for
-	// some reason.
-	QByteArray result = doc.toByteArray ();
-	if (!result.startsWith ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"))
-		result.prepend ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-	outFile.write (result);
-
-	setWindowModified (false);
-	UpdateWindowTitle ();
+	// From now on, the package comes from the file it's been saved to.
+	if (fileName == CurrentFileName_)
+		SourceFileName_ = fileName;
+	return true;
 }
 
 void MainWindow::on_ActionSaveAs__triggered ()
 {
-	CurrentFileName_.clear ();
+	SetCurrentFileName (QString ());
 	on_ActionSave__triggered ();
 	UpdateWindowTitle ();
 }
 
+void MainWindow::on_ActionChecksums__toggled (bool checked)
+{
+	Settings_.setValue ("RecordChecksums", checked);
+}
+
+void MainWindow::on_ActionManifests__toggled (bool checked)
+{
+	Settings_.setValue ("GenerateManifests", checked);
+}
+
 void MainWindow::on_AddVer__released ()
 {
 	QString ver = QInputDialog::getText (this,
@@ -646,7 +678,7 @@ void MainWindow::on_AddVer__released ()
 	if (ver.isEmpty ())
 		return;
 
-	if (VersModel_->findItems (ver).size ())
+	if (!VersModel_->AddVersion (ver))
 	{
 		QMessageBox::warning (this,
 				tr ("Warning"),
@@ -655,8 +687,6 @@ void MainWindow::on_AddVer__released ()
 		return;
 	}
 
-	VersModel_->appendRow (new QStandardItem (ver));
-
 	checkValid ();
 }
 
@@ -666,34 +696,22 @@ void MainWindow::on_ModifyVer__released ()
 	if (!current.isValid ())
 		return;
 
-	QStandardItem *item = VersModel_->itemFromIndex (current);
+	const QString& oldVer = current.data ().toString ();
 	QString ver = QInputDialog::getText (this,
 			tr ("Enter version"),
 			tr ("Enter new version number:"),
 			QLineEdit::Normal,
-			item->text ());
+			oldVer);
 	if (ver.isEmpty () ||
-			ver == item->text ())
+			ver == oldVer)
 		return;
 
-	if (VersModel_->findItems (ver).size ())
-	{
+	// The dependencies are updated by the model via versionRenamed().
+	if (!VersModel_->setData (current, ver))
 		QMessageBox::warning (this,
 				tr ("Warning"),
 				tr ("Version <em>%1</em> already exists.")
 					.arg (ver));
-		return;
-	}
-
-	for (int i = 0, size = DepsModel_->rowCount ();
-			i < size; ++i)
-	{
-		QStandardItem *depItem = DepsModel_->item (i, DCThisVersion);
-		if (depItem->text () == item->text ())
-			depItem->setText (ver);
-	}
-
-	item->setText (ver);
 }
 
 void MainWindow::on_RemoveVer__released ()
@@ -705,30 +723,206 @@ void MainWindow::on_RemoveVer__released ()
 	if (!current.isValid ())
 		return;
 
-	QString ver = VersModel_->itemFromIndex (current)->text ();
-	QList<QStandardItem*> relatedItems = VersModel_->findItems (ver);
-	if (relatedItems.size ())
+	const QString& ver = current.data ().toString ();
+	const int references = DepsModel_->CountReferences (ver);
+	if (references)
 	{
 		QMessageBox::warning (this,
 				tr ("Error"),
 				tr ("There are %1 dependencies which mention this version "
 					"(%2) you are going to delete. Please modify or remove"
 					" those dependencies first.")
-					.arg (relatedItems.size ())
+					.arg (references)
 					.arg (ver));
 		return;
 	}
 
-	qDeleteAll (VersModel_->takeRow (current.row ()));
+	VersModel_->RemoveVersion (current.row ());
 }
 
-void MainWindow::on_AddDep__released ()
+void MainWindow::on_BuildArchive__released ()
+{
+	if (CurrentFileName_.isEmpty ())
+	{
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				tr ("Please save the package first, the archive is put "
+					"next to the package description."));
+		return;
+	}
+
+	const QString& normalizedName = GetPackageData ().GetNormalizedName ();
+	if (normalizedName.isEmpty ())
+	{
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				tr ("Please set the package name first."));
+		return;
+	}
+
+	const QModelIndex& current = Ui_.VersTree_->selectionModel ()->currentIndex ();
+	const QString& version = QInputDialog::getText (this,
+			tr ("Enter version"),
+			tr ("Enter the version to build the archive for:"),
+			QLineEdit::Normal,
+			current.isValid () ? current.data ().toString () : QString ());
+	if (version.isEmpty ())
+		return;
+
+	const QString& sourceDir = QFileDialog::getExistingDirectory (this,
+			tr ("Select directory with package contents"),
+			Settings_.value ("LastArchiveSourceDir",
+					QFileInfo (CurrentFileName_).absolutePath ()).toString ());
+	if (sourceDir.isEmpty ())
+		return;
+
+	Settings_.setValue ("LastArchiveSourceDir", sourceDir);
+
+	const QString& archDir = QFileInfo (CurrentFileName_).dir ().filePath ("arch");
+
+	ArchiveBuildVersion_ = version;
+	ArchiveBuildFileName_ = CurrentFileName_;
+	Ui_.BuildArchive_->setEnabled (false);
+	statusBar ()->showMessage (tr ("Building archive for version %1...").arg (version));
+
+	ArchiveBuildWatcher_->setFuture (QtConcurrent::run ([sourceDir, archDir, normalizedName, version] () -> QString
+			{
+				try
+				{
+					ArchiveBuilder::Build (sourceDir, archDir, normalizedName, version);
+					return QString ();
+				}
+				catch (const std::exception& e)
+				{
+					return QString::fromUtf8 (e.what ());
+				}
+			}));
+}
+
+void MainWindow::on_DiscoverVers__released ()
+{
+	if (CurrentFileName_.isEmpty ())
+	{
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				tr ("Please save the package first, the archives are looked "
+					"up next to the package description."));
+		return;
+	}
+
+	const QString& normalizedName = GetPackageData ().GetNormalizedName ();
+	if (normalizedName.isEmpty ())
+	{
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				tr ("Please set the package name first."));
+		return;
+	}
+
+	if (ArchRescanTimer_->isActive ())
+		RebuildArchiveIndex ();
+
+	const int added = VersModel_->AddVersions (ArchIndex_.GetVersions (normalizedName));
+	statusBar ()->showMessage (tr ("%n new version(s) discovered.", 0, added), 5000);
+}
+
+void MainWindow::on_SortVers__released ()
+{
+	VersModel_->sort (0);
+}
+
+void MainWindow::handleArchiveBuilt ()
+{
+	Ui_.BuildArchive_->setEnabled (true);
+	statusBar ()->clearMessage ();
+
+	const QString& error = ArchiveBuildWatcher_->result ();
+	if (!error.isEmpty ())
+	{
+		QMessageBox::critical (this,
+				tr ("Critical error"),
+				tr ("Could not build the archive: %1").arg (error));
+		return;
+	}
+
+	// Another package could have been opened while the archive was
+	// being built, and the version doesn't belong to it.
+	if (ArchiveBuildFileName_ != CurrentFileName_)
+	{
+		statusBar ()->showMessage (tr ("Archive for version %1 of %2 has been built.")
+					.arg (ArchiveBuildVersion_)
+					.arg (QFileInfo (ArchiveBuildFileName_).fileName ()),
+				5000);
+		return;
+	}
+
+	VersModel_->AddVersion (ArchiveBuildVersion_);
+
+	RebuildArchiveIndex ();
+	checkValid ();
+}
+
+void MainWindow::on_VerifyArchs__released ()
 {
-	QStringList thisVersions;
-	for (int i = 0, size = VersModel_->rowCount ();
-			i < size; ++i)
-		thisVersions << VersModel_->item (i)->text ();
+	if (!ArchIndex_.Exists ())
+	{
+		QMessageBox::warning (this,
+				tr ("Warning"),
+				tr ("There is no <em>arch</em> subdirectory next to the "
+					"package description."));
+		return;
+	}
 
+	if (ArchRescanTimer_->isActive ())
+		RebuildArchiveIndex ();
+
+	const QString& normalizedName = GetPackageData ().GetNormalizedName ();
+	const QStringList& versions = VersModel_->GetVersions ();
+	ArchiveIndex index = ArchIndex_;
+
+	Ui_.VerifyArchs_->setEnabled (false);
+	statusBar ()->showMessage (tr ("Verifying archives..."));
+
+	ArchiveVerifyWatcher_->setFuture (QtConcurrent::run ([index, normalizedName, versions] () mutable -> ArchiveIndex
+			{
+				index.VerifyArchives (normalizedName, versions);
+				return index;
+			}));
+}
+
+void MainWindow::handleArchivesVerified ()
+{
+	Ui_.VerifyArchs_->setEnabled (true);
+	statusBar ()->clearMessage ();
+
+	// Another package may have been opened in the meantime, then the
+	// results are of no use.
+	const ArchiveIndex& verified = ArchiveVerifyWatcher_->result ();
+	if (verified.GetPath () != ArchIndex_.GetPath ())
+		return;
+
+	// The directory may have changed too, if only because the
+	// verifier has updated its cache there, so it's rescanned, and
+	// the results are kept for the archives that haven't changed.
+	ArchiveIndex index (verified.GetPath ());
+	index.Inherit (verified);
+	SetArchiveIndex (index);
+
+	const bool modified = isWindowModified ();
+	checkValid ();
+	setWindowModified (modified);
+
+	const QString& normalizedName = GetPackageData ().GetNormalizedName ();
+	int corrupted = 0;
+	Q_FOREACH (const QString& version, VersModel_->GetVersions ())
+		if (!index.Find (normalizedName, version).Corruption_.isEmpty ())
+			++corrupted;
+	statusBar ()->showMessage (tr ("%n corrupted archive(s) found.", 0, corrupted), 5000);
+}
+
+void MainWindow::on_AddDep__released ()
+{
+	const QStringList& thisVersions = VersModel_->GetVersions ();
 	if (!thisVersions.size ())
 	{
 		QMessageBox::critical (this,
@@ -783,13 +977,12 @@ void MainWindow::on_AddDep__released ()
 	if (depVersion.isEmpty ())
 		return;
 
-
-	QList<QStandardItem*> items;
-	items << new QStandardItem (thisVer);
-	items << new QStandardItem (type);
-	items << new QStandardItem (name);
-	items << new QStandardItem (depVersion);
-	DepsModel_->appendRow (items);
+	Dependency dep;
+	dep.ThisVersion_ = thisVer;
+	dep.Type_ = type;
+	dep.Name_ = name;
+	dep.Version_ = depVersion;
+	DepsModel_->AddDependency (dep);
 }
 
 void MainWindow::on_ModifyDep__released ()
@@ -798,18 +991,18 @@ void MainWindow::on_ModifyDep__released ()
 	if (!current.isValid ())
 		return;
 
-	QStandardItem *item = DepsModel_->itemFromIndex (current);
+	const QString& text = current.data ().toString ();
 	QString ver = QInputDialog::getText (this,
 			tr ("Enter new data"),
 			tr ("Enter new data for this item (%1):")
-				.arg (item->text ()),
+				.arg (text),
 			QLineEdit::Normal,
-			item->text ());
+			text);
 	if (ver.isEmpty () ||
-			ver == item->text ())
+			ver == text)
 		return;
 
-	item->setText (ver);
+	DepsModel_->setData (current, ver);
 }
 
 void MainWindow::on_RemoveDep__released ()
@@ -818,7 +1011,7 @@ void MainWindow::on_RemoveDep__released ()
 	if (!current.isValid ())
 		return;
 
-	qDeleteAll (DepsModel_->takeRow (current.row ()));
+	DepsModel_->RemoveDependency (current.row ());
 }
 
 void MainWindow::on_Type__currentIndexChanged (const QString& text)
@@ -18,11 +18,23 @@
 
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
+#include <memory>
+#include <QFuture>
 #include <QMainWindow>
 #include <QSettings>
 #include "ui_mainwindow.h"
+#include "packagedata.h"
+#include "packagevalidator.h"
+#include "archiveinfo.h"
 
-class QStandardItemModel;
+class VersionsModel;
+class DependenciesModel;
+class QFileSystemWatcher;
+class QTimer;
+class QProgressBar;
+class QToolButton;
+template<typename T>
+class QFutureWatcher;
 
 class MainWindow : public QMainWindow
 {
@@ -30,37 +42,109 @@ class MainWindow : public QMainWindow
 
 	Ui::MainWindow Ui_;
 	QLabel *ValidLabel_;
-	QStandardItemModel *VersModel_;
-	QStandardItemModel *DepsModel_;
+	VersionsModel *VersModel_;
+	DependenciesModel *DepsModel_;
 	QSettings Settings_;
 	bool EnableCheckValid_;
-	enum DepsColumns
+	QString CurrentFileName_;
+
+	/** The file the package in the editor has been loaded from or
+	 * last saved to, if any, which saving may splice the changes
+	 * into.
+	 */
+	QString SourceFileName_;
+	PackageValidator Validator_;
+
+	/** The package as last read from the widgets, and the fields
+	 * that have been edited since.
+	 */
+	PackageData Data_;
+	PackageValidator::Fields StaleFields_;
+	ArchiveIndex ArchIndex_;
+	QFileSystemWatcher *ArchWatcher_;
+	QTimer *ArchRescanTimer_;
+	QFutureWatcher<QString> *ArchiveBuildWatcher_;
+	QString ArchiveBuildVersion_;
+	QString ArchiveBuildFileName_;
+	QFutureWatcher<ArchiveIndex> *ArchiveVerifyWatcher_;
+
+	/** The package being saved and where to, while the checksums and
+	 * manifests of its archives are computed on a worker thread.
+	 */
+	struct SaveArchives
 	{
-		DCThisVersion,
-		DCType,
-		DCName,
-		DCVersion
+		ArchiveIndex Index_;
+		QStringList Warnings_;
 	};
-	QString CurrentFileName_;
+	QFutureWatcher<SaveArchives> *SaveWatcher_;
+	PackageData SaveData_;
+	QString SaveFileName_;
+	QString SaveSourceFileName_;
+
+	/** Everything Open() needs from the disk, prepared on a worker
+	 * thread.
+	 */
+	struct OpenResult
+	{
+		int Generation_;
+		QString FileName_;
+		PackageData Data_;
+		QStringList Warnings_;
+		QString Error_;
+		ArchiveIndex ArchIndex_;
+	};
+	QFutureWatcher<OpenResult> *OpenWatcher_;
+
+	/** The workers still running, cancelled ones included, since they
+	 * all report their progress to this object.
+	 */
+	QList<QFuture<OpenResult>> OpenFutures_;
+	QProgressBar *OpenProgress_;
+	QToolButton *OpenCancel_;
+	int OpenGeneration_;
+	std::shared_ptr<QAtomicInt> OpenCancelled_;
 public:
 	MainWindow ();
+	~MainWindow ();
 
 	void Open (const QString&);
 private:
 	void Clear ();
 	void UpdateWindowTitle ();
-	QString GetNormalizedName () const;
+	void SetCurrentFileName (const QString&);
+	bool RebuildArchiveIndex ();
+	void SetArchiveIndex (const ArchiveIndex&);
+	void InvalidateFields (PackageValidator::Fields);
+	const PackageData& GetPackageData ();
+	void SetPackageData (const PackageData&);
+	bool WritePackage (const PackageData&, const QString& fileName,
+			const ArchiveIndex&, const QString& sourceFileName);
 private slots:
+	void handleFieldChanged (int);
 	bool checkValid ();
+	void rescanArchives ();
+
+	void handleOpenProgress (int generation, int percent);
+	void handleOpenFinished ();
+	void cancelOpen ();
 
 	void on_ActionNew__triggered ();
 	void on_ActionLoad__triggered ();
 	void on_ActionSave__triggered ();
 	void on_ActionSaveAs__triggered ();
+	void handleSaveArchivesReady ();
+	void on_ActionChecksums__toggled (bool);
+	void on_ActionManifests__toggled (bool);
 
 	void on_AddVer__released ();
 	void on_ModifyVer__released ();
 	void on_RemoveVer__released ();
+	void on_BuildArchive__released ();
+	void on_DiscoverVers__released ();
+	void on_SortVers__released ();
+	void handleArchiveBuilt ();
+	void on_VerifyArchs__released ();
+	void handleArchivesVerified ();
 	void on_AddDep__released ();
 	void on_ModifyDep__released ();
 	void on_RemoveDep__released ();
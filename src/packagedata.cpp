@@ -0,0 +1,40 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packagedata.h"
+
+bool operator== (const Dependency& left, const Dependency& right)
+{
+	return left.ThisVersion_ == right.ThisVersion_ &&
+			left.Type_ == right.Type_ &&
+			left.Name_ == right.Name_ &&
+			left.Version_ == right.Version_;
+}
+
+bool operator!= (const Dependency& left, const Dependency& right)
+{
+	return !(left == right);
+}
+
+QString PackageData::GetNormalizedName () const
+{
+	QString normalizedName = Name_.simplified ();
+	normalizedName.remove (' ');
+	normalizedName.remove ('\t');
+	return normalizedName;
+}
@@ -0,0 +1,59 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGEDATA_H
+#define PACKAGEDATA_H
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+struct Dependency
+{
+	QString ThisVersion_;
+	QString Type_;
+	QString Name_;
+	QString Version_;
+};
+
+bool operator== (const Dependency&, const Dependency&);
+bool operator!= (const Dependency&, const Dependency&);
+
+/** Plain representation of a package description, independent of
+ * any widgets, so that it could be loaded, checked and saved from
+ * both the GUI and the batch mode.
+ */
+struct PackageData
+{
+	QString Type_;
+	QString Language_;
+	QString Name_;
+	QString Description_;
+	QStringList Tags_;
+	QString LongDescription_;
+	QString MaintName_;
+	QString MaintEmail_;
+	QString Icon_;
+	QStringList Thumbnails_;
+	QStringList Screenshots_;
+	QStringList Versions_;
+	QList<Dependency> Depends_;
+
+	QString GetNormalizedName () const;
+};
+
+#endif
@@ -0,0 +1,269 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packageloader.h"
+#include <stdexcept>
+#include <QFile>
+#include <QHash>
+#include <QXmlStreamReader>
+#include "tracing.h"
+
+namespace
+{
+	QString ReadText (QXmlStreamReader& reader)
+	{
+		return reader.readElementText (QXmlStreamReader::SkipChildElements);
+	}
+
+	QString ReadAttr (const QXmlStreamReader& reader, const char *name)
+	{
+		return reader.attributes ().value (QLatin1String (name)).toString ();
+	}
+
+	void ReadTags (QXmlStreamReader& reader, PackageData& result)
+	{
+		while (reader.readNextStartElement ())
+			if (reader.name () == "tag")
+				result.Tags_ << ReadText (reader);
+			else
+				reader.skipCurrentElement ();
+	}
+
+	void ReadVersions (QXmlStreamReader& reader, PackageData& result)
+	{
+		while (reader.readNextStartElement ())
+			if (reader.name () == "version")
+				result.Versions_ << ReadText (reader).simplified ();
+			else
+				reader.skipCurrentElement ();
+	}
+
+	void ReadImages (QXmlStreamReader& reader, PackageData& result)
+	{
+		while (reader.readNextStartElement ())
+		{
+			const QStringRef& name = reader.name ();
+			if (name == "icon")
+				result.Icon_ = ReadAttr (reader, "url").simplified ();
+			else if (name == "thumbnail")
+				result.Thumbnails_ << ReadAttr (reader, "url").simplified ();
+			else if (name == "screenshot")
+				result.Screenshots_ << ReadAttr (reader, "url").simplified ();
+			reader.skipCurrentElement ();
+		}
+	}
+
+	void ReadMaintainer (QXmlStreamReader& reader, PackageData& result)
+	{
+		while (reader.readNextStartElement ())
+		{
+			const QStringRef& name = reader.name ();
+			if (name == "name")
+				result.MaintName_ = ReadText (reader).trimmed ();
+			else if (name == "email")
+				result.MaintEmail_ = ReadText (reader).trimmed ();
+			else
+				reader.skipCurrentElement ();
+		}
+	}
+
+	/** Passes the data through from the source device, reporting the
+	 * progress before each read, if there is a handler, and counting
+	 * the bytes actually read for the tracing.
+	 */
+	class ProgressDevice : public QIODevice
+	{
+		QIODevice * const Source_;
+		const PackageLoader::ProgressHandler_t& Handler_;
+		bool Cancelled_;
+		qint64 Read_;
+	public:
+		ProgressDevice (QIODevice *source, const PackageLoader::ProgressHandler_t& handler)
+		: Source_ (source)
+		, Handler_ (handler)
+		, Cancelled_ (false)
+		, Read_ (0)
+		{
+			open (QIODevice::ReadOnly | QIODevice::Unbuffered);
+		}
+
+		~ProgressDevice ()
+		{
+			LC_TRACE_COUNT (CXmlBytesParsed, Read_);
+		}
+
+		bool IsCancelled () const
+		{
+			return Cancelled_;
+		}
+
+		bool isSequential () const
+		{
+			return true;
+		}
+	protected:
+		qint64 readData (char *data, qint64 maxSize)
+		{
+			if (!Cancelled_ && Handler_ && !Handler_ (Source_->pos (), Source_->size ()))
+				Cancelled_ = true;
+			if (Cancelled_)
+				return -1;
+
+			const qint64 read = Source_->read (data, maxSize);
+			if (read > 0)
+				Read_ += read;
+			return read;
+		}
+
+		qint64 writeData (const char*, qint64)
+		{
+			return -1;
+		}
+	};
+
+	void ReadDepends (QXmlStreamReader& reader, PackageData& result)
+	{
+		while (reader.readNextStartElement ())
+		{
+			if (reader.name () == "depend")
+			{
+				Dependency dep;
+				dep.ThisVersion_ = ReadAttr (reader, "thisVersion").trimmed ();
+				dep.Type_ = ReadAttr (reader, "type").trimmed ();
+				dep.Name_ = ReadAttr (reader, "name").trimmed ();
+				dep.Version_ = ReadAttr (reader, "version").trimmed ();
+				result.Depends_ << dep;
+			}
+			reader.skipCurrentElement ();
+		}
+	}
+}
+
+QStringList PackageLoader::GetKnownTypes ()
+{
+	return QStringList ("plugin")
+			<< "quark"
+			<< "theme"
+			<< "data"
+			<< "translation"
+			<< "iconset";
+}
+
+QStringList PackageLoader::GetPluginLanguages ()
+{
+	return QStringList ("python") << "qtscript";
+}
+
+PackageData PackageLoader::Load (const QString& fileName,
+		QStringList& warnings, const ProgressHandler_t& progress)
+{
+	LC_TRACE_SCOPE ("PackageLoader::Load");
+
+	QFile file (fileName);
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (tr ("Unable to open file %1 for reading.")
+				.arg (fileName)
+				.toUtf8 ().constData ());
+
+	return Load (&file, warnings, progress);
+}
+
+PackageData PackageLoader::Load (QIODevice *device,
+		QStringList& warnings, const ProgressHandler_t& progress)
+{
+	ProgressDevice progressDevice (device, progress);
+	QXmlStreamReader reader (&progressDevice);
+
+	auto checkCancelled = [&progressDevice] ()
+		{
+			if (progressDevice.IsCancelled ())
+				throw std::runtime_error (tr ("Loading has been cancelled.")
+						.toUtf8 ().constData ());
+		};
+
+	if (!reader.readNextStartElement () ||
+			reader.name () != "package")
+	{
+		checkCancelled ();
+		throw std::runtime_error (tr ("Could not get package type.")
+				.toUtf8 ().constData ());
+	}
+
+	PackageData result;
+
+	QString type = ReadAttr (reader, "type").simplified ();
+	if (!GetKnownTypes ().contains (type))
+	{
+		warnings << tr ("Unknown package type `%1`, defaulting to `plugin`.")
+				.arg (type);
+		type = "plugin";
+	}
+	result.Type_ = type;
+
+	const QString& language = ReadAttr (reader, "language").simplified ();
+	if (result.Type_ == "plugin")
+	{
+		if (!GetPluginLanguages ().contains (language))
+			throw std::runtime_error (tr ("Unknown plugin language <code>%1</code>.")
+					.arg (language)
+					.toUtf8 ().constData ());
+		result.Language_ = language;
+	}
+	else if (result.Type_ == "translation")
+		result.Language_ = language;
+
+	while (reader.readNextStartElement ())
+	{
+		const QStringRef& name = reader.name ();
+		if (name == "name")
+			result.Name_ = ReadText (reader).trimmed ();
+		else if (name == "description")
+			result.Description_ = ReadText (reader).trimmed ();
+		else if (name == "long")
+			result.LongDescription_ = ReadText (reader).trimmed ();
+		else if (name == "tags")
+			ReadTags (reader, result);
+		else if (name == "versions")
+			ReadVersions (reader, result);
+		else if (name == "images")
+			ReadImages (reader, result);
+		else if (name == "maintainer")
+			ReadMaintainer (reader, result);
+		else if (name == "depends")
+			ReadDepends (reader, result);
+		else
+			reader.skipCurrentElement ();
+	}
+
+	checkCancelled ();
+
+	if (reader.hasError ())
+		throw std::runtime_error (tr ("Malformed package description at line %1, column %2: %3")
+				.arg (reader.lineNumber ())
+				.arg (reader.columnNumber ())
+				.arg (reader.errorString ())
+				.toUtf8 ().constData ());
+
+	QHash<QString, int> versions;
+	Q_FOREACH (const QString& version, result.Versions_)
+		if (++versions [version] == 2)
+			warnings << tr ("Version `%1` is listed more than once.")
+					.arg (version);
+
+	return result;
+}
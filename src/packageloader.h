@@ -0,0 +1,57 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGELOADER_H
+#define PACKAGELOADER_H
+#include <functional>
+#include <QCoreApplication>
+#include <QStringList>
+#include "packagedata.h"
+
+class QIODevice;
+
+class PackageLoader
+{
+	Q_DECLARE_TR_FUNCTIONS (PackageLoader)
+public:
+	/** Called with the number of bytes read so far and the size of
+	 * the file. Returning false cancels loading.
+	 */
+	typedef std::function<bool (qint64 done, qint64 total)> ProgressHandler_t;
+
+	/** Parses the package description in the given file.
+	 *
+	 * Non-fatal problems (like an unknown package type) are
+	 * appended to warnings, fatal ones are thrown as
+	 * std::runtime_error, and so is the cancellation by the progress
+	 * handler, if any. This function is reentrant.
+	 */
+	static PackageData Load (const QString& fileName, QStringList& warnings,
+			const ProgressHandler_t& progress = ProgressHandler_t ());
+
+	/** Parses the package description read from the given device,
+	 * which must be open for reading.
+	 */
+	static PackageData Load (QIODevice *device, QStringList& warnings,
+			const ProgressHandler_t& progress = ProgressHandler_t ());
+
+	static QStringList GetKnownTypes ();
+	static QStringList GetPluginLanguages ();
+};
+
+#endif
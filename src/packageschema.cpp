@@ -0,0 +1,228 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packageschema.h"
+#include <stdexcept>
+#include <QAbstractMessageHandler>
+#include <QRegularExpression>
+#include <QThreadStorage>
+#include <QXmlSchema>
+#include <QXmlSchemaValidator>
+#include "tracing.h"
+
+namespace
+{
+	const char SchemaSource [] = R"(<?xml version="1.0" encoding="UTF-8"?>
+<xs:schema xmlns:xs="http://www.w3.org/2001/XMLSchema">
+	<xs:simpleType name="nonEmptyToken">
+		<xs:restriction base="xs:token">
+			<xs:minLength value="1"/>
+		</xs:restriction>
+	</xs:simpleType>
+
+	<xs:simpleType name="packageType">
+		<xs:restriction base="xs:token">
+			<xs:enumeration value="plugin"/>
+			<xs:enumeration value="quark"/>
+			<xs:enumeration value="theme"/>
+			<xs:enumeration value="data"/>
+			<xs:enumeration value="translation"/>
+			<xs:enumeration value="iconset"/>
+		</xs:restriction>
+	</xs:simpleType>
+
+	<xs:simpleType name="archiver">
+		<xs:restriction base="xs:token">
+			<xs:pattern value="(xz|lzma|bz2|gz)?"/>
+		</xs:restriction>
+	</xs:simpleType>
+
+	<xs:simpleType name="sha256">
+		<xs:restriction base="xs:token">
+			<xs:pattern value="[0-9a-fA-F]{64}"/>
+		</xs:restriction>
+	</xs:simpleType>
+
+	<xs:simpleType name="dependencyType">
+		<xs:restriction base="xs:token">
+			<xs:enumeration value="provide"/>
+			<xs:enumeration value="require"/>
+		</xs:restriction>
+	</xs:simpleType>
+
+	<xs:complexType name="tags">
+		<xs:sequence>
+			<xs:element name="tag" type="nonEmptyToken" minOccurs="0" maxOccurs="unbounded"/>
+		</xs:sequence>
+	</xs:complexType>
+
+	<xs:complexType name="version">
+		<xs:simpleContent>
+			<xs:extension base="nonEmptyToken">
+				<xs:attribute name="size" type="xs:nonNegativeInteger"/>
+				<xs:attribute name="archiver" type="archiver"/>
+				<xs:attribute name="sha256" type="sha256"/>
+				<xs:attribute name="manifest" type="xs:string"/>
+				<xs:anyAttribute namespace="##other" processContents="lax"/>
+			</xs:extension>
+		</xs:simpleContent>
+	</xs:complexType>
+
+	<xs:complexType name="versions">
+		<xs:sequence>
+			<xs:element name="version" type="version" minOccurs="0" maxOccurs="unbounded"/>
+		</xs:sequence>
+	</xs:complexType>
+
+	<xs:complexType name="image">
+		<xs:attribute name="url" type="xs:anyURI" use="required"/>
+	</xs:complexType>
+
+	<xs:complexType name="images">
+		<xs:choice minOccurs="0" maxOccurs="unbounded">
+			<xs:element name="icon" type="image"/>
+			<xs:element name="thumbnail" type="image"/>
+			<xs:element name="screenshot" type="image"/>
+		</xs:choice>
+	</xs:complexType>
+
+	<xs:complexType name="maintainer">
+		<xs:all>
+			<xs:element name="name" type="xs:string"/>
+			<xs:element name="email" type="xs:string"/>
+		</xs:all>
+	</xs:complexType>
+
+	<xs:complexType name="depend">
+		<xs:attribute name="type" type="dependencyType" use="required"/>
+		<xs:attribute name="thisVersion" type="nonEmptyToken" use="required"/>
+		<xs:attribute name="name" type="nonEmptyToken" use="required"/>
+		<xs:attribute name="version" type="nonEmptyToken" use="required"/>
+	</xs:complexType>
+
+	<xs:complexType name="depends">
+		<xs:sequence>
+			<xs:element name="depend" type="depend" minOccurs="0" maxOccurs="unbounded"/>
+		</xs:sequence>
+	</xs:complexType>
+
+	<xs:element name="package">
+		<xs:complexType>
+			<xs:choice minOccurs="0" maxOccurs="unbounded">
+				<xs:element name="name" type="xs:string"/>
+				<xs:element name="description" type="xs:string"/>
+				<xs:element name="long" type="xs:string"/>
+				<xs:element name="tags" type="tags"/>
+				<xs:element name="versions" type="versions"/>
+				<xs:element name="images" type="images"/>
+				<xs:element name="maintainer" type="maintainer"/>
+				<xs:element name="depends" type="depends"/>
+				<xs:any namespace="##other" processContents="lax"/>
+			</xs:choice>
+			<xs:attribute name="type" type="packageType" use="required"/>
+			<xs:attribute name="language" type="xs:token"/>
+			<xs:anyAttribute namespace="##other" processContents="lax"/>
+		</xs:complexType>
+	</xs:element>
+</xs:schema>
+)";
+
+	/** Collects the messages of the schema validator.
+	 */
+	class ErrorCollector : public QAbstractMessageHandler
+	{
+		QList<PackageSchema::Error> Errors_;
+	public:
+		const QList<PackageSchema::Error>& GetErrors () const
+		{
+			return Errors_;
+		}
+	protected:
+		void handleMessage (QtMsgType type, const QString& description,
+				const QUrl&, const QSourceLocation& location)
+		{
+			if (type == QtDebugMsg || type == QtWarningMsg)
+				return;
+
+			// The descriptions are XHTML fragments.
+			QString message = description;
+			message.remove (QRegularExpression ("<[^>]*>"));
+			message.replace ("&lt;", "<");
+			message.replace ("&gt;", ">");
+			message.replace ("&quot;", "\"");
+			message.replace ("&apos;", "'");
+			message.replace ("&amp;", "&");
+
+			const PackageSchema::Error error =
+			{
+				static_cast<int> (location.line ()),
+				static_cast<int> (location.column ()),
+				message.simplified ()
+			};
+			Errors_ << error;
+		}
+	};
+
+	const QXmlSchema& GetSchema ()
+	{
+		static QThreadStorage<QXmlSchema*> schemas;
+		if (!schemas.hasLocalData ())
+		{
+			LC_TRACE_SCOPE ("PackageSchema::Compile");
+
+			QXmlSchema *schema = new QXmlSchema;
+			if (!schema->load (PackageSchema::GetSource (), QUrl ("lcpackgen:package.xsd")))
+			{
+				delete schema;
+				throw std::runtime_error (PackageSchema::tr ("Could not compile the package schema.")
+						.toUtf8 ().constData ());
+			}
+			schemas.setLocalData (schema);
+		}
+		return *schemas.localData ();
+	}
+}
+
+QByteArray PackageSchema::GetSource ()
+{
+	return QByteArray::fromRawData (SchemaSource, sizeof (SchemaSource) - 1);
+}
+
+QList<PackageSchema::Error> PackageSchema::Validate (const QByteArray& document, const QUrl& uri)
+{
+	LC_TRACE_SCOPE ("PackageSchema::Validate");
+	LC_TRACE_COUNT (CXmlBytesParsed, document.size ());
+
+	ErrorCollector collector;
+	QXmlSchemaValidator validator (GetSchema ());
+	validator.setMessageHandler (&collector);
+	if (validator.validate (document, uri) || !collector.GetErrors ().isEmpty ())
+		return collector.GetErrors ();
+
+	// Shouldn't happen, but the document is invalid anyway.
+	const Error error = { 0, 0, tr ("The document is not valid.") };
+	return QList<Error> () << error;
+}
+
+QString PackageSchema::ToString (const Error& error)
+{
+	return QString ("%1:%2: %3")
+			.arg (error.Line_)
+			.arg (error.Column_)
+			.arg (error.Message_);
+}
@@ -0,0 +1,62 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGESCHEMA_H
+#define PACKAGESCHEMA_H
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+/** The XML Schema of package descriptions.
+ *
+ * The schema is compiled lazily, once per thread, since compiled
+ * QXmlSchema objects can't be used by several validators at once.
+ * After that each document costs a single validating pass, so
+ * checking a whole batch of descriptions on a thread pool costs a
+ * handful of compilations, whatever the number of descriptions.
+ */
+class PackageSchema
+{
+	Q_DECLARE_TR_FUNCTIONS (PackageSchema)
+public:
+	struct Error
+	{
+		int Line_;
+		int Column_;
+		QString Message_;
+	};
+
+	/** Returns the source of the schema.
+	 */
+	static QByteArray GetSource ();
+
+	/** Validates the given package description against the schema,
+	 * returning all the problems found, with their positions, or an
+	 * empty list if the description is valid. The uri is only used
+	 * in the messages. This function is thread-safe.
+	 */
+	static QList<Error> Validate (const QByteArray& document, const QUrl& uri);
+
+	/** Formats the error as LINE:COLUMN: MESSAGE.
+	 */
+	static QString ToString (const Error&);
+};
+
+#endif
@@ -0,0 +1,472 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packagesnapshot.h"
+#include <cstring>
+#include <stdexcept>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+#include "tracing.h"
+
+namespace
+{
+	const quint32 SnapshotMagic = 0x4c50534e;
+	const quint32 SnapshotVersion = 3;
+	const int HashSize = 20;
+	const qint64 ChunkSize = 256 * 1024;
+
+	struct ArrayRef
+	{
+		quint32 Offset_;
+		quint32 Count_;
+	};
+
+	struct StringRef
+	{
+		quint32 Offset_;
+		quint32 Length_;
+	};
+
+	// Everything is stored in the host byte order, the magic
+	// number doubles as the byte order mark.
+	struct Header
+	{
+		quint32 Magic_;
+		quint32 Version_;
+		qint64 XmlSize_;
+		qint64 XmlMTime_;
+		char XmlHash_ [HashSize];
+		ArrayRef Strings_;
+		quint32 Fields_ [PackageSnapshot::SFCount];
+		ArrayRef Lists_ [PackageSnapshot::SLCount];
+
+		// Four string IDs per dependency: this version, type, name
+		// and version.
+		ArrayRef Depends_;
+	};
+
+	const Header* GetHeader (const uchar *data)
+	{
+		return reinterpret_cast<const Header*> (data);
+	}
+
+	const quint32* GetIds (const uchar *data, const ArrayRef& ref)
+	{
+		return reinterpret_cast<const quint32*> (data + ref.Offset_);
+	}
+
+	struct SourceInfo
+	{
+		qint64 Size_;
+		qint64 MTime_;
+	};
+
+	SourceInfo GetSourceInfo (const QString& path)
+	{
+		LC_TRACE_COUNT (CFilesystemProbes, 1);
+		const QFileInfo fi (path);
+		const SourceInfo info = { fi.size (), fi.lastModified ().toMSecsSinceEpoch () };
+		return info;
+	}
+
+	QByteArray HashSource (const QString& path)
+	{
+		QFile file (path);
+		if (!file.open (QIODevice::ReadOnly))
+			return QByteArray ();
+		return QCryptographicHash::hash (file.readAll (), QCryptographicHash::Sha1);
+	}
+
+	class Builder
+	{
+		QByteArray Data_;
+		QHash<QString, quint32> Ids_;
+		QList<QString> Strings_;
+		Header Header_;
+	public:
+		Builder (const SourceInfo& info, const QByteArray& hash)
+		{
+			std::memset (&Header_, 0, sizeof (Header_));
+			Header_.Magic_ = SnapshotMagic;
+			Header_.Version_ = SnapshotVersion;
+			Header_.XmlSize_ = info.Size_;
+			Header_.XmlMTime_ = info.MTime_;
+			std::memcpy (Header_.XmlHash_, hash.constData (), HashSize);
+
+			Data_.resize (sizeof (Header));
+		}
+
+		void SetField (PackageSnapshot::Field field, const QString& str)
+		{
+			Header_.Fields_ [field] = Intern (str);
+		}
+
+		void SetList (PackageSnapshot::List list, const QStringList& strs)
+		{
+			QVector<quint32> ids;
+			Q_FOREACH (const QString& str, strs)
+				ids << Intern (str);
+			Header_.Lists_ [list] = AppendIds (ids, strs.size ());
+		}
+
+		void SetDepends (const QList<Dependency>& deps)
+		{
+			QVector<quint32> ids;
+			Q_FOREACH (const Dependency& dep, deps)
+				ids << Intern (dep.ThisVersion_)
+						<< Intern (dep.Type_)
+						<< Intern (dep.Name_)
+						<< Intern (dep.Version_);
+			Header_.Depends_ = AppendIds (ids, deps.size ());
+		}
+
+		QByteArray Finish ()
+		{
+			QVector<StringRef> refs;
+			QByteArray chars;
+			const quint32 charsOffset = Data_.size () + Strings_.size () * sizeof (StringRef);
+			Q_FOREACH (const QString& str, Strings_)
+			{
+				const StringRef ref =
+				{
+					static_cast<quint32> (charsOffset + chars.size ()),
+					static_cast<quint32> (str.size ())
+				};
+				refs << ref;
+				chars.append (reinterpret_cast<const char*> (str.utf16 ()), str.size () * 2);
+			}
+
+			Header_.Strings_.Offset_ = Data_.size ();
+			Header_.Strings_.Count_ = refs.size ();
+			Data_.append (reinterpret_cast<const char*> (refs.constData ()),
+					refs.size () * sizeof (StringRef));
+			Data_.append (chars);
+
+			std::memcpy (Data_.data (), &Header_, sizeof (Header_));
+			return Data_;
+		}
+	private:
+		quint32 Intern (const QString& str)
+		{
+			QHash<QString, quint32>::const_iterator pos = Ids_.constFind (str);
+			if (pos == Ids_.constEnd ())
+			{
+				pos = Ids_.insert (str, Strings_.size ());
+				Strings_ << str;
+			}
+			return *pos;
+		}
+
+		ArrayRef AppendIds (const QVector<quint32>& ids, int count)
+		{
+			const ArrayRef ref = { static_cast<quint32> (Data_.size ()), static_cast<quint32> (count) };
+			Data_.append (reinterpret_cast<const char*> (ids.constData ()), ids.size () * sizeof (quint32));
+			return ref;
+		}
+	};
+
+	void WriteSnapshot (const QString& path, const SourceInfo& info,
+			const QByteArray& hash, const PackageData& data, const QStringList& warnings)
+	{
+		Builder builder (info, hash);
+		builder.SetField (PackageSnapshot::SFType, data.Type_);
+		builder.SetField (PackageSnapshot::SFLanguage, data.Language_);
+		builder.SetField (PackageSnapshot::SFName, data.Name_);
+		builder.SetField (PackageSnapshot::SFDescription, data.Description_);
+		builder.SetField (PackageSnapshot::SFLongDescription, data.LongDescription_);
+		builder.SetField (PackageSnapshot::SFMaintName, data.MaintName_);
+		builder.SetField (PackageSnapshot::SFMaintEmail, data.MaintEmail_);
+		builder.SetField (PackageSnapshot::SFIcon, data.Icon_);
+		builder.SetList (PackageSnapshot::SLTags, data.Tags_);
+		builder.SetList (PackageSnapshot::SLThumbnails, data.Thumbnails_);
+		builder.SetList (PackageSnapshot::SLScreenshots, data.Screenshots_);
+		builder.SetList (PackageSnapshot::SLVersions, data.Versions_);
+		builder.SetList (PackageSnapshot::SLWarnings, warnings);
+		builder.SetDepends (data.Depends_);
+		const QByteArray& contents = builder.Finish ();
+
+		// The snapshot is just an optimization, so failing to write
+		// it is not an error.
+		if (path.isEmpty () || !QDir ().mkpath (QFileInfo (path).path ()))
+			return;
+
+		QSaveFile file (path);
+		if (file.open (QIODevice::WriteOnly))
+		{
+			file.write (contents);
+			file.commit ();
+		}
+	}
+}
+
+PackageSnapshot::PackageSnapshot (const QString& xmlFileName)
+: File_ (GetSnapshotPath (xmlFileName))
+, Data_ (0)
+, Size_ (0)
+{
+	if (!File_.open (QIODevice::ReadOnly))
+		return;
+
+	Size_ = File_.size ();
+	if (Size_ < static_cast<qint64> (sizeof (Header)))
+		return;
+
+	Data_ = File_.map (0, Size_);
+	if (!Data_)
+		return;
+
+	if (!CheckLayout () || !CheckSource (xmlFileName))
+	{
+		File_.unmap (const_cast<uchar*> (Data_));
+		Data_ = 0;
+	}
+}
+
+PackageSnapshot::~PackageSnapshot ()
+{
+	if (Data_)
+		File_.unmap (const_cast<uchar*> (Data_));
+}
+
+bool PackageSnapshot::IsValid () const
+{
+	return Data_;
+}
+
+QString PackageSnapshot::GetField (Field field) const
+{
+	return GetString (GetHeader (Data_)->Fields_ [field]);
+}
+
+int PackageSnapshot::GetCount (List list) const
+{
+	return GetHeader (Data_)->Lists_ [list].Count_;
+}
+
+QString PackageSnapshot::GetItem (List list, int i) const
+{
+	return GetString (GetIds (Data_, GetHeader (Data_)->Lists_ [list]) [i]);
+}
+
+int PackageSnapshot::GetDependsCount () const
+{
+	return GetHeader (Data_)->Depends_.Count_;
+}
+
+Dependency PackageSnapshot::GetDependency (int i) const
+{
+	const quint32 *ids = GetIds (Data_, GetHeader (Data_)->Depends_) + i * 4;
+
+	Dependency dep;
+	dep.ThisVersion_ = GetString (ids [0]);
+	dep.Type_ = GetString (ids [1]);
+	dep.Name_ = GetString (ids [2]);
+	dep.Version_ = GetString (ids [3]);
+	return dep;
+}
+
+PackageData PackageSnapshot::ToPackageData () const
+{
+	// Copying a QString would keep pointing into the mapping.
+	auto copy = [] (const QString& str) { return QString (str.constData (), str.size ()); };
+
+	PackageData data;
+	data.Type_ = copy (GetField (SFType));
+	data.Language_ = copy (GetField (SFLanguage));
+	data.Name_ = copy (GetField (SFName));
+	data.Description_ = copy (GetField (SFDescription));
+	data.LongDescription_ = copy (GetField (SFLongDescription));
+	data.MaintName_ = copy (GetField (SFMaintName));
+	data.MaintEmail_ = copy (GetField (SFMaintEmail));
+	data.Icon_ = copy (GetField (SFIcon));
+
+	QStringList *lists [] = { &data.Tags_, &data.Thumbnails_, &data.Screenshots_, &data.Versions_ };
+	for (int list = SLTags; list <= SLVersions; ++list)
+		for (int i = 0, count = GetCount (static_cast<List> (list)); i < count; ++i)
+			*lists [list] << copy (GetItem (static_cast<List> (list), i));
+
+	for (int i = 0, count = GetDependsCount (); i < count; ++i)
+	{
+		const Dependency& mapped = GetDependency (i);
+
+		Dependency dep;
+		dep.ThisVersion_ = copy (mapped.ThisVersion_);
+		dep.Type_ = copy (mapped.Type_);
+		dep.Name_ = copy (mapped.Name_);
+		dep.Version_ = copy (mapped.Version_);
+		data.Depends_ << dep;
+	}
+
+	return data;
+}
+
+QString PackageSnapshot::GetSnapshotPath (const QString& xmlFileName)
+{
+	const QString& cacheDir = QStandardPaths::writableLocation (QStandardPaths::CacheLocation);
+	if (cacheDir.isEmpty ())
+		return QString ();
+
+	const QByteArray& key = QCryptographicHash::hash (QFileInfo (xmlFileName)
+				.absoluteFilePath ().toUtf8 (), QCryptographicHash::Sha1).toHex ();
+	return cacheDir + "/snapshots/" + QString::fromLatin1 (key) + ".snapshot";
+}
+
+PackageData PackageSnapshot::Load (const QString& xmlFileName,
+		QStringList& warnings, const PackageLoader::ProgressHandler_t& progress)
+{
+	LC_TRACE_SCOPE ("PackageSnapshot::Load");
+
+	{
+		const PackageSnapshot snapshot (xmlFileName);
+		if (snapshot.IsValid ())
+		{
+			for (int i = 0, count = snapshot.GetCount (SLWarnings); i < count; ++i)
+			{
+				const QString& warning = snapshot.GetItem (SLWarnings, i);
+				warnings << QString (warning.constData (), warning.size ());
+			}
+			return snapshot.ToPackageData ();
+		}
+	}
+
+	// Take the file's identity before parsing it, so that if it
+	// changes in between, the snapshot is just seen as stale later.
+	const SourceInfo& info = GetSourceInfo (xmlFileName);
+
+	QFile file (xmlFileName);
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (PackageLoader::tr ("Unable to open file %1 for reading.")
+				.arg (xmlFileName)
+				.toUtf8 ().constData ());
+
+	// Read the description once, and both hash and parse that copy.
+	// Reading is what takes time on a slow share, so it is done in
+	// chunks reporting the progress, and parsing the copy in memory
+	// only checks for the cancellation.
+	const qint64 size = file.size ();
+	QByteArray contents;
+	contents.reserve (static_cast<int> (size));
+	QCryptographicHash hasher (QCryptographicHash::Sha1);
+	while (!file.atEnd ())
+	{
+		const QByteArray& chunk = file.read (ChunkSize);
+		if (chunk.isEmpty ())
+			break;
+
+		hasher.addData (chunk);
+		contents += chunk;
+
+		if (progress && !progress (contents.size (), size))
+			throw std::runtime_error (PackageLoader::tr ("Loading has been cancelled.")
+					.toUtf8 ().constData ());
+	}
+	file.close ();
+	const QByteArray& hash = hasher.result ();
+
+	QBuffer buffer (&contents);
+	buffer.open (QIODevice::ReadOnly);
+
+	PackageLoader::ProgressHandler_t parseProgress;
+	if (progress)
+		parseProgress = [&progress, size] (qint64, qint64) { return progress (size, size); };
+
+	QStringList newWarnings;
+	const PackageData& data = PackageLoader::Load (&buffer, newWarnings, parseProgress);
+	WriteSnapshot (GetSnapshotPath (xmlFileName), info, hash, data, newWarnings);
+
+	warnings += newWarnings;
+	return data;
+}
+
+QString PackageSnapshot::GetString (quint32 id) const
+{
+	const StringRef& ref = reinterpret_cast<const StringRef*> (Data_ +
+			GetHeader (Data_)->Strings_.Offset_) [id];
+	return QString::fromRawData (reinterpret_cast<const QChar*> (Data_ + ref.Offset_), ref.Length_);
+}
+
+bool PackageSnapshot::CheckLayout () const
+{
+	const Header *header = GetHeader (Data_);
+	if (header->Magic_ != SnapshotMagic ||
+			header->Version_ != SnapshotVersion)
+		return false;
+
+	const quint64 size = Size_;
+	auto fits = [size] (const ArrayRef& ref, quint64 itemSize)
+		{
+			return !(ref.Offset_ % 4) &&
+					ref.Offset_ + ref.Count_ * itemSize <= size;
+		};
+
+	if (!fits (header->Strings_, sizeof (StringRef)))
+		return false;
+
+	const quint32 stringCount = header->Strings_.Count_;
+	const StringRef *strings = reinterpret_cast<const StringRef*> (Data_ + header->Strings_.Offset_);
+	for (quint32 i = 0; i < stringCount; ++i)
+		if (strings [i].Offset_ % 2 ||
+				strings [i].Offset_ + static_cast<quint64> (strings [i].Length_) * 2 > size)
+			return false;
+
+	auto idsValid = [this, &fits, stringCount] (const ArrayRef& ref, quint32 perItem)
+		{
+			if (!fits (ref, perItem * sizeof (quint32)))
+				return false;
+
+			const quint32 *ids = GetIds (Data_, ref);
+			for (quint32 i = 0; i < ref.Count_ * perItem; ++i)
+				if (ids [i] >= stringCount)
+					return false;
+			return true;
+		};
+
+	for (int field = 0; field < SFCount; ++field)
+		if (header->Fields_ [field] >= stringCount)
+			return false;
+
+	for (int list = 0; list < SLCount; ++list)
+		if (!idsValid (header->Lists_ [list], 1))
+			return false;
+
+	return idsValid (header->Depends_, 4);
+}
+
+bool PackageSnapshot::CheckSource (const QString& xmlFileName) const
+{
+	const Header *header = GetHeader (Data_);
+
+	const SourceInfo& info = GetSourceInfo (xmlFileName);
+	if (info.Size_ != header->XmlSize_)
+		return false;
+
+	if (info.MTime_ == header->XmlMTime_)
+		return true;
+
+	// The file has been touched, but its contents may be the same.
+	const QByteArray& hash = HashSource (xmlFileName);
+	return hash.size () == HashSize &&
+			!std::memcmp (hash.constData (), header->XmlHash_, HashSize);
+}
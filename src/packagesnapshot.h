@@ -0,0 +1,122 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGESNAPSHOT_H
+#define PACKAGESNAPSHOT_H
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include "packagedata.h"
+#include "packageloader.h"
+
+/** Binary snapshot of a parsed package description.
+ *
+ * The snapshot lives in the user's cache directory, under a name
+ * derived from the absolute path of the description, so that
+ * read-only operations never write into package directories. It is
+ * memory-mapped when opened, and consists of a fixed header, a table
+ * of interned UTF-16 strings and arrays of string IDs for the lists
+ * and the dependencies, all addressed by offsets from the beginning
+ * of the file, so nothing has to be parsed or allocated to read it:
+ * the strings returned by the accessors point right into the mapping,
+ * and stay valid only as long as the snapshot object is alive.
+ *
+ * The header records the size, mtime and SHA-1 of the description it
+ * was made from. The snapshot is used if the size and mtime still
+ * match, or if they don't but the contents hash still does.
+ */
+class PackageSnapshot
+{
+	Q_DECLARE_TR_FUNCTIONS (PackageSnapshot)
+public:
+	enum Field
+	{
+		SFType,
+		SFLanguage,
+		SFName,
+		SFDescription,
+		SFLongDescription,
+		SFMaintName,
+		SFMaintEmail,
+		SFIcon,
+		SFCount
+	};
+
+	enum List
+	{
+		SLTags,
+		SLThumbnails,
+		SLScreenshots,
+		SLVersions,
+		SLWarnings,
+		SLCount
+	};
+private:
+	QFile File_;
+	const uchar *Data_;
+	qint64 Size_;
+public:
+	/** Maps the snapshot of the given package description. If there
+	 * is no snapshot, or it is corrupted or out of date, the object
+	 * is invalid.
+	 */
+	explicit PackageSnapshot (const QString& xmlFileName);
+	~PackageSnapshot ();
+
+	PackageSnapshot (const PackageSnapshot&) = delete;
+	PackageSnapshot& operator= (const PackageSnapshot&) = delete;
+
+	bool IsValid () const;
+
+	QString GetField (Field) const;
+	int GetCount (List) const;
+	QString GetItem (List, int) const;
+	int GetDependsCount () const;
+	Dependency GetDependency (int) const;
+
+	/** Returns a deep copy of the snapshot contents, which outlives
+	 * the snapshot object.
+	 */
+	PackageData ToPackageData () const;
+
+	/** Returns the path of the snapshot of the given description in
+	 * the cache directory, or a null string if there is no cache
+	 * directory.
+	 */
+	static QString GetSnapshotPath (const QString& xmlFileName);
+
+	/** Parses the package description like PackageLoader::Load()
+	 * does, but uses its snapshot if there is an up to date one, and
+	 * (re)creates the snapshot otherwise.
+	 *
+	 * The progress is reported while the file is read, and the
+	 * cancellation is checked while it is parsed as well.
+	 *
+	 * Failing to write the snapshot is not an error. This function
+	 * is reentrant.
+	 */
+	static PackageData Load (const QString& xmlFileName, QStringList& warnings,
+			const PackageLoader::ProgressHandler_t& progress = PackageLoader::ProgressHandler_t ());
+private:
+	QString GetString (quint32) const;
+	QStringList GetList (List) const;
+	bool CheckLayout () const;
+	bool CheckSource (const QString& xmlFileName) const;
+};
+
+#endif
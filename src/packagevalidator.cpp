@@ -0,0 +1,143 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packagevalidator.h"
+#include <QLocale>
+#include "packagedata.h"
+#include "archiveinfo.h"
+#include "tracing.h"
+
+PackageValidator::PackageValidator ()
+{
+	AddRule (FName, &PackageValidator::CheckName);
+	AddRule (FDescription, &PackageValidator::CheckDescription);
+	AddRule (FTags, &PackageValidator::CheckTags);
+	AddRule (FMaintName, &PackageValidator::CheckMaintName);
+	AddRule (FMaintEmail, &PackageValidator::CheckMaintEmail);
+	AddRule (FType | FLanguage, &PackageValidator::CheckLanguage);
+	AddRule (FVersions, &PackageValidator::CheckVersions);
+	AddRule (FName | FVersions | FArchives,
+			&PackageValidator::CheckArchives);
+}
+
+void PackageValidator::Invalidate (Fields fields)
+{
+	for (int i = 0; i < Rules_.size (); ++i)
+		if (Rules_ [i].Deps_ & fields)
+			Rules_ [i].Dirty_ = true;
+}
+
+QStringList PackageValidator::Validate (const PackageData& data, const ArchiveIndex& index)
+{
+	LC_TRACE_SCOPE ("PackageValidator::Validate");
+
+	QStringList reasons;
+	for (int i = 0; i < Rules_.size (); ++i)
+	{
+		Rule& rule = Rules_ [i];
+		if (rule.Dirty_)
+		{
+			rule.Cached_ = (this->*rule.Checker_) (data, index);
+			LC_TRACE_COUNT (CRulesEvaluated, 1);
+			rule.Dirty_ = false;
+		}
+		reasons += rule.Cached_;
+	}
+	return reasons;
+}
+
+void PackageValidator::AddRule (Fields deps, Checker_t checker)
+{
+	const Rule rule = { deps, checker, true, QStringList () };
+	Rules_ << rule;
+}
+
+QStringList PackageValidator::CheckName (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.Name_.isEmpty ())
+		return QStringList (tr ("<em>Name</em> is empty."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckDescription (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.Description_.isEmpty ())
+		return QStringList (tr ("<em>Description</em> is empty."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckTags (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.Tags_.isEmpty ())
+		return QStringList (tr ("<em>Tags</em> are empty."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckMaintName (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.MaintName_.isEmpty ())
+		return QStringList (tr ("<em>Maintainer name</em> is empty."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckMaintEmail (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.MaintEmail_.isEmpty ())
+		return QStringList (tr ("<em>Maintainer email</em> is empty."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckLanguage (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.Type_ == "translation" &&
+			QLocale (data.Language_).language () == QLocale::C)
+		return QStringList (tr ("<em>Language</em> has unkown language code %1.")
+				.arg (data.Language_));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckVersions (const PackageData& data, const ArchiveIndex&)
+{
+	if (data.Versions_.isEmpty ())
+		return QStringList (tr ("No versions are defined."));
+	return QStringList ();
+}
+
+QStringList PackageValidator::CheckArchives (const PackageData& data, const ArchiveIndex& index)
+{
+	if (index.IsNull ())
+		return QStringList ();
+
+	if (!index.Exists ())
+		return QStringList (tr ("No <em>arch</em> subdirectory in package description directory."));
+
+	const QString& normalized = data.GetNormalizedName ();
+
+	QStringList reasons;
+	Q_FOREACH (const QString& version, data.Versions_)
+	{
+		const VersionArchive& archive = index.Find (normalized, version);
+		if (archive.Archiver_.isEmpty ())
+			reasons << tr ("No archiver for version <em>%1</em>").arg (version);
+		else if (!archive.Corruption_.isEmpty ())
+			reasons << tr ("Archive for version <em>%1</em> is corrupted: %2")
+					.arg (version)
+					.arg (archive.Corruption_.toHtmlEscaped ());
+	}
+	return reasons;
+}
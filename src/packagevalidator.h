@@ -0,0 +1,96 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGEVALIDATOR_H
+#define PACKAGEVALIDATOR_H
+#include <QCoreApplication>
+#include <QStringList>
+#include <QVector>
+
+struct PackageData;
+class ArchiveIndex;
+
+/** Checks a package description against a set of independent rules.
+ *
+ * Each rule declares the fields it depends on, and its result is
+ * cached until one of those fields is invalidated, so that editing a
+ * single field re-runs only the rules that look at it.
+ */
+class PackageValidator
+{
+	Q_DECLARE_TR_FUNCTIONS (PackageValidator)
+public:
+	enum Field
+	{
+		FName = 1 << 0,
+		FDescription = 1 << 1,
+		FLongDescription = 1 << 2,
+		FTags = 1 << 3,
+		FMaintName = 1 << 4,
+		FMaintEmail = 1 << 5,
+		FType = 1 << 6,
+		FLanguage = 1 << 7,
+		FImages = 1 << 8,
+		FVersions = 1 << 9,
+		FDepends = 1 << 10,
+		FArchives = 1 << 11,
+		FAll = 0xffff
+	};
+	Q_DECLARE_FLAGS (Fields, Field)
+private:
+	typedef QStringList (PackageValidator::*Checker_t) (const PackageData&, const ArchiveIndex&);
+
+	struct Rule
+	{
+		Fields Deps_;
+		Checker_t Checker_;
+		bool Dirty_;
+		QStringList Cached_;
+	};
+	QVector<Rule> Rules_;
+public:
+	PackageValidator ();
+
+	/** Marks the rules depending on any of the given fields as
+	 * needing to be re-run on the next Validate() call.
+	 */
+	void Invalidate (Fields);
+
+	/** Returns the list of human-readable reasons why the package
+	 * is invalid, or an empty list if it is valid.
+	 *
+	 * If the archive index is not null, the archives for all the
+	 * versions are looked up in it as well.
+	 */
+	QStringList Validate (const PackageData&, const ArchiveIndex&);
+private:
+	void AddRule (Fields, Checker_t);
+
+	QStringList CheckName (const PackageData&, const ArchiveIndex&);
+	QStringList CheckDescription (const PackageData&, const ArchiveIndex&);
+	QStringList CheckTags (const PackageData&, const ArchiveIndex&);
+	QStringList CheckMaintName (const PackageData&, const ArchiveIndex&);
+	QStringList CheckMaintEmail (const PackageData&, const ArchiveIndex&);
+	QStringList CheckLanguage (const PackageData&, const ArchiveIndex&);
+	QStringList CheckVersions (const PackageData&, const ArchiveIndex&);
+	QStringList CheckArchives (const PackageData&, const ArchiveIndex&);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS (PackageValidator::Fields)
+
+#endif
@@ -0,0 +1,237 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packagewatcher.h"
+#include <stdexcept>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include "packagedata.h"
+#include "packagesnapshot.h"
+#include "packagewriter.h"
+#include "archiveinfo.h"
+#include "repositoryindexer.h"
+#include "tracing.h"
+
+namespace
+{
+	void AddEntry (QCryptographicHash& hash, const QFileInfo& fi)
+	{
+		hash.addData (fi.fileName ().toUtf8 ());
+		hash.addData (QByteArray::number (fi.size ()) + ' ' +
+				QByteArray::number (fi.lastModified ().toMSecsSinceEpoch ()) + '\n');
+	}
+
+	/** Digests the descriptions of a package directory and the
+	 * archives in its arch/ subdirectory, leaving out everything
+	 * else, like the precompressed copies, the checksums and the
+	 * caches we write there ourselves.
+	 */
+	QByteArray GetDirState (const QString& dir)
+	{
+		QCryptographicHash hash (QCryptographicHash::Sha1);
+		Q_FOREACH (const QFileInfo& fi,
+				QDir (dir).entryInfoList (QStringList ("*.xml"), QDir::Files, QDir::Name))
+			AddEntry (hash, fi);
+
+		hash.addData ("arch\n");
+		QStringList archives;
+		Q_FOREACH (const QString& archiver, ArchiveIndex::GetKnownArchivers ())
+			archives << "*.tar." + archiver;
+		Q_FOREACH (const QFileInfo& fi,
+				QDir (QDir (dir).filePath ("arch")).entryInfoList (archives, QDir::Files, QDir::Name))
+			AddEntry (hash, fi);
+
+		return hash.result ();
+	}
+}
+
+PackageWatcher::PackageWatcher (const QString& root, int debounceMs, bool checksums, QObject *parent)
+: QObject (parent)
+, Root_ (QDir (root).absolutePath ())
+, Checksums_ (checksums)
+, Watcher_ (new QFileSystemWatcher (this))
+, Timer_ (new QTimer (this))
+{
+	Timer_->setSingleShot (true);
+	Timer_->setInterval (debounceMs);
+	connect (Timer_,
+			SIGNAL (timeout ()),
+			this,
+			SLOT (processDirty ()));
+	connect (Watcher_,
+			SIGNAL (directoryChanged (const QString&)),
+			this,
+			SLOT (handleDirectoryChanged (const QString&)));
+}
+
+void PackageWatcher::Start ()
+{
+	// New package directories appearing right in the root are picked
+	// up, deeper hierarchies need a restart. The ones that have no
+	// description yet are watched until they get one.
+	Watcher_->addPath (Root_);
+	Q_FOREACH (const QString& name, QDir (Root_).entryList (QDir::Dirs | QDir::NoDotAndDotDot))
+		AddPackageDir (QDir (Root_).filePath (name));
+
+	Q_FOREACH (const QString& descriptor, RepositoryIndexer::FindDescriptors (Root_))
+		AddPackageDir (QFileInfo (descriptor).absolutePath ());
+
+	Q_FOREACH (const QString& dir, Packages_.keys ())
+		ProcessPackageDir (dir);
+}
+
+void PackageWatcher::AddPackageDir (const QString& dir)
+{
+	if (dir == Root_)
+		return;
+
+	QStringList descriptors;
+	Q_FOREACH (const QString& name, QDir (dir).entryList (QStringList ("*.xml"), QDir::Files, QDir::Name))
+		descriptors << QDir (dir).filePath (name);
+
+	// The directory is watched even without descriptions, so that
+	// we notice when one is added.
+	const QStringList& watched = Watcher_->directories ();
+	if (!watched.contains (dir))
+		Watcher_->addPath (dir);
+
+	if (descriptors.isEmpty ())
+	{
+		Packages_.remove (dir);
+		States_.remove (dir);
+		return;
+	}
+
+	Packages_ [dir] = descriptors;
+
+	const QString& archDir = QDir (dir).filePath ("arch");
+	if (QFileInfo (archDir).isDir () && !watched.contains (archDir))
+		Watcher_->addPath (archDir);
+}
+
+void PackageWatcher::ProcessPackageDir (const QString& dir)
+{
+	LC_TRACE_SCOPE ("PackageWatcher::ProcessPackageDir");
+
+	const QStringList& descriptors = Packages_.value (dir);
+	if (descriptors.isEmpty ())
+		return;
+
+	ArchiveIndex index (QDir (dir).filePath ("arch"));
+	if (!index.Exists ())
+		return;
+
+	Q_FOREACH (const QString& descriptor, descriptors)
+	{
+		try
+		{
+			QStringList warnings;
+			const PackageData& data = PackageSnapshot::Load (descriptor, warnings);
+			const QString& normalizedName = data.GetNormalizedName ();
+
+			QStringList newVersions;
+			Q_FOREACH (const QString& version, index.GetVersions (normalizedName))
+				if (!data.Versions_.contains (version))
+					newVersions << version;
+
+			// Checksums of the archives that have changed are dropped
+			// unless they are computed here.
+			if (Checksums_)
+				index.ComputeChecksums (normalizedName, data.Versions_ + newVersions);
+
+			if (PackageWriter::UpdateArchives (descriptor, normalizedName, index, newVersions))
+				emit descriptionUpdated (descriptor, newVersions);
+		}
+		catch (const std::exception& e)
+		{
+			emit error (descriptor, QString::fromUtf8 (e.what ()));
+		}
+	}
+
+	// Taken after our own writes, so that they don't trigger another
+	// pass.
+	States_ [dir] = GetDirState (dir);
+}
+
+void PackageWatcher::handleDirectoryChanged (const QString& path)
+{
+	// Archives land in arch/, descriptions and arch/ itself appear
+	// in the package directory, and packages appear in the root.
+	const QFileInfo fi (path);
+	if (path == Root_)
+	{
+		Q_FOREACH (const QString& name, QDir (Root_).entryList (QDir::Dirs | QDir::NoDotAndDotDot))
+		{
+			const QString& dir = QDir (Root_).filePath (name);
+			if (!Packages_.contains (dir))
+				Dirty_ << dir;
+		}
+	}
+	else if (fi.fileName () == "arch")
+		Dirty_ << fi.absolutePath ();
+	else
+		Dirty_ << path;
+
+	Timer_->start ();
+}
+
+void PackageWatcher::processDirty ()
+{
+	const QSet<QString> dirty = Dirty_;
+	Dirty_.clear ();
+
+	Q_FOREACH (const QString& dir, dirty)
+	{
+		if (!QFileInfo (dir).isDir ())
+		{
+			Packages_.remove (dir);
+			States_.remove (dir);
+			Settling_.remove (dir);
+			continue;
+		}
+
+		AddPackageDir (dir);
+
+		const QByteArray& current = GetDirState (dir);
+		const QHash<QString, QByteArray>::const_iterator state = States_.find (dir);
+		if (state != States_.end () && *state == current)
+		{
+			Settling_.remove (dir);
+			continue;
+		}
+
+		// Some archive may still be being written, so the directory is
+		// looked at again after another interval.
+		if (Settling_.value (dir) != current)
+		{
+			Settling_ [dir] = current;
+			Dirty_ << dir;
+			continue;
+		}
+
+		Settling_.remove (dir);
+		ProcessPackageDir (dir);
+	}
+
+	if (!Dirty_.isEmpty ())
+		Timer_->start ();
+}
@@ -0,0 +1,97 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGEWATCHER_H
+#define PACKAGEWATCHER_H
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+/** Keeps the package descriptions of a repository in sync with their
+ * arch/ directories.
+ *
+ * Package directories and their arch/ subdirectories are watched, and
+ * bursts of changes are coalesced, so that a whole batch of archives
+ * dropped at once results in a single pass over the affected packages.
+ * Each pass lists the arch/ directory of a package once and only
+ * patches the <version> elements of its descriptions: the sizes and
+ * archivers of the existing versions are refreshed and the versions
+ * having new archives are added.
+ *
+ * Each pass writes into the directories it watches, so a digest of
+ * what it has read, the descriptions and the archives, is kept for
+ * each package, and the changes leaving it intact, like our own
+ * writes, are ignored.
+ *
+ * Archives being copied into arch/ don't produce any events while they
+ * grow, so a package is only processed once its digest has stayed the
+ * same for a whole debounce interval.
+ *
+ * Only the paths of the descriptions and these digests are kept
+ * between passes, so memory usage stays small even for large
+ * repositories.
+ */
+class PackageWatcher : public QObject
+{
+	Q_OBJECT
+
+	const QString Root_;
+	const bool Checksums_;
+	QFileSystemWatcher * const Watcher_;
+	QTimer * const Timer_;
+
+	/** Descriptions by package directory.
+	 */
+	QHash<QString, QStringList> Packages_;
+
+	/** Digests of the package directories as of their last pass.
+	 */
+	QHash<QString, QByteArray> States_;
+
+	/** Digests of the dirty package directories as of the last time
+	 * they have been looked at, for those that were still changing.
+	 */
+	QHash<QString, QByteArray> Settling_;
+	QSet<QString> Dirty_;
+public:
+	/** The changes are processed debounceMs milliseconds after the
+	 * last one. If checksums is set, the checksums of the versions
+	 * are recorded and kept up to date as well.
+	 */
+	PackageWatcher (const QString& root, int debounceMs, bool checksums, QObject *parent = 0);
+
+	/** Brings all the packages in the repository up to date once and
+	 * starts watching them.
+	 */
+	void Start ();
+private:
+	void AddPackageDir (const QString& dir);
+	void ProcessPackageDir (const QString& dir);
+private slots:
+	void handleDirectoryChanged (const QString&);
+	void processDirty ();
+signals:
+	void descriptionUpdated (const QString& fileName, const QStringList& newVersions);
+	void error (const QString& fileName, const QString& message);
+};
+
+#endif
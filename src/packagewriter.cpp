@@ -0,0 +1,861 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "packagewriter.h"
+#include <stdexcept>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include "packagedata.h"
+#include "packageloader.h"
+#include "archiveinfo.h"
+#include "precompressor.h"
+#include "tracing.h"
+
+namespace
+{
+	void WriteFile (const QString& fileName, const QByteArray& contents)
+	{
+		QSaveFile outFile (fileName);
+		if (!outFile.open (QIODevice::WriteOnly))
+			throw std::runtime_error (PackageWriter::tr ("Could not open file %1 for writing. File is not saved.")
+					.arg (fileName)
+					.toUtf8 ().constData ());
+
+		if (outFile.write (contents) != contents.size () ||
+				!outFile.commit ())
+			throw std::runtime_error (PackageWriter::tr ("Could not write file %1: %2. File is not saved.")
+					.arg (fileName)
+					.arg (outFile.errorString ())
+					.toUtf8 ().constData ());
+
+		Precompressor::Refresh (fileName, contents);
+	}
+
+	/** Updates the attributes of a version to match its archive: the
+	 * size and the archiver are set, and added if they are missing,
+	 * and so are the checksum and the manifest if they have been
+	 * computed in the index. Recorded ones that haven't are kept only
+	 * if the archive still has the recorded size and archiver, and
+	 * dropped as stale otherwise, like Serialize() would do.
+	 *
+	 * Nothing is hashed or read here: the index is expected to be
+	 * filled by ArchiveIndex::ComputeChecksums() and
+	 * ArchiveIndex::ComputeManifests() beforehand, which use the
+	 * caches in the archive directory.
+	 */
+	QXmlStreamAttributes UpdateAttributes (const QXmlStreamAttributes& attrs, const VersionArchive& archive)
+	{
+		const QString& size = QString::number (archive.Size_);
+		const bool same = !archive.Archiver_.isEmpty () &&
+				attrs.value ("archiver") == archive.Archiver_ &&
+				attrs.value ("size") == size;
+
+		QXmlStreamAttributes result;
+		bool changed = false;
+		bool hasSize = false;
+		bool hasArchiver = false;
+		bool hasSha256 = false;
+		bool hasManifest = false;
+		Q_FOREACH (const QXmlStreamAttribute& attr, attrs)
+		{
+			const QStringRef& name = attr.name ();
+			if (name == "size")
+			{
+				result.append ("size", size);
+				changed = changed || attr.value () != size;
+				hasSize = true;
+			}
+			else if (name == "archiver")
+			{
+				result.append ("archiver", archive.Archiver_);
+				changed = changed || attr.value () != archive.Archiver_;
+				hasArchiver = true;
+			}
+			else if (name == "sha256")
+			{
+				const QString& sha256 = QString::fromLatin1 (archive.Sha256_);
+				if (!sha256.isEmpty ())
+					result.append ("sha256", sha256);
+				else if (same)
+					result.append (attr);
+				changed = changed || (sha256.isEmpty () ? !same : attr.value () != sha256);
+				hasSha256 = true;
+			}
+			else if (name == "manifest")
+			{
+				if (!archive.Manifest_.isEmpty ())
+					result.append ("manifest", archive.Manifest_);
+				else if (same)
+					result.append (attr);
+				changed = changed || (archive.Manifest_.isEmpty () ?
+						!same :
+						attr.value () != archive.Manifest_);
+				hasManifest = true;
+			}
+			else
+				result.append (attr);
+		}
+
+		if (!hasSize)
+			result.append ("size", size);
+		if (!hasArchiver)
+			result.append ("archiver", archive.Archiver_);
+		if (!hasSha256 && !archive.Sha256_.isEmpty ())
+			result.append ("sha256", QString::fromLatin1 (archive.Sha256_));
+		if (!hasManifest && !archive.Manifest_.isEmpty ())
+			result.append ("manifest", archive.Manifest_);
+
+		return changed || result.size () != attrs.size () ? result : attrs;
+	}
+
+	void WriteVersion (QXmlStreamWriter& w, const QString& version, const VersionArchive& archive)
+	{
+		w.writeStartElement ("version");
+		w.writeAttribute ("size", QString::number (archive.Size_));
+		w.writeAttribute ("archiver", archive.Archiver_);
+		if (!archive.Sha256_.isEmpty ())
+			w.writeAttribute ("sha256", QString::fromLatin1 (archive.Sha256_));
+		if (!archive.Manifest_.isEmpty ())
+			w.writeAttribute ("manifest", archive.Manifest_);
+		w.writeCharacters (version);
+		w.writeEndElement ();
+	}
+
+	void WriteRootAttributes (QXmlStreamWriter& w, const PackageData& data)
+	{
+		w.writeAttribute ("type", data.Type_);
+		if (!data.Language_.isEmpty ())
+			w.writeAttribute ("language", data.Language_);
+	}
+
+	void WriteTags (QXmlStreamWriter& w, const PackageData& data)
+	{
+		w.writeStartElement ("tags");
+		Q_FOREACH (const QString& tag, data.Tags_)
+			w.writeTextElement ("tag", tag);
+		w.writeEndElement ();
+	}
+
+	void WriteVersions (QXmlStreamWriter& w, const PackageData& data, const ArchiveIndex& index)
+	{
+		const QString& normalizedName = data.GetNormalizedName ();
+
+		w.writeStartElement ("versions");
+		Q_FOREACH (const QString& version, data.Versions_)
+			WriteVersion (w, version, index.Find (normalizedName, version));
+		w.writeEndElement ();
+	}
+
+	bool HasImages (const PackageData& data)
+	{
+		return !data.Icon_.isEmpty () ||
+				!data.Thumbnails_.isEmpty () ||
+				!data.Screenshots_.isEmpty ();
+	}
+
+	void WriteImages (QXmlStreamWriter& w, const PackageData& data)
+	{
+		if (!HasImages (data))
+			return;
+
+		w.writeStartElement ("images");
+
+		w.writeEmptyElement ("icon");
+		w.writeAttribute ("url", data.Icon_);
+
+		Q_FOREACH (const QString& thumbUrl, data.Thumbnails_)
+		{
+			w.writeEmptyElement ("thumbnail");
+			w.writeAttribute ("url", thumbUrl);
+		}
+
+		Q_FOREACH (const QString& screenUrl, data.Screenshots_)
+		{
+			w.writeEmptyElement ("screenshot");
+			w.writeAttribute ("url", screenUrl);
+		}
+
+		w.writeEndElement ();
+	}
+
+	void WriteLong (QXmlStreamWriter& w, const PackageData& data)
+	{
+		if (!data.LongDescription_.isEmpty ())
+			w.writeTextElement ("long", data.LongDescription_);
+	}
+
+	void WriteMaintainer (QXmlStreamWriter& w, const PackageData& data)
+	{
+		w.writeStartElement ("maintainer");
+		w.writeTextElement ("name", data.MaintName_);
+		w.writeTextElement ("email", data.MaintEmail_);
+		w.writeEndElement ();
+	}
+
+	void WriteDepends (QXmlStreamWriter& w, const PackageData& data)
+	{
+		w.writeStartElement ("depends");
+		Q_FOREACH (const Dependency& dep, data.Depends_)
+		{
+			w.writeEmptyElement ("depend");
+			w.writeAttribute ("type", dep.Type_);
+			w.writeAttribute ("thisVersion", dep.ThisVersion_);
+			w.writeAttribute ("name", dep.Name_);
+			w.writeAttribute ("version", dep.Version_);
+		}
+		w.writeEndElement ();
+	}
+
+	/** Top-level sections of a package description, in the order
+	 * Serialize() writes them.
+	 */
+	enum Section
+	{
+		SName,
+		SDescription,
+		STags,
+		SVersions,
+		SImages,
+		SLong,
+		SMaintainer,
+		SDepends,
+		SCount
+	};
+
+	Section GetSection (const QStringRef& name)
+	{
+		static const char *names [] =
+		{
+			"name",
+			"description",
+			"tags",
+			"versions",
+			"images",
+			"long",
+			"maintainer",
+			"depends"
+		};
+		for (int i = 0; i < SCount; ++i)
+			if (name == QLatin1String (names [i]))
+				return static_cast<Section> (i);
+		return SCount;
+	}
+
+	bool IsSectionChanged (Section section, const PackageData& old, const PackageData& data)
+	{
+		switch (section)
+		{
+		case SName:
+			return old.Name_ != data.Name_;
+		case SDescription:
+			return old.Description_ != data.Description_;
+		case STags:
+			return old.Tags_ != data.Tags_;
+		case SVersions:
+			return old.Versions_ != data.Versions_;
+		case SImages:
+			return old.Icon_ != data.Icon_ ||
+					old.Thumbnails_ != data.Thumbnails_ ||
+					old.Screenshots_ != data.Screenshots_;
+		case SLong:
+			return old.LongDescription_ != data.LongDescription_;
+		case SMaintainer:
+			return old.MaintName_ != data.MaintName_ ||
+					old.MaintEmail_ != data.MaintEmail_;
+		case SDepends:
+			return old.Depends_ != data.Depends_;
+		case SCount:
+			break;
+		}
+		return false;
+	}
+
+	void WriteSection (QXmlStreamWriter& w, Section section,
+			const PackageData& data, const ArchiveIndex& index)
+	{
+		switch (section)
+		{
+		case SName:
+			w.writeTextElement ("name", data.Name_);
+			break;
+		case SDescription:
+			w.writeTextElement ("description", data.Description_);
+			break;
+		case STags:
+			WriteTags (w, data);
+			break;
+		case SVersions:
+			WriteVersions (w, data, index);
+			break;
+		case SImages:
+			WriteImages (w, data);
+			break;
+		case SLong:
+			WriteLong (w, data);
+			break;
+		case SMaintainer:
+			WriteMaintainer (w, data);
+			break;
+		case SDepends:
+			WriteDepends (w, data);
+			break;
+		case SCount:
+			break;
+		}
+	}
+
+	/** Renders the section the way Serialize() would, but indented
+	 * by the given whitespace, or returns an empty string if the
+	 * section is to be omitted.
+	 */
+	QString RenderSection (Section section, const PackageData& data,
+			const ArchiveIndex& index, const QString& indent)
+	{
+		QString result;
+		QXmlStreamWriter w (&result);
+		w.setAutoFormatting (true);
+		w.setAutoFormattingIndent (1);
+		WriteSection (w, section, data, index);
+		return result.trimmed ().replace ('\n', '\n' + indent);
+	}
+
+	/** Replaces an attribute in the text of a start tag with the given
+	 * text, keeping its position and everything else in the tag,
+	 * namespace declarations included, as it is. The text is appended
+	 * if the attribute isn't there yet.
+	 */
+	QString ReplaceTagAttribute (const QString& tag, const QString& name, const QString& attr)
+	{
+		auto isNameEnd = [&tag] (int pos)
+		{
+			const QChar c = tag.at (pos);
+			return c.isSpace () || c == '=' || c == '>' || c == '/';
+		};
+
+		int pos = tag.indexOf ('<') + 1;
+		while (pos < tag.size () && !isNameEnd (pos))
+			++pos;
+
+		while (pos < tag.size ())
+		{
+			const int attrBegin = pos;
+			while (pos < tag.size () && tag.at (pos).isSpace ())
+				++pos;
+
+			const int nameBegin = pos;
+			while (pos < tag.size () && !isNameEnd (pos))
+				++pos;
+			if (pos == nameBegin)
+				break;
+			const QStringRef& attrName = tag.midRef (nameBegin, pos - nameBegin);
+
+			// The tag is well-formed, so the value is quoted.
+			pos = tag.indexOf ('=', pos) + 1;
+			while (tag.at (pos).isSpace ())
+				++pos;
+			pos = tag.indexOf (tag.at (pos), pos + 1) + 1;
+
+			if (attrName == name)
+				return tag.left (attrBegin) + attr + tag.mid (pos);
+		}
+
+		int end = tag.lastIndexOf ('>');
+		if (end > 0 && tag.at (end - 1) == '/')
+			--end;
+		return tag.left (end) + attr + tag.mid (end);
+	}
+
+	QString RenderAttribute (const QString& name, const QString& value)
+	{
+		return QString (" %1=\"%2\"").arg (name, value.toHtmlEscaped ());
+	}
+
+	/** Sets an attribute in the text of a start tag like
+	 * ReplaceTagAttribute() does, removing it if the value is empty.
+	 */
+	QString SetTagAttribute (const QString& tag, const QString& name, const QString& value)
+	{
+		return ReplaceTagAttribute (tag, name,
+				value.isEmpty () ? QString () : RenderAttribute (name, value));
+	}
+
+	/** Spans of a parsed package description, as offsets into its
+	 * text. Only the top-level sections and the versions are tracked,
+	 * everything else is just copied.
+	 */
+	struct Skeleton
+	{
+		struct Span
+		{
+			QString Name_;
+			int Begin_;
+			int End_;
+			QXmlStreamAttributes Attrs_;
+
+			/** Where the start tag ends, for the sections.
+			 */
+			int OpenEnd_;
+		};
+
+		Span Root_;
+		QList<Span> Sections_;
+
+		/** The versions are named by their text.
+		 */
+		QList<Span> Versions_;
+		QString VersionIndent_;
+
+		bool Parse (const QString& text)
+		{
+			QXmlStreamReader reader (text);
+			int depth = 0;
+			int prev = 0;
+			QString lastSpace;
+			while (!reader.atEnd ())
+			{
+				const QXmlStreamReader::TokenType token = reader.readNext ();
+				const int offset = reader.characterOffset ();
+				switch (token)
+				{
+				case QXmlStreamReader::StartDocument:
+				{
+					// The text has been decoded as UTF-8 by the caller.
+					const QString& encoding = reader.documentEncoding ().toString ();
+					if (!encoding.isEmpty () &&
+							encoding.compare ("UTF-8", Qt::CaseInsensitive))
+						return false;
+					break;
+				}
+				case QXmlStreamReader::StartElement:
+					++depth;
+					if (depth == 1)
+					{
+						const Span span = { reader.name ().toString (), prev, offset, reader.attributes (), offset };
+						Root_ = span;
+					}
+					else if (depth == 2)
+					{
+						const Span span = { reader.name ().toString (), prev, -1, QXmlStreamAttributes (), offset };
+						Sections_ << span;
+					}
+					else if (depth == 3 &&
+							Sections_.last ().Name_ == "versions" &&
+							reader.name () == "version")
+					{
+						const QXmlStreamAttributes& attrs = reader.attributes ();
+						// Child elements are skipped like the loader does,
+						// rather than failing the whole parse.
+						const QString& version = reader.readElementText (QXmlStreamReader::SkipChildElements).simplified ();
+						const Span span = { version, prev, static_cast<int> (reader.characterOffset ()), attrs, -1 };
+						Versions_ << span;
+						VersionIndent_ = lastSpace;
+						--depth;
+					}
+					break;
+				case QXmlStreamReader::EndElement:
+					if (depth == 2)
+						Sections_.last ().End_ = offset;
+					--depth;
+					break;
+				case QXmlStreamReader::Characters:
+					if (reader.isWhitespace ())
+						lastSpace = reader.text ().toString ();
+					break;
+				default:
+					break;
+				}
+				prev = reader.characterOffset ();
+			}
+
+			// An empty root element has nowhere to put the sections.
+			return !reader.hasError () &&
+					Root_.Name_ == "package" &&
+					!text.midRef (Root_.Begin_, Root_.End_ - Root_.Begin_).endsWith ("/>");
+		}
+	};
+
+	QString GetIndent (const QString& text, int pos)
+	{
+		const int lineStart = text.lastIndexOf ('\n', pos - 1) + 1;
+		const QString& indent = text.mid (lineStart, pos - lineStart);
+		return indent.trimmed ().isEmpty () ? indent : QString (" ");
+	}
+
+	/** Returns the position right after the start tag beginning at the
+	 * given position, skipping the quoted attribute values, which may
+	 * contain '>'.
+	 */
+	int FindStartTagEnd (const QString& text, int pos)
+	{
+		QChar quote;
+		for (; pos < text.size (); ++pos)
+		{
+			const QChar c = text.at (pos);
+			if (!quote.isNull ())
+			{
+				if (c == quote)
+					quote = QChar ();
+			}
+			else if (c == '"' || c == '\'')
+				quote = c;
+			else if (c == '>')
+				return pos + 1;
+		}
+		return pos;
+	}
+
+	/** Splices the given attributes into the start tag of the version
+	 * element, keeping its text, its child elements and the attributes
+	 * that didn't change as they are.
+	 */
+	QString PatchVersion (const QString& element,
+			const QXmlStreamAttributes& oldAttrs, const QXmlStreamAttributes& attrs)
+	{
+		const int tagEnd = FindStartTagEnd (element, 0);
+		QString tag = element.left (tagEnd);
+
+		Q_FOREACH (const QXmlStreamAttribute& attr, oldAttrs)
+		{
+			const QString& name = attr.qualifiedName ().toString ();
+			if (!attrs.hasAttribute (name))
+				tag = ReplaceTagAttribute (tag, name, QString ());
+		}
+
+		Q_FOREACH (const QXmlStreamAttribute& attr, attrs)
+		{
+			const QString& name = attr.qualifiedName ().toString ();
+			if (!oldAttrs.hasAttribute (name) ||
+					oldAttrs.value (name) != attr.value ())
+				tag = ReplaceTagAttribute (tag, name,
+						RenderAttribute (name, attr.value ().toString ()));
+		}
+
+		return tag + element.mid (tagEnd);
+	}
+
+	/** Splices the versions into the versions section.
+	 *
+	 * The elements of the versions that are still there are the places
+	 * the versions are put into, in order, so that the text between
+	 * them stays where it is. Patched versions only get their start
+	 * tags changed, and the versions that don't fit are appended
+	 * after the last one, before the closing tag.
+	 *
+	 * If there are several versions sections, this is the first one
+	 * and it gets the versions of all of them.
+	 */
+	QString RenderVersions (const QString& text, const Skeleton& skeleton,
+			const Skeleton::Span& section, const PackageData& data,
+			const ArchiveIndex& index, const QString& indent)
+	{
+		const QString& normalizedName = data.GetNormalizedName ();
+
+		QHash<QString, int> spans;
+		spans.reserve (skeleton.Versions_.size ());
+		for (int i = skeleton.Versions_.size () - 1; i >= 0; --i)
+			spans [skeleton.Versions_.at (i).Name_] = i;
+
+		auto renderElement = [&] (const QString& version)
+		{
+			const VersionArchive& archive = index.Find (normalizedName, version);
+
+			const int pos = spans.value (version, -1);
+			if (pos == -1)
+			{
+				QString element;
+				QXmlStreamWriter w (&element);
+				WriteVersion (w, version, archive);
+				return element;
+			}
+
+			const Skeleton::Span& span = skeleton.Versions_.at (pos);
+			const QString& element = text.mid (span.Begin_, span.End_ - span.Begin_);
+			const QXmlStreamAttributes& attrs = UpdateAttributes (span.Attrs_, archive);
+			return attrs == span.Attrs_ ?
+					element :
+					PatchVersion (element, span.Attrs_, attrs);
+		};
+
+		const QSet<QString>& wanted = data.Versions_.toSet ();
+
+		QString result = text.mid (section.Begin_, section.OpenEnd_ - section.Begin_);
+		const bool selfClosing = result.endsWith ("/>");
+
+		int placed = 0;
+		int pos = section.OpenEnd_;
+		Q_FOREACH (const Skeleton::Span& span, skeleton.Versions_)
+		{
+			if (span.Begin_ < section.OpenEnd_ || span.End_ > section.End_)
+				continue;
+
+			const QString& before = text.mid (pos, span.Begin_ - pos);
+			pos = span.End_;
+
+			if (wanted.contains (span.Name_) && placed < data.Versions_.size ())
+				result += before + renderElement (data.Versions_.at (placed++));
+			// Only the indentation of a removed version goes away with it.
+			else if (!before.trimmed ().isEmpty ())
+				result += before;
+		}
+
+		if (placed == data.Versions_.size ())
+			return result + text.mid (pos, section.End_ - pos);
+
+		const QString& versionIndent = skeleton.Versions_.isEmpty () ?
+				indent + ' ' :
+				skeleton.VersionIndent_.mid (skeleton.VersionIndent_.lastIndexOf ('\n') + 1);
+
+		if (selfClosing)
+		{
+			result.chop (2);
+			result += '>';
+		}
+		for (int i = placed; i < data.Versions_.size (); ++i)
+			result += '\n' + versionIndent + renderElement (data.Versions_.at (i));
+
+		if (selfClosing)
+			result += '\n' + indent + "</versions>";
+		else
+			result += text.mid (pos, section.End_ - pos);
+		return result;
+	}
+
+	/** The original text of a description, with its skeleton and the
+	 * package it describes.
+	 */
+	struct Original
+	{
+		QString Text_;
+		Skeleton Skeleton_;
+		PackageData Data_;
+	};
+
+	/** Parses the original description, returning false if it can't
+	 * be updated by splicing: if it is empty, not UTF-8 or malformed.
+	 */
+	bool ParseOriginal (const QByteArray& bytes, Original& original)
+	{
+		original.Text_ = QString::fromUtf8 (bytes);
+		if (bytes.isEmpty () ||
+				original.Text_.toUtf8 () != bytes ||
+				!original.Skeleton_.Parse (original.Text_))
+			return false;
+
+		try
+		{
+			QByteArray copy = bytes;
+			QBuffer buffer (&copy);
+			buffer.open (QIODevice::ReadOnly);
+			QStringList warnings;
+			original.Data_ = PackageLoader::Load (&buffer, warnings);
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	/** Splices the changes into the original text of the description.
+	 */
+	QString UpdateText (const Original& original, const PackageData& data, const ArchiveIndex& index)
+	{
+		const QString& text = original.Text_;
+		const Skeleton& skeleton = original.Skeleton_;
+		const PackageData& old = original.Data_;
+
+		const QString& indent = skeleton.Sections_.isEmpty () ?
+				QString (" ") :
+				GetIndent (text, skeleton.Sections_.first ().Begin_);
+
+		QString result = text.left (skeleton.Root_.Begin_);
+
+		// Only the type and the language attributes of the root
+		// element are patched, so that whatever foreign attributes and
+		// namespace declarations it has are kept.
+		QString root = text.mid (skeleton.Root_.Begin_, skeleton.Root_.End_ - skeleton.Root_.Begin_);
+		if (data.Type_ != old.Type_)
+			root = SetTagAttribute (root, "type", data.Type_);
+		if (data.Language_ != old.Language_)
+			root = SetTagAttribute (root, "language", data.Language_);
+		result += root;
+
+		int counts [SCount] = {};
+		Q_FOREACH (const Skeleton::Span& span, skeleton.Sections_)
+		{
+			const Section section = GetSection (QStringRef (&span.Name_));
+			if (section != SCount)
+				++counts [section];
+		}
+
+		bool present [SCount] = {};
+		int pos = skeleton.Root_.End_;
+		Q_FOREACH (const Skeleton::Span& span, skeleton.Sections_)
+		{
+			const QString& before = text.mid (pos, span.Begin_ - pos);
+			pos = span.End_;
+
+			const Section section = GetSection (QStringRef (&span.Name_));
+			if (section == SCount)
+			{
+				result += before + text.mid (span.Begin_, span.End_ - span.Begin_);
+				continue;
+			}
+
+			// The loader merges a section appearing several times, so it
+			// is rendered from the package into the first one.
+			if (present [section])
+				continue;
+			present [section] = true;
+
+			QString rendered;
+			if (section == SVersions)
+				rendered = RenderVersions (text, skeleton, span, data, index, indent);
+			else if (counts [section] == 1 && !IsSectionChanged (section, old, data))
+				rendered = text.mid (span.Begin_, span.End_ - span.Begin_);
+			else
+				rendered = RenderSection (section, data, index, indent);
+
+			if (!rendered.isEmpty ())
+				result += before + rendered;
+		}
+
+		// Missing sections are appended after the existing ones.
+		for (int i = 0; i < SCount; ++i)
+		{
+			const Section section = static_cast<Section> (i);
+			if (present [i] || !IsSectionChanged (section, old, data))
+				continue;
+
+			const QString& rendered = RenderSection (section, data, index, indent);
+			if (!rendered.isEmpty ())
+				result += '\n' + indent + rendered;
+		}
+
+		result += text.mid (pos);
+		return result;
+	}
+}
+
+QByteArray PackageWriter::Serialize (const PackageData& data, const ArchiveIndex& index)
+{
+	LC_TRACE_SCOPE ("PackageWriter::Serialize");
+
+	QByteArray result;
+
+	QXmlStreamWriter w (&result);
+	w.setAutoFormatting (true);
+	w.setAutoFormattingIndent (1);
+	w.writeStartDocument ();
+
+	w.writeStartElement ("package");
+	WriteRootAttributes (w, data);
+	for (int i = 0; i < SCount; ++i)
+		WriteSection (w, static_cast<Section> (i), data, index);
+	w.writeEndElement ();
+
+	w.writeEndDocument ();
+
+	return result;
+}
+
+QByteArray PackageWriter::Update (const QByteArray& original,
+		const PackageData& data, const ArchiveIndex& index)
+{
+	LC_TRACE_SCOPE ("PackageWriter::Update");
+
+	Original parsed;
+	if (ParseOriginal (original, parsed))
+		return UpdateText (parsed, data, index).toUtf8 ();
+
+	return Serialize (data, index);
+}
+
+bool PackageWriter::Save (const PackageData& data, const QString& fileName,
+		const ArchiveIndex& index, const QString& sourceFileName)
+{
+	LC_TRACE_SCOPE ("PackageWriter::Save");
+
+	QByteArray original;
+	{
+		QFile existing (fileName);
+		if (existing.open (QIODevice::ReadOnly))
+			original = existing.readAll ();
+	}
+
+	// Splicing into some other document would drag its comments and
+	// foreign elements into this package.
+	const bool sameFile = !sourceFileName.isEmpty () &&
+			QFileInfo (sourceFileName) == QFileInfo (fileName);
+	const QByteArray& result = sameFile ?
+			Update (original, data, index) :
+			Serialize (data, index);
+	if (result == original)
+		return false;
+
+	WriteFile (fileName, result);
+	return true;
+}
+
+bool PackageWriter::UpdateArchives (const QString& fileName,
+		const QString& normalizedName, const ArchiveIndex& index,
+		const QStringList& newVersions)
+{
+	LC_TRACE_SCOPE ("PackageWriter::UpdateArchives");
+
+	QFile file (fileName);
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (tr ("Could not open file %1 for reading.")
+				.arg (fileName)
+				.toUtf8 ().constData ());
+	const QByteArray& original = file.readAll ();
+	file.close ();
+
+	Original parsed;
+	if (!ParseOriginal (original, parsed))
+		throw std::runtime_error (tr ("Could not parse %1: it is not a well-formed UTF-8 package description.")
+				.arg (fileName)
+				.toUtf8 ().constData ());
+
+	// Only the versions differ from the original, so only the version
+	// elements are touched, and a <versions> element is created if the
+	// new versions have nowhere else to go.
+	PackageData data = parsed.Data_;
+	QSet<QString> known = data.Versions_.toSet ();
+	Q_FOREACH (const QString& version, newVersions)
+		if (!known.contains (version) &&
+				!index.Find (normalizedName, version).Archiver_.isEmpty ())
+		{
+			data.Versions_ << version;
+			known << version;
+		}
+
+	const QByteArray& result = UpdateText (parsed, data, index).toUtf8 ();
+	if (result == original)
+		return false;
+
+	WriteFile (fileName, result);
+	return true;
+}
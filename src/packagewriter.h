@@ -0,0 +1,88 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PACKAGEWRITER_H
+#define PACKAGEWRITER_H
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QStringList>
+
+struct PackageData;
+class ArchiveIndex;
+
+class PackageWriter
+{
+	Q_DECLARE_TR_FUNCTIONS (PackageWriter)
+public:
+	/** Serializes the package into the XML description, looking up
+	 * the archives for its versions in the given index. Checksums are
+	 * recorded for those archives that have them in the index, and so
+	 * are the file names of the content manifests.
+	 */
+	static QByteArray Serialize (const PackageData&, const ArchiveIndex&);
+
+	/** Updates the original text of a package description to match
+	 * the package, re-emitting only the sections that changed.
+	 *
+	 * Everything else, including comments, formatting and elements
+	 * and attributes this program doesn't know about, is kept as it
+	 * is. The version elements are patched one by one. Falls back to
+	 * Serialize() if the original is empty, isn't UTF-8 or can't be
+	 * parsed.
+	 */
+	static QByteArray Update (const QByteArray& original, const PackageData&, const ArchiveIndex&);
+
+	/** Writes the package into the given file, atomically replacing
+	 * it, throwing std::runtime_error if the file could not be
+	 * written.
+	 *
+	 * If the package has been loaded from that very file, as told by
+	 * sourceFileName, the file is updated with Update(), otherwise
+	 * whatever it contains is unrelated to the package and it gets
+	 * the Serialize() output, as does a file that doesn't exist yet.
+	 *
+	 * If the file already has exactly the same contents, it is left
+	 * untouched and false is returned, otherwise true is returned.
+	 * Like with UpdateArchives(), precompressed copies of the file
+	 * made by Precompressor are refreshed if there are any.
+	 */
+	static bool Save (const PackageData&, const QString& fileName,
+			const ArchiveIndex&, const QString& sourceFileName);
+
+	/** Updates the size and archiver attributes of the versions in
+	 * the given package description to match the archives in the
+	 * index, splicing the changed version elements into the file the
+	 * way Update() does and leaving everything else as it is.
+	 * Checksums and manifests are taken from the index, and those
+	 * recorded for archives that changed are dropped if the index
+	 * doesn't have them: nothing is hashed here. Versions whose
+	 * archives are gone are reset like Serialize() does.
+	 *
+	 * The newVersions having archives in the index are appended to
+	 * the versions, with the checksums and manifests the index has
+	 * for them, creating the versions element if there is none.
+	 *
+	 * Returns whether the file has been changed, throwing
+	 * std::runtime_error on failure.
+	 */
+	static bool UpdateArchives (const QString& fileName,
+			const QString& normalizedName, const ArchiveIndex&,
+			const QStringList& newVersions = QStringList ());
+};
+
+#endif
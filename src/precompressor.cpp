@@ -0,0 +1,191 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "precompressor.h"
+#include <stdexcept>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include "compressor.h"
+#include "tracing.h"
+
+namespace
+{
+	QByteArray Hash (const QByteArray& data)
+	{
+		return QCryptographicHash::hash (data, QCryptographicHash::Sha256).toHex ();
+	}
+
+	/** All the formats copies may have been made in, including those
+	 * this build may lack support for.
+	 */
+	QStringList GetAllFormats ()
+	{
+		return QStringList () << "gz" << "xz" << "zst";
+	}
+
+	int GetLevel (const QString& format)
+	{
+		// The copies are made once and served many times, so spend
+		// time on them. Higher xz presets only grow the dictionary,
+		// which gains nothing on files this small but memory use.
+		if (format == "zst")
+			return 19;
+		else if (format == "xz")
+			return 6;
+		return 9;
+	}
+
+	void WriteFile (const QString& path, const QByteArray& contents)
+	{
+		QSaveFile file (path);
+		if (!file.open (QIODevice::WriteOnly) ||
+				file.write (contents) != contents.size () ||
+				!file.commit ())
+			throw std::runtime_error (Precompressor::tr ("Could not write %1: %2.")
+					.arg (path)
+					.arg (file.errorString ())
+					.toUtf8 ().constData ());
+	}
+
+	QByteArray Compress (const QString& format, const QByteArray& contents)
+	{
+		LC_TRACE_SCOPE ("Precompressor::Compress");
+
+		QByteArray result;
+		QBuffer buffer (&result);
+		buffer.open (QIODevice::WriteOnly);
+
+		CompressionParams params;
+		params.Level_ = GetLevel (format);
+		params.Threads_ = 1;
+
+		const std::unique_ptr<Compressor> compressor = Compressor::Create (format, &buffer, params);
+		compressor->Write (contents.constData (), contents.size ());
+		compressor->Finish ();
+		return result;
+	}
+
+	/** Checks whether the digest file lists exactly the given file
+	 * and its copies, with the file having the given checksum, and
+	 * whether all the copies are there.
+	 */
+	bool IsUpToDate (const QString& path, const QByteArray& hash)
+	{
+		QFile file (Precompressor::GetDigestPath (path));
+		if (!file.open (QIODevice::ReadOnly))
+			return false;
+
+		const QFileInfo fi (path);
+		const QString& name = fi.fileName ();
+		QStringList expected (name);
+		Q_FOREACH (const QString& format, Precompressor::GetFormats ())
+			expected << name + '.' + format;
+
+		QStringList listed;
+		while (!file.atEnd ())
+		{
+			const QByteArray& line = file.readLine ().trimmed ();
+			const int space = line.indexOf (' ');
+			if (space <= 0)
+				return false;
+
+			const QString& listedName = QString::fromUtf8 (line.mid (space).trimmed ());
+			if (listed.isEmpty () && line.left (space) != hash)
+				return false;
+			if (!listed.isEmpty () && !fi.dir ().exists (listedName))
+				return false;
+			listed << listedName;
+		}
+
+		return listed == expected;
+	}
+}
+
+QStringList Precompressor::GetFormats ()
+{
+	QStringList result;
+	result << "gz" << "xz";
+#ifdef LCPACKGEN_ZSTD
+	result << "zst";
+#endif
+	return result;
+}
+
+QString Precompressor::GetDigestPath (const QString& path)
+{
+	return path + ".sha256";
+}
+
+bool Precompressor::Update (const QString& path, const QByteArray& contents)
+{
+	LC_TRACE_SCOPE ("Precompressor::Update");
+
+	const QByteArray& hash = Hash (contents);
+	if (IsUpToDate (path, hash))
+		return false;
+
+	const QByteArray& name = QFileInfo (path).fileName ().toUtf8 ();
+
+	QByteArray digests = hash + "  " + name + '\n';
+	Q_FOREACH (const QString& format, GetFormats ())
+	{
+		const QByteArray& compressed = Compress (format, contents);
+		WriteFile (path + '.' + format, compressed);
+		digests += Hash (compressed) + "  " + name + '.' + format.toUtf8 () + '\n';
+	}
+
+	// A build with other formats may have left copies this one can't
+	// keep up to date, so they are removed rather than served stale.
+	const QStringList& formats = GetFormats ();
+	Q_FOREACH (const QString& format, GetAllFormats ())
+	{
+		const QString& copy = path + '.' + format;
+		if (!formats.contains (format) &&
+				QFile::exists (copy) &&
+				!QFile::remove (copy))
+			throw std::runtime_error (tr ("Could not remove the stale copy %1.")
+					.arg (copy)
+					.toUtf8 ().constData ());
+	}
+
+	WriteFile (GetDigestPath (path), digests);
+	return true;
+}
+
+bool Precompressor::Update (const QString& path)
+{
+	QFile file (path);
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (tr ("Unable to open file %1 for reading.")
+				.arg (path)
+				.toUtf8 ().constData ());
+
+	return Update (path, file.readAll ());
+}
+
+bool Precompressor::Refresh (const QString& path, const QByteArray& contents)
+{
+	if (!QFile::exists (GetDigestPath (path)))
+		return false;
+
+	return Update (path, contents);
+}
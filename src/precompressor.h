@@ -0,0 +1,71 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef PRECOMPRESSOR_H
+#define PRECOMPRESSOR_H
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+/** Keeps precompressed copies of generated metadata next to it, so
+ * that web servers could send them as they are instead of compressing
+ * the same bytes on every request.
+ *
+ * For a file FILE the copies are FILE.gz, FILE.xz and, if built with
+ * zstd, FILE.zst. They come with FILE.sha256, listing the checksums of
+ * FILE and its copies in the sha256sum format. The digest file also
+ * tells which contents the copies were made from, so they are only
+ * rewritten when the contents change or a copy goes missing. Copies
+ * in formats this build doesn't produce are removed when the digest
+ * file is rewritten.
+ */
+class Precompressor
+{
+	Q_DECLARE_TR_FUNCTIONS (Precompressor)
+public:
+	/** Returns the archivers used for the copies, which are also
+	 * the suffixes of their file names.
+	 */
+	static QStringList GetFormats ();
+
+	/** Returns the path of the digest file for the given file.
+	 */
+	static QString GetDigestPath (const QString& path);
+
+	/** Brings the copies of the file at the given path, having the
+	 * given contents, up to date, each of them replaced atomically.
+	 * The digest file is written last.
+	 *
+	 * Returns whether anything has been written, throwing
+	 * std::runtime_error on failure. This function is reentrant.
+	 */
+	static bool Update (const QString& path, const QByteArray& contents);
+
+	/** Same as above, but reads the contents from the file.
+	 */
+	static bool Update (const QString& path);
+
+	/** Updates the copies of the file at the given path only if it
+	 * already has some, so that whatever rewrites a file never leaves
+	 * stale copies behind.
+	 */
+	static bool Refresh (const QString& path, const QByteArray& contents);
+};
+
+#endif
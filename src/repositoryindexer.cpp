@@ -0,0 +1,533 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "repositoryindexer.h"
+#include <stdexcept>
+#include <functional>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QXmlStreamWriter>
+#include <QtConcurrentMap>
+#include "packagedata.h"
+#include "packageloader.h"
+#include "archiveinfo.h"
+#include "dependencyresolver.h"
+#include "precompressor.h"
+#include "versionkey.h"
+
+namespace
+{
+	const quint32 CacheMagic = 0x4c504958;
+	const quint32 CacheVersion = 4;
+
+	struct CacheEntry
+	{
+		qint64 XmlSize_;
+		qint64 XmlMTime_;
+		QByteArray ArchKey_;
+		QByteArray XmlHash_;
+		QByteArray Fragment_;
+
+		// Whatever is needed to rebuild the dependency graph without
+		// parsing the unchanged packages.
+		QString Name_;
+		QStringList Versions_;
+		QList<Dependency> Depends_;
+
+		CacheEntry ()
+		: XmlSize_ (-1)
+		, XmlMTime_ (-1)
+		{
+		}
+	};
+
+	QDataStream& operator<< (QDataStream& out, const CacheEntry& entry)
+	{
+		out << entry.XmlSize_
+				<< entry.XmlMTime_
+				<< entry.ArchKey_
+				<< entry.XmlHash_
+				<< entry.Fragment_
+				<< entry.Name_
+				<< entry.Versions_
+				<< static_cast<quint32> (entry.Depends_.size ());
+		Q_FOREACH (const Dependency& dep, entry.Depends_)
+			out << dep.ThisVersion_
+					<< dep.Type_
+					<< dep.Name_
+					<< dep.Version_;
+		return out;
+	}
+
+	QDataStream& operator>> (QDataStream& in, CacheEntry& entry)
+	{
+		quint32 depsCount = 0;
+		in >> entry.XmlSize_
+				>> entry.XmlMTime_
+				>> entry.ArchKey_
+				>> entry.XmlHash_
+				>> entry.Fragment_
+				>> entry.Name_
+				>> entry.Versions_
+				>> depsCount;
+		for (quint32 i = 0; i < depsCount && in.status () == QDataStream::Ok; ++i)
+		{
+			Dependency dep;
+			in >> dep.ThisVersion_
+					>> dep.Type_
+					>> dep.Name_
+					>> dep.Version_;
+			entry.Depends_ << dep;
+		}
+		return in;
+	}
+
+	typedef QHash<QString, CacheEntry> Cache_t;
+
+	Cache_t LoadCache (const QString& path)
+	{
+		QFile file (path);
+		if (!file.open (QIODevice::ReadOnly))
+			return Cache_t ();
+
+		QDataStream in (&file);
+		quint32 magic = 0;
+		quint32 version = 0;
+		in >> magic >> version;
+		if (magic != CacheMagic || version != CacheVersion)
+			return Cache_t ();
+
+		in.setVersion (QDataStream::Qt_5_0);
+
+		Cache_t cache;
+		in >> cache;
+		if (in.status () != QDataStream::Ok)
+			return Cache_t ();
+		return cache;
+	}
+
+	void SaveCache (const QString& path, const Cache_t& cache)
+	{
+		QSaveFile file (path);
+		if (!file.open (QIODevice::WriteOnly))
+			throw std::runtime_error (RepositoryIndexer::tr ("Could not open cache file %1 for writing.")
+					.arg (path)
+					.toUtf8 ().constData ());
+
+		QDataStream out (&file);
+		out << CacheMagic << CacheVersion;
+		out.setVersion (QDataStream::Qt_5_0);
+		out << cache;
+
+		if (out.status () != QDataStream::Ok || !file.commit ())
+			throw std::runtime_error (RepositoryIndexer::tr ("Could not write cache file %1.")
+					.arg (path)
+					.toUtf8 ().constData ());
+	}
+
+	QByteArray MakeFragment (const PackageData& data,
+			const ArchiveIndex& index, const QString& relPath)
+	{
+		QByteArray result;
+
+		QXmlStreamWriter w (&result);
+		w.setAutoFormatting (true);
+		w.setAutoFormattingIndent (1);
+
+		w.writeStartElement ("package");
+		w.writeAttribute ("type", data.Type_);
+		if (!data.Language_.isEmpty ())
+			w.writeAttribute ("language", data.Language_);
+		w.writeAttribute ("path", relPath);
+
+		w.writeTextElement ("name", data.Name_);
+		w.writeTextElement ("description", data.Description_);
+
+		w.writeStartElement ("tags");
+		Q_FOREACH (const QString& tag, data.Tags_)
+			w.writeTextElement ("tag", tag);
+		w.writeEndElement ();
+
+		const QString& normalizedName = data.GetNormalizedName ();
+		const QString& latest = VersionKey::GetLatest (data.Versions_);
+
+		w.writeStartElement ("versions");
+		Q_FOREACH (const QString& version, data.Versions_)
+		{
+			const VersionArchive& archive = index.Find (normalizedName, version);
+
+			w.writeStartElement ("version");
+			w.writeAttribute ("size", QString::number (archive.Size_));
+			w.writeAttribute ("archiver", archive.Archiver_);
+			if (version == latest)
+				w.writeAttribute ("latest", "true");
+			w.writeCharacters (version);
+			w.writeEndElement ();
+		}
+		w.writeEndElement ();
+
+		w.writeStartElement ("depends");
+		Q_FOREACH (const Dependency& dep, data.Depends_)
+		{
+			w.writeEmptyElement ("depend");
+			w.writeAttribute ("type", dep.Type_);
+			w.writeAttribute ("thisVersion", dep.ThisVersion_);
+			w.writeAttribute ("name", dep.Name_);
+			w.writeAttribute ("version", dep.Version_);
+		}
+		w.writeEndElement ();
+
+		w.writeEndElement ();
+
+		result.append ('\n');
+		return result;
+	}
+
+	/* The closures are written after all the packages as
+	 *
+	 *   <closures>
+	 *    <node package="0" version="1.0"/>
+	 *    ...
+	 *    <closure node="5">0 3 1 12</closure>
+	 *   </closures>
+	 *
+	 * Every package version is interned as a node, numbered by the
+	 * position of its <node> element, and refers to its package by
+	 * the position of the <package> element in the index. A closure
+	 * lists the nodes that the given node requires, directly or not,
+	 * as ascending IDs, each but the first one encoded as the
+	 * difference with the previous one. Nodes requiring nothing have
+	 * no <closure> element.
+	 */
+	QByteArray MakeClosures (const DependencyResolver& resolver)
+	{
+		QByteArray result;
+
+		QXmlStreamWriter w (&result);
+		w.setAutoFormatting (true);
+		w.setAutoFormattingIndent (1);
+
+		w.writeStartElement ("closures");
+
+		Q_FOREACH (const DependencyResolver::Node& node, resolver.GetNodes ())
+		{
+			w.writeEmptyElement ("node");
+			w.writeAttribute ("package", QString::number (node.Package_));
+			w.writeAttribute ("version", node.Version_);
+		}
+
+		const QVector<QVector<int>>& closures = resolver.ComputeClosures ();
+		for (int node = 0; node < closures.size (); ++node)
+		{
+			const QVector<int>& closure = closures.at (node);
+			if (closure.isEmpty ())
+				continue;
+
+			QByteArray deltas;
+			int prev = 0;
+			Q_FOREACH (int id, closure)
+			{
+				if (!deltas.isEmpty ())
+					deltas += ' ';
+				deltas += QByteArray::number (id - prev);
+				prev = id;
+			}
+
+			w.writeStartElement ("closure");
+			w.writeAttribute ("node", QString::number (node));
+			w.writeCharacters (QString::fromLatin1 (deltas));
+			w.writeEndElement ();
+		}
+
+		w.writeEndElement ();
+
+		result.append ('\n');
+		return result;
+	}
+
+	enum Outcome
+	{
+		OCached,
+		OParsed,
+		OError
+	};
+
+	struct IndexedPackage
+	{
+		QString RelPath_;
+		Outcome Outcome_;
+		CacheEntry Entry_;
+		QString Error_;
+	};
+
+	qint64 GetMTime (const QFileInfo& fi)
+	{
+		return fi.exists () ? fi.lastModified ().toMSecsSinceEpoch () : -1;
+	}
+
+	/** Returns the key of the archives of the given package versions,
+	 * made of the archiver, the size and the mtime of each of them, so
+	 * that an archive overwritten in place invalidates the cached entry
+	 * even though the mtime of the directory doesn't change.
+	 */
+	QByteArray GetArchKey (const ArchiveIndex& index,
+			const QString& name, const QStringList& versions)
+	{
+		PackageData data;
+		data.Name_ = name;
+		const QString& normalizedName = data.GetNormalizedName ();
+
+		QByteArray result;
+		Q_FOREACH (const QString& version, versions)
+		{
+			const VersionArchive& archive = index.Find (normalizedName, version);
+			result += archive.Archiver_.toLatin1 () + ' ' +
+					QByteArray::number (archive.Size_) + ' ' +
+					QByteArray::number (archive.Archiver_.isEmpty () ?
+							-1 :
+							archive.Modified_.toMSecsSinceEpoch ()) + '\n';
+		}
+		return result;
+	}
+
+	IndexedPackage IndexPackage (const QDir& root,
+			const QString& path, const Cache_t& cache)
+	{
+		IndexedPackage result;
+		result.RelPath_ = root.relativeFilePath (path);
+		result.Outcome_ = OError;
+
+		const QFileInfo xmlInfo (path);
+		const ArchiveIndex index (xmlInfo.dir ().filePath ("arch"));
+
+		CacheEntry& entry = result.Entry_;
+		entry.XmlSize_ = xmlInfo.size ();
+		entry.XmlMTime_ = GetMTime (xmlInfo);
+
+		// The archives are checked against the versions the cached
+		// entry has, which are the current ones unless the description
+		// changed, and then it is parsed anyway.
+		const Cache_t::const_iterator cached = cache.find (result.RelPath_);
+		const bool archUnchanged = cached != cache.end () &&
+				cached->ArchKey_ == GetArchKey (index, cached->Name_, cached->Versions_);
+
+		// Fast path: a stat() and a listing of arch/ for unchanged packages.
+		if (archUnchanged &&
+				cached->XmlSize_ == entry.XmlSize_ &&
+				cached->XmlMTime_ == entry.XmlMTime_)
+		{
+			result.Entry_ = *cached;
+			result.Outcome_ = OCached;
+			return result;
+		}
+
+		QFile file (path);
+		if (!file.open (QIODevice::ReadOnly))
+		{
+			result.Error_ = RepositoryIndexer::tr ("Unable to open file %1 for reading.")
+					.arg (path);
+			return result;
+		}
+		QByteArray contents = file.readAll ();
+		file.close ();
+		entry.XmlHash_ = QCryptographicHash::hash (contents, QCryptographicHash::Sha1);
+
+		// The file has been touched, but its contents are the same.
+		if (archUnchanged && cached->XmlHash_ == entry.XmlHash_)
+		{
+			entry.ArchKey_ = cached->ArchKey_;
+			entry.Fragment_ = cached->Fragment_;
+			entry.Name_ = cached->Name_;
+			entry.Versions_ = cached->Versions_;
+			entry.Depends_ = cached->Depends_;
+			result.Outcome_ = OCached;
+			return result;
+		}
+
+		try
+		{
+			QBuffer buffer (&contents);
+			buffer.open (QIODevice::ReadOnly);
+			QStringList warnings;
+			const PackageData& data = PackageLoader::Load (&buffer, warnings);
+			entry.Fragment_ = MakeFragment (data, index, result.RelPath_);
+			entry.ArchKey_ = GetArchKey (index, data.Name_, data.Versions_);
+			entry.Name_ = data.Name_;
+			entry.Versions_ = data.Versions_;
+			entry.Depends_ = data.Depends_;
+			result.Outcome_ = OParsed;
+		}
+		catch (const std::exception& e)
+		{
+			result.Error_ = QString ("%1: %2")
+					.arg (result.RelPath_)
+					.arg (QString::fromUtf8 (e.what ()));
+		}
+
+		return result;
+	}
+}
+
+RepositoryIndexer::Stats::Stats ()
+: Total_ (0)
+, Parsed_ (0)
+, Cached_ (0)
+, Written_ (false)
+, Precompressed_ (false)
+{
+}
+
+RepositoryIndexer::RepositoryIndexer (const QString& root,
+		const QString& indexPath, bool useCache, bool precompress)
+: Root_ (QDir (root).absolutePath ())
+, IndexPath_ (indexPath.isEmpty () ?
+		QDir (Root_).filePath ("Packages.xml") :
+		QFileInfo (indexPath).absoluteFilePath ())
+, UseCache_ (useCache)
+, Precompress_ (precompress)
+{
+}
+
+QString RepositoryIndexer::GetIndexPath () const
+{
+	return IndexPath_;
+}
+
+QString RepositoryIndexer::GetCachePath () const
+{
+	const QFileInfo fi (IndexPath_);
+	return fi.dir ().filePath ('.' + fi.fileName () + ".cache");
+}
+
+QStringList RepositoryIndexer::FindDescriptors (const QString& root, const QString& exclude)
+{
+	const QDir rootDir (root);
+	const QFileInfo excluded (exclude);
+
+	QStringList result;
+	QDirIterator it (root,
+			QStringList ("*.xml"),
+			QDir::Files,
+			QDirIterator::Subdirectories);
+	while (it.hasNext ())
+	{
+		const QString& path = it.next ();
+		const QFileInfo& fi = it.fileInfo ();
+		const QString& relativeDir = rootDir.relativeFilePath (fi.absolutePath ());
+		if (relativeDir == "." ||
+				relativeDir.split ('/').contains ("arch") ||
+				(!exclude.isEmpty () && fi == excluded))
+			continue;
+
+		result << path;
+	}
+	result.sort ();
+	return result;
+}
+
+RepositoryIndexer::Stats RepositoryIndexer::Rebuild ()
+{
+	const Cache_t& oldCache = UseCache_ ?
+			LoadCache (GetCachePath ()) :
+			Cache_t ();
+
+	const QDir root (Root_);
+	const QStringList& descriptors = FindDescriptors (Root_, IndexPath_);
+
+	std::function<IndexedPackage (const QString&)> func =
+		[&root, &oldCache] (const QString& path)
+		{
+			return IndexPackage (root, path, oldCache);
+		};
+	const QList<IndexedPackage>& packages =
+			QtConcurrent::blockingMapped<QList<IndexedPackage>> (descriptors, func);
+
+	Stats stats;
+	stats.Total_ = packages.size ();
+
+	Cache_t newCache;
+	bool cacheChanged = packages.size () != oldCache.size ();
+	QList<DependencyResolver::Package> graph;
+	QByteArray index ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<packages>\n");
+	Q_FOREACH (const IndexedPackage& package, packages)
+	{
+		switch (package.Outcome_)
+		{
+		case OCached:
+			++stats.Cached_;
+			break;
+		case OParsed:
+			++stats.Parsed_;
+			break;
+		case OError:
+			stats.Errors_ << package.Error_;
+			continue;
+		}
+
+		index += package.Entry_.Fragment_;
+		newCache [package.RelPath_] = package.Entry_;
+
+		DependencyResolver::Package node;
+		node.FileName_ = package.RelPath_;
+		node.Data_.Name_ = package.Entry_.Name_;
+		node.Data_.Versions_ = package.Entry_.Versions_;
+		node.Data_.Depends_ = package.Entry_.Depends_;
+		graph << node;
+
+		if (package.Outcome_ != OCached ||
+				package.Entry_.XmlMTime_ != oldCache.value (package.RelPath_).XmlMTime_)
+			cacheChanged = true;
+	}
+	index += MakeClosures (DependencyResolver (graph));
+	index += "</packages>\n";
+
+	QFile existing (IndexPath_);
+	if (existing.size () != index.size () ||
+			!existing.open (QIODevice::ReadOnly) ||
+			existing.readAll () != index)
+	{
+		existing.close ();
+
+		QSaveFile out (IndexPath_);
+		if (!out.open (QIODevice::WriteOnly) ||
+				out.write (index) != index.size () ||
+				!out.commit ())
+			throw std::runtime_error (tr ("Could not write repository index %1.")
+					.arg (IndexPath_)
+					.toUtf8 ().constData ());
+		stats.Written_ = true;
+	}
+
+	if (Precompress_)
+		stats.Precompressed_ = Precompressor::Update (IndexPath_, index);
+	else if (stats.Written_)
+		stats.Precompressed_ = Precompressor::Refresh (IndexPath_, index);
+
+	if (UseCache_ && (cacheChanged || newCache.size () != oldCache.size ()))
+		SaveCache (GetCachePath (), newCache);
+
+	return stats;
+}
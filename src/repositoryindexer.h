@@ -0,0 +1,85 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef REPOSITORYINDEXER_H
+#define REPOSITORYINDEXER_H
+#include <QCoreApplication>
+#include <QStringList>
+
+/** Builds the aggregate index of a repository made of many package
+ * directories.
+ *
+ * Every package description found under the repository root is
+ * parsed in parallel, and the resulting index fragments are cached in
+ * a file next to the index, keyed on the description's size, mtime and
+ * content hash and on the archiver, size and mtime of the archive of
+ * each of its versions. Packages that haven't changed since the last
+ * run are not parsed again.
+ *
+ * The index also carries the transitive closure of the requirements
+ * of every package version, computed over the whole repository, so
+ * that clients don't have to resolve the requirements level by level.
+ */
+class RepositoryIndexer
+{
+	Q_DECLARE_TR_FUNCTIONS (RepositoryIndexer)
+public:
+	struct Stats
+	{
+		int Total_;
+		int Parsed_;
+		int Cached_;
+		QStringList Errors_;
+		bool Written_;
+		bool Precompressed_;
+
+		Stats ();
+	};
+private:
+	QString Root_;
+	QString IndexPath_;
+	bool UseCache_;
+	bool Precompress_;
+public:
+	/** If indexPath is empty, the index is written to Packages.xml
+	 * in the repository root. If precompress is true, compressed
+	 * copies of the index are kept next to it by Precompressor.
+	 */
+	RepositoryIndexer (const QString& root,
+			const QString& indexPath = QString (), bool useCache = true,
+			bool precompress = false);
+
+	/** Rebuilds the index, throwing std::runtime_error if it or the
+	 * cache could not be written. Packages that fail to load are
+	 * reported in Stats::Errors_ and left out of the index.
+	 */
+	Stats Rebuild ();
+
+	QString GetIndexPath () const;
+	QString GetCachePath () const;
+
+	/** Returns the absolute paths of all package descriptions under
+	 * the given repository root, skipping the root itself (where
+	 * the repository-wide files live), everything under arch/
+	 * subdirectories and the exclude file, like the index itself.
+	 */
+	static QStringList FindDescriptors (const QString& root,
+			const QString& exclude = QString ());
+};
+
+#endif
@@ -0,0 +1,177 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "sidecarcache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStringList>
+#include "tracing.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const char Header [] = "lcpackgen-sidecar 1";
+
+	/** Returns the lock serializing the updates of the given sidecar
+	 * within this process. The locks are never freed, but there is
+	 * one per archive directory at most.
+	 */
+	QMutex& GetMutex (const QString& path)
+	{
+		static QMutex guard;
+		static QHash<QString, QMutex*> mutexes;
+
+		QMutexLocker locker (&guard);
+		QMutex *& mutex = mutexes [path];
+		if (!mutex)
+			mutex = new QMutex;
+		return *mutex;
+	}
+}
+
+bool SidecarCache::Key::operator== (const Key& other) const
+{
+	return Size_ == other.Size_ &&
+			MTime_ == other.MTime_ &&
+			Inode_ == other.Inode_;
+}
+
+bool SidecarCache::Key::operator!= (const Key& other) const
+{
+	return !(*this == other);
+}
+
+SidecarCache::SidecarCache (const QString& archDir, const QString& name)
+: ArchDir_ (archDir)
+, Path_ (QDir (archDir).filePath (name))
+{
+	QFile file (Path_);
+	if (!file.open (QIODevice::ReadOnly) ||
+			file.readLine ().trimmed () != Header)
+		return;
+
+	while (!file.atEnd ())
+	{
+		QByteArray line = file.readLine ();
+		if (line.endsWith ('\n'))
+			line.chop (1);
+
+		// The file name is the rest of the line and may contain
+		// spaces, even leading and trailing ones, so only the first
+		// four spaces separate the fields.
+		int fieldEnds [4];
+		int pos = -1;
+		for (int i = 0; i < 4 && (pos = line.indexOf (' ', pos + 1)) != -1; ++i)
+			fieldEnds [i] = pos;
+		if (pos == -1 || pos + 1 == line.size ())
+			continue;
+
+		Entry entry;
+		entry.Key_.Size_ = line.left (fieldEnds [0]).toLongLong ();
+		entry.Key_.MTime_ = line.mid (fieldEnds [0] + 1, fieldEnds [1] - fieldEnds [0] - 1).toLongLong ();
+		entry.Key_.Inode_ = line.mid (fieldEnds [1] + 1, fieldEnds [2] - fieldEnds [1] - 1).toULongLong ();
+		entry.Value_ = line.mid (fieldEnds [2] + 1, fieldEnds [3] - fieldEnds [2] - 1);
+		Entries_ [QString::fromUtf8 (line.mid (fieldEnds [3] + 1))] = entry;
+	}
+}
+
+SidecarCache::Key SidecarCache::GetKey (const QString& path)
+{
+	LC_TRACE_COUNT (CFilesystemProbes, 1);
+	const QFileInfo fi (path);
+	Key key = { fi.size (), fi.lastModified ().toMSecsSinceEpoch (), 0 };
+#ifdef Q_OS_UNIX
+	struct stat st;
+	if (!::stat (QFile::encodeName (path).constData (), &st))
+		key.Inode_ = st.st_ino;
+#endif
+	return key;
+}
+
+QByteArray SidecarCache::Find (const QString& path, const Key& key) const
+{
+	const QHash<QString, Entry>::const_iterator pos = Entries_.find (QFileInfo (path).fileName ());
+	if (pos == Entries_.end () || pos->Key_ != key)
+		return QByteArray ();
+	return pos->Value_;
+}
+
+void SidecarCache::Insert (const QString& path, const Key& key, const QByteArray& value)
+{
+	const Entry entry = { key, value };
+	Pending_ [QFileInfo (path).fileName ()] = entry;
+}
+
+void SidecarCache::Save ()
+{
+	if (Pending_.isEmpty ())
+		return;
+
+	QMutexLocker locker (&GetMutex (Path_));
+
+	// Other processes may be updating the same directory as well.
+	QLockFile lock (Path_ + ".lock");
+	if (!lock.tryLock (10000))
+		return;
+
+	// Reload the sidecar, since others could have updated it since
+	// it was loaded.
+	QHash<QString, Entry> entries = SidecarCache (ArchDir_, QFileInfo (Path_).fileName ()).Entries_;
+
+	// Only the touched entries are checked. Don't cache the results
+	// for the files that changed or vanished while being processed,
+	// they'll be processed again next time.
+	const QDir dir (ArchDir_);
+	for (QHash<QString, Entry>::const_iterator i = Pending_.begin (); i != Pending_.end (); ++i)
+		if (GetKey (dir.filePath (i.key ())) == i->Key_)
+			entries [i.key ()] = *i;
+		else
+			entries.remove (i.key ());
+
+	Entries_ = entries;
+	Pending_.clear ();
+
+	QByteArray contents = QByteArray (Header) + '\n';
+	QStringList names = entries.keys ();
+	names.sort ();
+	Q_FOREACH (const QString& name, names)
+	{
+		const Entry& entry = entries [name];
+		contents += QByteArray::number (entry.Key_.Size_) + ' ' +
+				QByteArray::number (entry.Key_.MTime_) + ' ' +
+				QByteArray::number (entry.Key_.Inode_) + ' ' +
+				entry.Value_ + ' ' +
+				name.toUtf8 () + '\n';
+	}
+
+	QSaveFile file (Path_);
+	if (file.open (QIODevice::WriteOnly))
+	{
+		file.write (contents);
+		file.commit ();
+	}
+}
@@ -0,0 +1,87 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef SIDECARCACHE_H
+#define SIDECARCACHE_H
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+/** Per-archive results cached in a sidecar file in an archive
+ * directory, keyed on the file name, size, mtime and inode of each
+ * archive, so that unchanged archives are never read again.
+ *
+ * The sidecar is shared by all the packages using the directory, so
+ * Save() merges the new results into whatever is on disk at that
+ * moment, holding both an in-process lock and a lock file for the
+ * sidecar, and nothing stored by parallel jobs gets lost.
+ */
+class SidecarCache
+{
+public:
+	struct Key
+	{
+		qint64 Size_;
+		qint64 MTime_;
+		quint64 Inode_;
+
+		bool operator== (const Key& other) const;
+		bool operator!= (const Key& other) const;
+	};
+private:
+	struct Entry
+	{
+		Key Key_;
+		QByteArray Value_;
+	};
+
+	const QString ArchDir_;
+	const QString Path_;
+	QHash<QString, Entry> Entries_;
+	QHash<QString, Entry> Pending_;
+public:
+	/** Loads the sidecar with the given file name from the given
+	 * archive directory.
+	 */
+	SidecarCache (const QString& archDir, const QString& name);
+
+	static Key GetKey (const QString& path);
+
+	/** Returns the value cached for the archive at the given path if
+	 * it still has the given key, or a null array otherwise.
+	 */
+	QByteArray Find (const QString& path, const Key& key) const;
+
+	/** Records the value computed for the archive at the given path,
+	 * which had the given key before the computation started. Values
+	 * can't contain whitespace.
+	 */
+	void Insert (const QString& path, const Key& key, const QByteArray& value);
+
+	/** Merges the recorded values into the sidecar on disk, dropping
+	 * those for archives that changed or vanished since their key was
+	 * taken. Only the archives having recorded values are looked at:
+	 * entries for other archives that are gone just never match again.
+	 *
+	 * The cache is just an optimization, so failing to write it is
+	 * not an error.
+	 */
+	void Save ();
+};
+
+#endif
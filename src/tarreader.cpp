@@ -0,0 +1,295 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "tarreader.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <QFile>
+#include "decompressor.h"
+
+namespace
+{
+	const int BlockSize = 512;
+
+	qint64 PaddingFor (qint64 size)
+	{
+		return (BlockSize - size % BlockSize) % BlockSize;
+	}
+
+	QByteArray GetField (const char *field, int size)
+	{
+		return QByteArray (field, qstrnlen (field, size));
+	}
+
+	bool ParseNumber (const char *field, int size, qint64& result)
+	{
+		// Numbers not fitting into the octal field are stored in the
+		// base-256 GNU extension.
+		if (static_cast<unsigned char> (field [0]) & 0x80)
+		{
+			result = field [0] & 0x3f;
+			for (int i = 1; i < size; ++i)
+				result = (result << 8) | static_cast<unsigned char> (field [i]);
+			return true;
+		}
+
+		const QByteArray& str = GetField (field, size).trimmed ();
+		if (str.isEmpty ())
+		{
+			result = 0;
+			return true;
+		}
+
+		bool ok = false;
+		result = str.toLongLong (&ok, 8);
+		return ok;
+	}
+
+	bool IsChecksumValid (const char *header)
+	{
+		qint64 stored = 0;
+		if (!ParseNumber (header + 148, 8, stored))
+			return false;
+
+		// Some old implementations summed signed chars.
+		qint64 unsignedSum = 0;
+		qint64 signedSum = 0;
+		for (int i = 0; i < BlockSize; ++i)
+		{
+			const bool inChecksum = i >= 148 && i < 156;
+			unsignedSum += inChecksum ? ' ' : static_cast<unsigned char> (header [i]);
+			signedSum += inChecksum ? ' ' : static_cast<signed char> (header [i]);
+		}
+		return stored == unsignedSum || stored == signedSum;
+	}
+
+	bool IsZeroBlock (const char *block)
+	{
+		return std::all_of (block, block + BlockSize, [] (char c) { return !c; });
+	}
+}
+
+TarEntry::TarEntry ()
+: Type_ ('0')
+, Size_ (0)
+, Mode_ (0)
+, MTime_ (0)
+{
+}
+
+TarReader::TarReader (ByteSource *source)
+: Source_ (source)
+, Remaining_ (0)
+, Padding_ (0)
+, Finished_ (false)
+{
+}
+
+bool TarReader::Next (TarEntry& entry)
+{
+	if (Finished_)
+		return false;
+
+	Skip (Remaining_ + Padding_);
+	Remaining_ = 0;
+	Padding_ = 0;
+
+	QByteArray longName;
+	QByteArray longLink;
+	QByteArray paxPath;
+	QByteArray paxLink;
+	qint64 paxSize = -1;
+
+	char header [BlockSize];
+	while (true)
+	{
+		if (!ReadBlock (header))
+			throw std::runtime_error (tr ("The archive is truncated.")
+					.toUtf8 ().constData ());
+
+		if (IsZeroBlock (header))
+		{
+			// The end of the archive is marked by two zero blocks,
+			// but some implementations write only one.
+			if (ReadBlock (header) && !IsZeroBlock (header))
+				throw std::runtime_error (tr ("Unexpected data after a zero block.")
+						.toUtf8 ().constData ());
+			Finished_ = true;
+			return false;
+		}
+
+		if (!IsChecksumValid (header))
+			throw std::runtime_error (tr ("Invalid tar header checksum.")
+					.toUtf8 ().constData ());
+
+		qint64 size = 0;
+		qint64 mtime = 0;
+		qint64 mode = 0;
+		if (!ParseNumber (header + 124, 12, size) ||
+				!ParseNumber (header + 136, 12, mtime) ||
+				!ParseNumber (header + 100, 8, mode) ||
+				size < 0)
+			throw std::runtime_error (tr ("Malformed tar header.")
+					.toUtf8 ().constData ());
+
+		const char type = header [156];
+		switch (type)
+		{
+		case 'L':
+			longName = ReadLongData (size);
+			continue;
+		case 'K':
+			longLink = ReadLongData (size);
+			continue;
+		case 'x':
+		{
+			const QByteArray& records = ReadLongData (size);
+			int pos = 0;
+			while (pos < records.size ())
+			{
+				const int space = records.indexOf (' ', pos);
+				const int length = space > pos ? records.mid (pos, space - pos).toInt () : 0;
+				if (length <= 0 || pos + length > records.size ())
+					throw std::runtime_error (tr ("Malformed pax header.")
+							.toUtf8 ().constData ());
+
+				const QByteArray& record = records.mid (space + 1, pos + length - space - 2);
+				const int eq = record.indexOf ('=');
+				const QByteArray& key = record.left (eq);
+				const QByteArray& value = record.mid (eq + 1);
+				if (key == "path")
+					paxPath = value;
+				else if (key == "linkpath")
+					paxLink = value;
+				else if (key == "size")
+					paxSize = value.toLongLong ();
+
+				pos += length;
+			}
+			continue;
+		}
+		case 'g':
+			Skip (size + PaddingFor (size));
+			continue;
+		default:
+			break;
+		}
+
+		QByteArray name = GetField (header, 100);
+		const QByteArray& prefix = GetField (header + 345, 155);
+		if (!std::memcmp (header + 257, "ustar", 5) && !prefix.isEmpty ())
+			name = prefix + '/' + name;
+
+		if (!paxPath.isEmpty ())
+			name = paxPath;
+		else if (!longName.isEmpty ())
+			name = longName;
+
+		QByteArray link = GetField (header + 157, 100);
+		if (!paxLink.isEmpty ())
+			link = paxLink;
+		else if (!longLink.isEmpty ())
+			link = longLink;
+
+		if (paxSize >= 0)
+			size = paxSize;
+
+		entry.Name_ = QFile::decodeName (name);
+		entry.Type_ = type ? type : '0';
+		entry.Size_ = size;
+		entry.Mode_ = mode;
+		entry.MTime_ = mtime;
+		entry.LinkName_ = QFile::decodeName (link);
+
+		// Only regular files have contents, even if the size field
+		// says otherwise for links.
+		Remaining_ = type == '1' || type == '2' || type == '5' ? 0 : size;
+		Padding_ = PaddingFor (Remaining_);
+		return true;
+	}
+}
+
+qint64 TarReader::ReadData (char *data, qint64 maxSize)
+{
+	const qint64 toRead = std::min (maxSize, Remaining_);
+	if (!toRead)
+		return 0;
+
+	ReadExactly (data, toRead);
+	Remaining_ -= toRead;
+	return toRead;
+}
+
+bool TarReader::ReadBlock (char *block)
+{
+	qint64 read = 0;
+	while (read < BlockSize)
+	{
+		const qint64 chunk = Source_->Read (block + read, BlockSize - read);
+		if (!chunk)
+			break;
+		read += chunk;
+	}
+
+	if (read && read < BlockSize)
+		throw std::runtime_error (tr ("The archive is truncated.")
+				.toUtf8 ().constData ());
+	return read;
+}
+
+void TarReader::ReadExactly (char *data, qint64 size)
+{
+	while (size)
+	{
+		const qint64 chunk = Source_->Read (data, size);
+		if (!chunk)
+			throw std::runtime_error (tr ("The archive is truncated.")
+					.toUtf8 ().constData ());
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+void TarReader::Skip (qint64 size)
+{
+	char buffer [64 * 1024];
+	while (size)
+	{
+		const qint64 chunk = std::min<qint64> (size, sizeof (buffer));
+		ReadExactly (buffer, chunk);
+		size -= chunk;
+	}
+}
+
+QByteArray TarReader::ReadLongData (qint64 size)
+{
+	// Long names and extended headers are never legitimately huge.
+	if (size > 1024 * 1024)
+		throw std::runtime_error (tr ("Extended tar header is too long.")
+				.toUtf8 ().constData ());
+
+	QByteArray data (size, 0);
+	ReadExactly (data.data (), size);
+	Skip (PaddingFor (size));
+
+	const int nul = data.indexOf ('\0');
+	if (nul >= 0)
+		data.truncate (nul);
+	return data;
+}
@@ -0,0 +1,84 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef TARREADER_H
+#define TARREADER_H
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QString>
+
+class ByteSource;
+
+struct TarEntry
+{
+	QString Name_;
+
+	/** The type flag of the entry: '0' for regular files, '2' for
+	 * symlinks, '5' for directories and so on.
+	 */
+	char Type_;
+
+	qint64 Size_;
+	uint Mode_;
+	qint64 MTime_;
+	QString LinkName_;
+
+	TarEntry ();
+};
+
+/** Streaming reader of tar archives.
+ *
+ * The archive is read from a ByteSource (usually a Decompressor)
+ * header by header, and the contents of the entries are either read
+ * in chunks or skipped, so nothing is ever extracted or buffered
+ * whole. The ustar, GNU long name and pax path and size extensions
+ * are understood, which covers whatever TarWriter and the usual tar
+ * implementations produce.
+ *
+ * Malformed headers and truncated archives are reported by throwing
+ * std::runtime_error.
+ */
+class TarReader
+{
+	Q_DECLARE_TR_FUNCTIONS (TarReader)
+
+	ByteSource * const Source_;
+	qint64 Remaining_;
+	qint64 Padding_;
+	bool Finished_;
+public:
+	explicit TarReader (ByteSource *source);
+
+	/** Reads the header of the next entry, skipping whatever is left
+	 * of the contents of the current one. Returns false at the end of
+	 * the archive.
+	 */
+	bool Next (TarEntry&);
+
+	/** Reads up to maxSize bytes of the contents of the current
+	 * entry, returning 0 at the end of the entry.
+	 */
+	qint64 ReadData (char *data, qint64 maxSize);
+private:
+	bool ReadBlock (char *block);
+	void ReadExactly (char *data, qint64 size);
+	void Skip (qint64 size);
+	QByteArray ReadLongData (qint64 size);
+};
+
+#endif
@@ -0,0 +1,242 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "tarwriter.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include "compressor.h"
+
+namespace
+{
+	const int BlockSize = 512;
+	const int RecordSize = BlockSize * 20;
+	const qint64 CopyChunk = 1024 * 1024;
+
+	void WriteOctal (char *field, int length, quint64 value)
+	{
+		// Values that don't fit into length - 1 octal digits are
+		// stored in the base-256 GNU extension.
+		if (value >> (3 * (length - 1)))
+		{
+			std::memset (field, 0, length);
+			field [0] = static_cast<char> (0x80);
+			for (int i = length - 1; i > 0 && value; --i, value >>= 8)
+				field [i] = static_cast<char> (value & 0xff);
+			return;
+		}
+
+		field [length - 1] = '\0';
+		for (int i = length - 2; i >= 0; --i, value >>= 3)
+			field [i] = '0' + (value & 7);
+	}
+
+	void CopyField (char *field, int length, const QByteArray& value)
+	{
+		std::memcpy (field, value.constData (), std::min (length, value.size ()));
+	}
+
+	uint GetMode (const QFileInfo& fi)
+	{
+		const QFile::Permissions perms = fi.permissions ();
+		uint mode = 0;
+		if (perms & QFile::ReadOwner)
+			mode |= 0400;
+		if (perms & QFile::WriteOwner)
+			mode |= 0200;
+		if (perms & QFile::ExeOwner)
+			mode |= 0100;
+		if (perms & QFile::ReadGroup)
+			mode |= 0040;
+		if (perms & QFile::WriteGroup)
+			mode |= 0020;
+		if (perms & QFile::ExeGroup)
+			mode |= 0010;
+		if (perms & QFile::ReadOther)
+			mode |= 0004;
+		if (perms & QFile::WriteOther)
+			mode |= 0002;
+		if (perms & QFile::ExeOther)
+			mode |= 0001;
+		return mode;
+	}
+}
+
+TarWriter::TarWriter (ByteSink *sink)
+: Sink_ (sink)
+, Written_ (0)
+{
+}
+
+void TarWriter::AddDirectoryContents (const QString& dirPath)
+{
+	const QDir dir (dirPath);
+	if (!dir.exists ())
+		throw std::runtime_error (tr ("Directory %1 does not exist.")
+				.arg (dirPath)
+				.toUtf8 ().constData ());
+
+	QStringList names;
+	QDirIterator it (dirPath,
+			QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+			QDirIterator::Subdirectories);
+	while (it.hasNext ())
+		names << dir.relativeFilePath (it.next ());
+	names.sort ();
+
+	Q_FOREACH (const QString& name, names)
+		AddEntry (QFileInfo (dir.filePath (name)), name);
+}
+
+void TarWriter::AddEntry (const QFileInfo& fi, const QString& name)
+{
+	const qint64 mtime = fi.lastModified ().toMSecsSinceEpoch () / 1000;
+	const uint mode = GetMode (fi);
+
+	if (fi.isSymLink ())
+	{
+		const QString& target = fi.dir ().relativeFilePath (fi.symLinkTarget ());
+		WriteHeader (QFile::encodeName (name), '2', 0, mode, mtime, QFile::encodeName (target));
+		return;
+	}
+
+	if (fi.isDir ())
+	{
+		WriteHeader (QFile::encodeName (name) + '/', '5', 0, mode, mtime);
+		return;
+	}
+
+	if (!fi.isFile ())
+		return;
+
+	QFile file (fi.filePath ());
+	if (!file.open (QIODevice::ReadOnly))
+		throw std::runtime_error (tr ("Unable to open file %1 for reading.")
+				.arg (fi.filePath ())
+				.toUtf8 ().constData ());
+
+	const qint64 size = file.size ();
+	WriteHeader (QFile::encodeName (name), '0', size, mode, mtime);
+
+	qint64 left = size;
+	while (left > 0)
+	{
+		const QByteArray& chunk = file.read (std::min (left, CopyChunk));
+		if (chunk.isEmpty ())
+			throw std::runtime_error (tr ("Unable to read file %1: it has been truncated or is unreadable.")
+					.arg (fi.filePath ())
+					.toUtf8 ().constData ());
+
+		WriteBlock (chunk.constData (), chunk.size ());
+		left -= chunk.size ();
+	}
+	PadToBlock ();
+}
+
+void TarWriter::Finish ()
+{
+	const QByteArray zeros (2 * BlockSize, 0);
+	WriteBlock (zeros.constData (), zeros.size ());
+
+	const qint64 rest = Written_ % RecordSize;
+	if (rest)
+	{
+		const QByteArray padding (RecordSize - rest, 0);
+		WriteBlock (padding.constData (), padding.size ());
+	}
+}
+
+void TarWriter::WriteHeader (const QByteArray& name, char type, qint64 size,
+		uint mode, qint64 mtime, const QByteArray& linkName)
+{
+	if (linkName.size () > 100)
+		WriteLongName ('K', linkName);
+
+	QByteArray prefix;
+	QByteArray shortName = name;
+	if (name.size () > 100)
+	{
+		// Try splitting the name into the prefix and the name
+		// fields at a slash, as ustar allows.
+		const int slash = name.lastIndexOf ('/', std::min (155, name.size () - 2));
+		if (slash > 0 && name.size () - slash - 1 <= 100)
+		{
+			prefix = name.left (slash);
+			shortName = name.mid (slash + 1);
+		}
+		else
+		{
+			WriteLongName ('L', name);
+			shortName = name.left (100);
+		}
+	}
+
+	char header [BlockSize];
+	std::memset (header, 0, sizeof (header));
+
+	CopyField (header, 100, shortName);
+	WriteOctal (header + 100, 8, mode);
+	WriteOctal (header + 108, 8, 0);
+	WriteOctal (header + 116, 8, 0);
+	WriteOctal (header + 124, 12, size);
+	WriteOctal (header + 136, 12, mtime);
+	header [156] = type;
+	CopyField (header + 157, 100, linkName);
+	std::memcpy (header + 257, "ustar", 6);
+	std::memcpy (header + 263, "00", 2);
+	CopyField (header + 265, 32, "root");
+	CopyField (header + 297, 32, "root");
+	CopyField (header + 345, 155, prefix);
+
+	std::memset (header + 148, ' ', 8);
+	unsigned int checksum = 0;
+	for (int i = 0; i < BlockSize; ++i)
+		checksum += static_cast<unsigned char> (header [i]);
+	WriteOctal (header + 148, 7, checksum);
+
+	WriteBlock (header, BlockSize);
+}
+
+void TarWriter::WriteLongName (char type, const QByteArray& name)
+{
+	const QByteArray& data = name + '\0';
+	WriteHeader ("././@LongLink", type, data.size (), 0644, 0);
+	WriteBlock (data.constData (), data.size ());
+	PadToBlock ();
+}
+
+void TarWriter::WriteBlock (const char *data, qint64 size)
+{
+	Sink_->Write (data, size);
+	Written_ += size;
+}
+
+void TarWriter::PadToBlock ()
+{
+	const qint64 rest = Written_ % BlockSize;
+	if (!rest)
+		return;
+
+	const QByteArray padding (BlockSize - rest, 0);
+	WriteBlock (padding.constData (), padding.size ());
+}
@@ -0,0 +1,68 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef TARWRITER_H
+#define TARWRITER_H
+#include <QCoreApplication>
+#include <QByteArray>
+#include <QString>
+
+class ByteSink;
+class QFileInfo;
+
+/** Streaming writer of POSIX ustar archives.
+ *
+ * The archive is written into a ByteSink as it is produced (usually a
+ * Compressor), file contents are copied in fixed-size chunks, so the
+ * memory usage doesn't depend on the size of the archived files.
+ * Names that don't fit into ustar headers are stored using GNU long
+ * name records.
+ */
+class TarWriter
+{
+	Q_DECLARE_TR_FUNCTIONS (TarWriter)
+
+	ByteSink * const Sink_;
+	qint64 Written_;
+public:
+	explicit TarWriter (ByteSink *sink);
+
+	/** Recursively adds the contents of the given directory, with
+	 * the names relative to it. Entries are added in sorted order,
+	 * so the same tree always produces the same archive.
+	 */
+	void AddDirectoryContents (const QString& dir);
+
+	/** Adds a single filesystem entry (a file, a directory or a
+	 * symlink) under the given name.
+	 */
+	void AddEntry (const QFileInfo& fi, const QString& name);
+
+	/** Writes the end-of-archive marker and pads the archive to the
+	 * full record size.
+	 */
+	void Finish ();
+private:
+	void WriteHeader (const QByteArray& name, char type, qint64 size,
+			uint mode, qint64 mtime, const QByteArray& linkName = QByteArray ());
+	void WriteLongName (char type, const QByteArray& name);
+	void WriteBlock (const char*, qint64);
+	void PadToBlock ();
+};
+
+#endif
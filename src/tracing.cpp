@@ -0,0 +1,301 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "tracing.h"
+
+#ifdef LCPACKGEN_TRACING
+
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QTextStream>
+
+namespace
+{
+	struct Event
+	{
+		const char *Name_;
+		qint64 Begin_;
+		qint64 Duration_;
+	};
+
+	/** Written only by its own thread, read by Finish() once the
+	 * workers are done. Old events are overwritten when it wraps.
+	 */
+	struct RingBuffer
+	{
+		enum { Capacity = 1 << 16 };
+
+		int ThreadId_;
+		std::atomic<quint64> Written_;
+		Event Events_ [Capacity];
+
+		explicit RingBuffer (int threadId)
+		: ThreadId_ (threadId)
+		, Written_ (0)
+		{
+		}
+	};
+
+	bool Enabled = false;
+	QString TraceFile;
+	QElapsedTimer Clock;
+	std::atomic<qint64> Counters [Tracing::CCount];
+
+	QMutex BuffersMutex;
+
+	// Buffers are never freed: threads of the pool may outlive any
+	// reasonable owner, and the events must survive their threads.
+	std::vector<RingBuffer*> Buffers;
+
+	RingBuffer* GetBuffer ()
+	{
+		static thread_local RingBuffer *buffer = 0;
+		if (!buffer)
+		{
+			QMutexLocker locker (&BuffersMutex);
+			buffer = new RingBuffer (Buffers.size () + 1);
+			Buffers.push_back (buffer);
+		}
+		return buffer;
+	}
+
+	std::vector<std::pair<int, Event>> CollectEvents ()
+	{
+		std::vector<std::pair<int, Event>> result;
+
+		QMutexLocker locker (&BuffersMutex);
+		for (RingBuffer *buffer : Buffers)
+		{
+			const quint64 written = buffer->Written_.load (std::memory_order_acquire);
+			const quint64 first = written > RingBuffer::Capacity ? written - RingBuffer::Capacity : 0;
+			for (quint64 i = first; i < written; ++i)
+				result.push_back ({ buffer->ThreadId_, buffer->Events_ [i % RingBuffer::Capacity] });
+		}
+		return result;
+	}
+
+	const char *CounterName (Tracing::Counter counter)
+	{
+		switch (counter)
+		{
+		case Tracing::CXmlBytesParsed:
+			return "XML bytes parsed";
+		case Tracing::CFilesystemProbes:
+			return "filesystem probes";
+		case Tracing::CRulesEvaluated:
+			return "rules evaluated";
+		case Tracing::CCount:
+			break;
+		}
+		return "";
+	}
+
+	QByteArray EscapeJson (const char *str)
+	{
+		QByteArray result;
+		for (; *str; ++str)
+			if (*str == '"' || *str == '\\')
+				result += QByteArray ("\\") + *str;
+			else
+				result += *str;
+		return result;
+	}
+}
+
+Tracing::Scope::Scope (const char *name)
+: Name_ (name)
+, Begin_ (Enabled ? Clock.nsecsElapsed () : 0)
+{
+}
+
+Tracing::Scope::~Scope ()
+{
+	if (!Enabled)
+		return;
+
+	RingBuffer *buffer = GetBuffer ();
+	const quint64 pos = buffer->Written_.load (std::memory_order_relaxed);
+	buffer->Events_ [pos % RingBuffer::Capacity] = { Name_, Begin_, Clock.nsecsElapsed () - Begin_ };
+	buffer->Written_.store (pos + 1, std::memory_order_release);
+}
+
+bool Tracing::IsEnabled ()
+{
+	return Enabled;
+}
+
+void Tracing::InitFromEnvironment ()
+{
+	TraceFile = QString::fromLocal8Bit (qgetenv ("LCPACKGEN_TRACE"));
+	if (TraceFile.isEmpty ())
+		return;
+
+	Clock.start ();
+	Enabled = true;
+}
+
+void Tracing::Count (Counter counter, qint64 value)
+{
+	if (Enabled)
+		Counters [counter].fetch_add (value, std::memory_order_relaxed);
+}
+
+bool Tracing::WriteChromeTrace (const QString& fileName)
+{
+	const qint64 pid = QCoreApplication::applicationPid ();
+
+	QByteArray json = "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const auto& pair : CollectEvents ())
+	{
+		if (!first)
+			json += ",\n";
+		first = false;
+
+		// Chrome expects microseconds, fractional ones are fine.
+		json += "{\"name\":\"" + EscapeJson (pair.second.Name_) +
+				"\",\"ph\":\"X\",\"pid\":" + QByteArray::number (pid) +
+				",\"tid\":" + QByteArray::number (pair.first) +
+				",\"ts\":" + QByteArray::number (pair.second.Begin_ / 1000.0, 'f', 3) +
+				",\"dur\":" + QByteArray::number (pair.second.Duration_ / 1000.0, 'f', 3) + '}';
+	}
+
+	const qint64 now = Clock.nsecsElapsed ();
+	for (int i = 0; i < CCount; ++i)
+	{
+		if (!first)
+			json += ",\n";
+		first = false;
+
+		json += QByteArray ("{\"name\":\"") + CounterName (static_cast<Counter> (i)) +
+				"\",\"ph\":\"C\",\"pid\":" + QByteArray::number (pid) +
+				",\"ts\":" + QByteArray::number (now / 1000.0, 'f', 3) +
+				",\"args\":{\"value\":" + QByteArray::number (Counters [i].load ()) + "}}";
+	}
+	json += "\n]}\n";
+
+	QSaveFile file (fileName);
+	return file.open (QIODevice::WriteOnly) &&
+			file.write (json) == json.size () &&
+			file.commit ();
+}
+
+void Tracing::WriteSummary (QTextStream& out)
+{
+	struct Stats
+	{
+		qint64 Calls_;
+		qint64 Total_;
+		qint64 Max_;
+	};
+
+	// Names are string literals, but the same literal may have
+	// different addresses in different translation units.
+	QHash<QByteArray, Stats> stats;
+	for (const auto& pair : CollectEvents ())
+	{
+		Stats& s = stats [QByteArray (pair.second.Name_)];
+		++s.Calls_;
+		s.Total_ += pair.second.Duration_;
+		s.Max_ = std::max (s.Max_, pair.second.Duration_);
+	}
+
+	QList<QByteArray> names = stats.keys ();
+	std::sort (names.begin (), names.end (),
+			[&stats] (const QByteArray& left, const QByteArray& right)
+				{ return stats [left].Total_ > stats [right].Total_; });
+
+	out << qSetFieldWidth (40) << left << tr ("scope")
+			<< qSetFieldWidth (10) << right << tr ("calls")
+			<< qSetFieldWidth (14) << tr ("total ms")
+			<< tr ("mean us")
+			<< tr ("max us")
+			<< qSetFieldWidth (0) << endl;
+	Q_FOREACH (const QByteArray& name, names)
+	{
+		const Stats& s = stats [name];
+		out << qSetFieldWidth (40) << left << QString::fromUtf8 (name)
+				<< qSetFieldWidth (10) << right << s.Calls_
+				<< qSetFieldWidth (14) << QString::number (s.Total_ / 1e6, 'f', 3)
+				<< QString::number (s.Total_ / 1e3 / s.Calls_, 'f', 1)
+				<< QString::number (s.Max_ / 1e3, 'f', 1)
+				<< qSetFieldWidth (0) << endl;
+	}
+
+	for (int i = 0; i < CCount; ++i)
+		out << qSetFieldWidth (40) << left << CounterName (static_cast<Counter> (i))
+				<< qSetFieldWidth (10) << right << Counters [i].load ()
+				<< qSetFieldWidth (0) << endl;
+}
+
+void Tracing::Finish ()
+{
+	if (!Enabled)
+		return;
+
+	QTextStream err (stderr);
+	WriteSummary (err);
+	if (!WriteChromeTrace (TraceFile))
+		err << tr ("Could not write the trace to %1.").arg (TraceFile) << endl;
+}
+
+#else
+
+Tracing::Scope::Scope (const char *name)
+: Name_ (name)
+, Begin_ (0)
+{
+}
+
+Tracing::Scope::~Scope ()
+{
+}
+
+bool Tracing::IsEnabled ()
+{
+	return false;
+}
+
+void Tracing::InitFromEnvironment ()
+{
+}
+
+void Tracing::Count (Counter, qint64)
+{
+}
+
+bool Tracing::WriteChromeTrace (const QString&)
+{
+	return false;
+}
+
+void Tracing::WriteSummary (QTextStream&)
+{
+}
+
+void Tracing::Finish ()
+{
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef TRACING_H
+#define TRACING_H
+#include <QCoreApplication>
+#include <QString>
+
+class QTextStream;
+
+/** Lightweight tracing of the hot paths.
+ *
+ * Scoped timers record their begin and duration into a ring buffer
+ * owned by the current thread, so recording never takes a lock, and
+ * counters are plain relaxed atomics. Everything is compiled in only
+ * with the ENABLE_TRACING CMake option, otherwise the LC_TRACE_*
+ * macros expand to nothing.
+ *
+ * When compiled in, tracing is enabled at runtime by setting the
+ * LCPACKGEN_TRACE environment variable to the path of the Chrome
+ * trace JSON file to write at exit (loadable in chrome://tracing or
+ * Perfetto); a summary table is printed to stderr as well.
+ */
+class Tracing
+{
+	Q_DECLARE_TR_FUNCTIONS (Tracing)
+public:
+	enum Counter
+	{
+		CXmlBytesParsed,
+		CFilesystemProbes,
+		CRulesEvaluated,
+		CCount
+	};
+
+	class Scope
+	{
+		const char * const Name_;
+		const qint64 Begin_;
+	public:
+		explicit Scope (const char *name);
+		~Scope ();
+	};
+
+	static bool IsEnabled ();
+
+	/** Enables tracing if LCPACKGEN_TRACE is set. Called once at
+	 * startup, before any thread is spawned.
+	 */
+	static void InitFromEnvironment ();
+
+	static void Count (Counter, qint64 value);
+
+	/** Writes everything recorded so far in the Chrome trace event
+	 * format, returning false on failure.
+	 */
+	static bool WriteChromeTrace (const QString& fileName);
+
+	/** Prints the number of calls, the total, mean and maximum
+	 * durations of each scope, and the counters.
+	 */
+	static void WriteSummary (QTextStream&);
+
+	/** Writes the trace file and the summary, if tracing is enabled.
+	 */
+	static void Finish ();
+};
+
+#ifdef LCPACKGEN_TRACING
+#define LC_TRACE_CONCAT_IMPL(a, b) a##b
+#define LC_TRACE_CONCAT(a, b) LC_TRACE_CONCAT_IMPL(a, b)
+#define LC_TRACE_SCOPE(name) const Tracing::Scope LC_TRACE_CONCAT(traceScope, __LINE__) (name)
+#define LC_TRACE_COUNT(counter, value) Tracing::Count (Tracing::counter, value)
+#else
+#define LC_TRACE_SCOPE(name) do {} while (0)
+#define LC_TRACE_COUNT(counter, value) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "versionkey.h"
+#include <cstring>
+#include <algorithm>
+#include <QVector>
+
+namespace
+{
+	// Segment tags, in the order the segments sort in.
+	enum Tag
+	{
+		TTilde = 1,
+		TPreRelease,
+		TEnd,
+		TWord,
+		TNumber
+	};
+
+	bool IsDigit (char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	bool IsWordChar (char c)
+	{
+		return (c >= 'a' && c <= 'z') ||
+				(c >= 'A' && c <= 'Z') ||
+				static_cast<unsigned char> (c) >= 0x80;
+	}
+
+	int GetPreReleaseRank (const QByteArray& word)
+	{
+		const char *words [] = { "dev", "alpha", "beta", "pre", "rc" };
+		const char *shortWords [] = { 0, "a", "b", 0, "c" };
+		for (int i = 0; i < 5; ++i)
+			if (word == words [i] ||
+					(shortWords [i] && word == shortWords [i]))
+				return i;
+		return -1;
+	}
+
+	struct Keyed
+	{
+		QByteArray Key_;
+		QString Version_;
+
+		bool operator< (const Keyed& other) const
+		{
+			const int cmp = VersionKey::Compare (Key_, other.Key_);
+			return cmp ? cmp < 0 : Version_ < other.Version_;
+		}
+	};
+}
+
+QByteArray VersionKey::Make (const QString& version)
+{
+	const QByteArray& str = version.toLower ().toUtf8 ();
+	const int size = str.size ();
+
+	QByteArray key;
+	key.reserve (size + 8);
+
+	int i = 0;
+	while (i < size)
+	{
+		const char c = str.at (i);
+		if (c == '~')
+		{
+			key += static_cast<char> (TTilde);
+			++i;
+		}
+		else if (IsDigit (c))
+		{
+			int start = i;
+			while (i < size && IsDigit (str.at (i)))
+				++i;
+			while (start < i - 1 && str.at (start) == '0')
+				++start;
+
+			// Longer numbers are greater, and numbers of the same
+			// length compare as strings.
+			const int digits = std::min (i - start, 255);
+			key += static_cast<char> (TNumber);
+			key += static_cast<char> (digits);
+			key.append (str.constData () + start, digits);
+		}
+		else if (IsWordChar (c))
+		{
+			const int start = i;
+			while (i < size && IsWordChar (str.at (i)))
+				++i;
+
+			const QByteArray& word = str.mid (start, i - start);
+			const int rank = GetPreReleaseRank (word);
+			if (rank >= 0)
+			{
+				key += static_cast<char> (TPreRelease);
+				key += static_cast<char> (rank + 1);
+			}
+			else
+			{
+				key += static_cast<char> (TWord);
+				key += word;
+				key += '\0';
+			}
+		}
+		else
+			++i;
+	}
+
+	key += static_cast<char> (TEnd);
+	return key;
+}
+
+int VersionKey::Compare (const QByteArray& left, const QByteArray& right)
+{
+	const int common = std::min (left.size (), right.size ());
+	const int cmp = std::memcmp (left.constData (), right.constData (), common);
+	if (cmp)
+		return cmp;
+	return left.size () - right.size ();
+}
+
+bool VersionKey::Less (const QString& left, const QString& right)
+{
+	const Keyed leftKeyed = { Make (left), left };
+	const Keyed rightKeyed = { Make (right), right };
+	return leftKeyed < rightKeyed;
+}
+
+void VersionKey::Sort (QStringList& versions)
+{
+	QVector<Keyed> keyed;
+	keyed.reserve (versions.size ());
+	Q_FOREACH (const QString& version, versions)
+	{
+		const Keyed item = { Make (version), version };
+		keyed << item;
+	}
+
+	std::sort (keyed.begin (), keyed.end ());
+
+	for (int i = 0; i < keyed.size (); ++i)
+		versions [i] = keyed.at (i).Version_;
+}
+
+QString VersionKey::GetLatest (const QStringList& versions)
+{
+	if (versions.isEmpty ())
+		return QString ();
+
+	Keyed latest = { Make (versions.first ()), versions.first () };
+	for (int i = 1; i < versions.size (); ++i)
+	{
+		const Keyed item = { Make (versions.at (i)), versions.at (i) };
+		if (latest < item)
+			latest = item;
+	}
+	return latest.Version_;
+}
@@ -0,0 +1,63 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef VERSIONKEY_H
+#define VERSIONKEY_H
+#include <QByteArray>
+#include <QStringList>
+
+/** Version ordering.
+ *
+ * A version is split into numeric and alphabetic segments, and is
+ * turned once into a byte string key, so that comparing two versions
+ * is a single memcmp() of their keys. Numeric segments compare as
+ * numbers, so 1.10 is newer than 1.9. The dev, alpha (a), beta (b),
+ * pre and rc (c) words mark pre-releases, in this order, so 1.0rc1 is
+ * older than 1.0, and everything after a tilde is older than what
+ * comes without it, so 1.0~git1 is older than 1.0 as well. Other words
+ * make the version newer: 1.0-patch1 is newer than 1.0. Separators
+ * don't matter, and neither does the letter case.
+ */
+class VersionKey
+{
+public:
+	static QByteArray Make (const QString& version);
+
+	/** Compares two keys returned by Make(), returning a negative
+	 * number, zero or a positive number if the first one is
+	 * respectively older, equivalent or newer.
+	 */
+	static int Compare (const QByteArray&, const QByteArray&);
+
+	/** Compares two versions. Versions with equivalent keys are
+	 * ordered by their strings, so the order is total.
+	 */
+	static bool Less (const QString&, const QString&);
+
+	/** Sorts the versions from the oldest to the newest, making the
+	 * key of each version only once.
+	 */
+	static void Sort (QStringList&);
+
+	/** Returns the newest of the versions, or a null string if the
+	 * list is empty.
+	 */
+	static QString GetLatest (const QStringList&);
+};
+
+#endif
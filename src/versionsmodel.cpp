@@ -0,0 +1,291 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "versionsmodel.h"
+#include <algorithm>
+#include <QFont>
+#include <QVector>
+#include "versionkey.h"
+
+VersionsModel::VersionsModel (QObject *parent)
+: QAbstractListModel (parent)
+, LatestRow_ (-1)
+{
+}
+
+int VersionsModel::rowCount (const QModelIndex& parent) const
+{
+	return parent.isValid () ? 0 : Versions_.size ();
+}
+
+QVariant VersionsModel::data (const QModelIndex& index, int role) const
+{
+	if (!index.isValid () ||
+			index.row () >= Versions_.size ())
+		return QVariant ();
+
+	switch (role)
+	{
+	case Qt::DisplayRole:
+	case Qt::EditRole:
+		return Versions_.at (index.row ());
+	case Qt::FontRole:
+		if (index.row () == LatestRow_)
+		{
+			QFont font;
+			font.setBold (true);
+			return font;
+		}
+		return QVariant ();
+	case Qt::ToolTipRole:
+		return index.row () == LatestRow_ ?
+				tr ("The latest version") :
+				QVariant ();
+	default:
+		return QVariant ();
+	}
+}
+
+QVariant VersionsModel::headerData (int section, Qt::Orientation orient, int role) const
+{
+	if (orient != Qt::Horizontal ||
+			role != Qt::DisplayRole ||
+			section)
+		return QVariant ();
+
+	return tr ("Version");
+}
+
+Qt::ItemFlags VersionsModel::flags (const QModelIndex& index) const
+{
+	if (!index.isValid ())
+		return Qt::NoItemFlags;
+
+	return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+bool VersionsModel::setData (const QModelIndex& index, const QVariant& value, int role)
+{
+	if (!index.isValid () ||
+			index.row () >= Versions_.size () ||
+			role != Qt::EditRole)
+		return false;
+
+	const QString& newVersion = value.toString ();
+	const QString oldVersion = Versions_.at (index.row ());
+	if (newVersion == oldVersion)
+		return true;
+
+	if (newVersion.isEmpty () || Present_.contains (newVersion))
+		return false;
+
+	Unmark (oldVersion);
+	++Present_ [newVersion];
+	Versions_ [index.row ()] = newVersion;
+	Keys_ [index.row ()] = VersionKey::Make (newVersion);
+
+	emit dataChanged (index, index);
+	emit versionRenamed (oldVersion, newVersion);
+
+	// The latest version may have become older than some other one.
+	if (index.row () == LatestRow_)
+		UpdateLatest ();
+	else
+		CheckLatest (index.row ());
+	return true;
+}
+
+void VersionsModel::sort (int column, Qt::SortOrder order)
+{
+	if (column)
+		return;
+
+	QVector<int> rows (Versions_.size ());
+	for (int i = 0; i < rows.size (); ++i)
+		rows [i] = i;
+	std::stable_sort (rows.begin (), rows.end (),
+			[this, order] (int left, int right)
+			{
+				return order == Qt::AscendingOrder ?
+						IsNewer (right, left) :
+						IsNewer (left, right);
+			});
+
+	emit layoutAboutToBeChanged ();
+
+	QStringList versions;
+	QList<QByteArray> keys;
+	QVector<int> newRows (rows.size ());
+	for (int i = 0; i < rows.size (); ++i)
+	{
+		versions << Versions_.at (rows.at (i));
+		keys << Keys_.at (rows.at (i));
+		newRows [rows.at (i)] = i;
+	}
+	Versions_ = versions;
+	Keys_ = keys;
+	if (LatestRow_ >= 0)
+		LatestRow_ = newRows.at (LatestRow_);
+
+	Q_FOREACH (const QModelIndex& persistent, persistentIndexList ())
+		changePersistentIndex (persistent, index (newRows.at (persistent.row ())));
+
+	emit layoutChanged ();
+}
+
+void VersionsModel::Clear ()
+{
+	SetVersions (QStringList ());
+}
+
+void VersionsModel::SetVersions (const QStringList& versions)
+{
+	beginResetModel ();
+	Versions_.clear ();
+	Keys_.clear ();
+	Present_.clear ();
+	LatestRow_ = -1;
+	Q_FOREACH (const QString& version, versions)
+	{
+		Versions_ << version;
+		Keys_ << VersionKey::Make (version);
+		++Present_ [version];
+		if (LatestRow_ < 0 || IsNewer (Versions_.size () - 1, LatestRow_))
+			LatestRow_ = Versions_.size () - 1;
+	}
+	endResetModel ();
+}
+
+const QStringList& VersionsModel::GetVersions () const
+{
+	return Versions_;
+}
+
+bool VersionsModel::Contains (const QString& version) const
+{
+	return Present_.contains (version);
+}
+
+bool VersionsModel::AddVersion (const QString& version)
+{
+	if (Present_.contains (version))
+		return false;
+
+	beginInsertRows (QModelIndex (), Versions_.size (), Versions_.size ());
+	Versions_ << version;
+	Keys_ << VersionKey::Make (version);
+	++Present_ [version];
+	endInsertRows ();
+
+	CheckLatest (Versions_.size () - 1);
+	return true;
+}
+
+int VersionsModel::AddVersions (const QStringList& versions)
+{
+	QStringList added;
+	Q_FOREACH (const QString& version, versions)
+		if (!Present_.contains (version))
+		{
+			++Present_ [version];
+			added << version;
+		}
+
+	if (added.isEmpty ())
+		return 0;
+
+	const int first = Versions_.size ();
+	beginInsertRows (QModelIndex (), first, first + added.size () - 1);
+	Versions_ += added;
+	Q_FOREACH (const QString& version, added)
+		Keys_ << VersionKey::Make (version);
+	endInsertRows ();
+
+	int newest = first;
+	for (int i = first + 1; i < Versions_.size (); ++i)
+		if (IsNewer (i, newest))
+			newest = i;
+	CheckLatest (newest);
+	return added.size ();
+}
+
+void VersionsModel::RemoveVersion (int row)
+{
+	if (row < 0 || row >= Versions_.size ())
+		return;
+
+	beginRemoveRows (QModelIndex (), row, row);
+	Unmark (Versions_.takeAt (row));
+	Keys_.removeAt (row);
+	const bool wasLatest = LatestRow_ == row;
+	if (wasLatest)
+		LatestRow_ = -1;
+	else if (LatestRow_ > row)
+		--LatestRow_;
+	endRemoveRows ();
+
+	if (wasLatest)
+		UpdateLatest ();
+}
+
+QString VersionsModel::GetLatest () const
+{
+	return LatestRow_ >= 0 ? Versions_.at (LatestRow_) : QString ();
+}
+
+bool VersionsModel::IsNewer (int row, int than) const
+{
+	const int cmp = VersionKey::Compare (Keys_.at (row), Keys_.at (than));
+	return cmp ? cmp > 0 : Versions_.at (than) < Versions_.at (row);
+}
+
+void VersionsModel::Unmark (const QString& version)
+{
+	const QHash<QString, int>::iterator pos = Present_.find (version);
+	if (pos != Present_.end () && !--*pos)
+		Present_.erase (pos);
+}
+
+void VersionsModel::CheckLatest (int row)
+{
+	if (LatestRow_ < 0 || IsNewer (row, LatestRow_))
+		SetLatest (row);
+}
+
+void VersionsModel::UpdateLatest ()
+{
+	int latest = Versions_.isEmpty () ? -1 : 0;
+	for (int i = 1; i < Versions_.size (); ++i)
+		if (IsNewer (i, latest))
+			latest = i;
+
+	SetLatest (latest);
+}
+
+void VersionsModel::SetLatest (int latest)
+{
+	if (latest == LatestRow_)
+		return;
+
+	const int oldLatest = LatestRow_;
+	LatestRow_ = latest;
+	if (oldLatest >= 0)
+		emit dataChanged (index (oldLatest), index (oldLatest));
+	if (latest >= 0)
+		emit dataChanged (index (latest), index (latest));
+}
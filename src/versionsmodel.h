@@ -0,0 +1,99 @@
+/**********************************************************************
+ * LC Package Generator - a small utility to create LackMan packages.
+ * Copyright (C) 2010-2011  Georg Rudoy
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef VERSIONSMODEL_H
+#define VERSIONSMODEL_H
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QHash>
+
+/** The list of package versions.
+ *
+ * Versions are kept in a plain list with the number of times each
+ * of them occurs alongside it, so that checking whether a version is
+ * already present doesn't require scanning the list. The sort key of each version is kept too, so
+ * that the list can be sorted and the latest version, shown in bold,
+ * can be found without parsing the versions again.
+ */
+class VersionsModel : public QAbstractListModel
+{
+	Q_OBJECT
+
+	QStringList Versions_;
+	QList<QByteArray> Keys_;
+	QHash<QString, int> Present_;
+	int LatestRow_;
+public:
+	VersionsModel (QObject* = 0);
+
+	int rowCount (const QModelIndex& = QModelIndex ()) const;
+	QVariant data (const QModelIndex&, int = Qt::DisplayRole) const;
+	QVariant headerData (int, Qt::Orientation, int = Qt::DisplayRole) const;
+	Qt::ItemFlags flags (const QModelIndex&) const;
+	bool setData (const QModelIndex&, const QVariant&, int = Qt::EditRole);
+	void sort (int column, Qt::SortOrder = Qt::AscendingOrder);
+
+	void Clear ();
+
+	/** Replaces all the versions. Repeated ones are kept as they are,
+	 * the loader warns about them.
+	 */
+	void SetVersions (const QStringList&);
+	const QStringList& GetVersions () const;
+
+	bool Contains (const QString&) const;
+
+	/** Appends the version, returning false if it is already
+	 * present.
+	 */
+	bool AddVersion (const QString&);
+
+	/** Appends those of the versions that aren't present yet, all
+	 * in one batch, and returns how many were added.
+	 */
+	int AddVersions (const QStringList&);
+
+	/** Removes the version at the given row.
+	 */
+	void RemoveVersion (int row);
+
+	/** Returns the newest version, or a null string if there are no
+	 * versions.
+	 */
+	QString GetLatest () const;
+private:
+	bool IsNewer (int row, int than) const;
+	void Unmark (const QString&);
+
+	/** Makes the row the latest one if it is newer than the current
+	 * latest one.
+	 */
+	void CheckLatest (int row);
+
+	/** Finds the latest row by scanning all of them.
+	 */
+	void UpdateLatest ();
+	void SetLatest (int row);
+signals:
+	/** Emitted whenever a version is renamed, either via setData()
+	 * or by editing it in a view.
+	 */
+	void versionRenamed (const QString& oldVersion, const QString& newVersion);
+};
+
+#endif